@@ -24,7 +24,19 @@
 
 ******************************************************************************/
 
+#include <cstring>
+#include <algorithm>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef WIN32
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/mman.h>
+#endif
+
 #include "a3ds.h"
+#include "ajobsystem.h"
 
 using namespace std;
 namespace astral3d {
@@ -82,13 +94,140 @@ float Magnitude(AVector3 vNormal)
 }
 
 //-----------------------------------------------------------------------------
-// This constructor initializes the AChunk data
+// constructor of the mapped file
+//-----------------------------------------------------------------------------
+
+AMappedFile::AMappedFile()
+{
+    data = NULL;
+    size = 0;
+    mapped = false;
+
+#ifdef WIN32
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    file = -1;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// destructor of the mapped file
+//-----------------------------------------------------------------------------
+
+AMappedFile::~AMappedFile()
+{
+    close();
+}
+
+//-----------------------------------------------------------------------------
+// maps the file, reads it if it can't be mapped
+//-----------------------------------------------------------------------------
+
+bool AMappedFile::open(const char *filename)
+{
+    close();
+
+#ifdef WIN32
+    file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+                       FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE)
+        return false;
+
+    size = GetFileSize(file, NULL);
+    if(size > 0)
+    {
+        mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(mapping)
+            data = (const unsigned char *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    }
+#else
+    file = ::open(filename, O_RDONLY);
+    if(file < 0)
+        return false;
+
+    struct stat info;
+    if(fstat(file, &info) != 0)
+    {
+        close();
+        return false;
+    }
+
+    size = (unsigned int) info.st_size;
+    if(size > 0)
+    {
+        void *view = mmap(NULL, size, PROT_READ, MAP_PRIVATE, file, 0);
+        if(view != MAP_FAILED)
+        {
+            // chunks are read from the beginning to the end
+            madvise(view, size, MADV_SEQUENTIAL);
+            data = (const unsigned char *) view;
+        }
+    }
+#endif
+
+    if(data)
+    {
+        mapped = true;
+        return true;
+    }
+
+    // file systems without the mapping
+    buffer.resize(size + 1);
+
+    FILE *stream = fopen(filename, "rb");
+    if(stream == NULL)
+    {
+        close();
+        return false;
+    }
+
+    size = fread(&buffer[0], 1, size, stream);
+    fclose(stream);
+
+    data = &buffer[0];
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// unmaps and closes the file
+//-----------------------------------------------------------------------------
+
+void AMappedFile::close()
+{
+#ifdef WIN32
+    if(mapped)
+        UnmapViewOfFile(data);
+    if(mapping)
+        CloseHandle(mapping);
+    if(file != INVALID_HANDLE_VALUE)
+        CloseHandle(file);
+
+    file = INVALID_HANDLE_VALUE;
+    mapping = NULL;
+#else
+    if(mapped)
+        munmap((void *) data, size);
+    if(file >= 0)
+        ::close(file);
+
+    file = -1;
+#endif
+
+    buffer.clear();
+    data = NULL;
+    size = 0;
+    mapped = false;
+}
+
+//-----------------------------------------------------------------------------
+// This constructor initializes the loader
 //-----------------------------------------------------------------------------
 
 A3DSLoader::A3DSLoader()
 {
-    m_CurrenAChunk = new AChunk;
-    m_TempChunk    = new AChunk;
+    m_Data = NULL;
+    m_Size = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -109,34 +248,37 @@ bool A3DSLoader::load3DSModel(A3DModel *pModel, char *strFileName)
     cout << "oteviram soubor \"" << strFileName << "\"" << endl;
 #endif
 
-    m_FilePointer = NULL;
-
-    m_FilePointer = fopen(strFileName, "rb");
-
-    if(m_FilePointer == NULL)
+    if(!m_File.open(strFileName))
     {
         stringstream foo;
         stringstream bar;
         foo << "A3DSLoader::load3DSModel("<<pModel<<", "<<strFileName<<")";
-        bar << "fopen("<<strFileName<<", "<<"\"rb\")";
-        setAstral3DError("Can't open file", foo.str(), bar.str());
+        bar << "AMappedFile::open(\""<<strFileName<<"\")";
+        setError("Can't open file", foo.str(), bar.str());
         return false;
     }
 
+    m_Data = m_File.getData();
+    m_Size = m_File.getSize();
+
 #ifdef DEBUG
     cout << "soubor otevren" << endl;
     cout << "nacitam data z modelu" << endl;
 #endif
 
-    readChunk(m_CurrenAChunk);
+    // the whole file is the parent of the primary chunk
+    AChunk file = { 0, 0, m_Size };
+    AChunk primary;
 
-    if (m_CurrenAChunk->ID != PRIMARY)
+    if(!readChunk(0, file, &primary) || primary.ID != PRIMARY)
     {
         stringstream foo;
         stringstream bar;
         foo << "A3DSLoader::load3DSModel("<<pModel<<", \""<<strFileName<<"\")";
-        bar << "A3DSLoader::readChunk("<<m_CurrenAChunk<<")";
-        setAstral3DError("Unable to load PRIMARY chuck", foo.str(), bar.str());
+        bar << "A3DSLoader::readChunk(0, ...)";
+        setError("Unable to load PRIMARY chuck", foo.str(), bar.str());
+
+        m_File.close();
         return false;
     }
 
@@ -145,7 +287,7 @@ bool A3DSLoader::load3DSModel(A3DModel *pModel, char *strFileName)
     cout << "nacitam dalsi data z modelu" << endl;
 #endif
 
-    processNexAChunk(pModel, m_CurrenAChunk);
+    processNextChunk(pModel, primary);
 
 #ifdef DEBUG
     cout << "dalsi data nactena" << endl;
@@ -154,320 +296,287 @@ bool A3DSLoader::load3DSModel(A3DModel *pModel, char *strFileName)
 
     computeNormals(pModel);
 
-#ifdef DEBUG
-    cout << "normaly spocitany" << endl;
-    cout << "volam uklid" << endl;
-#endif
+    m_File.close();
+    m_Data = NULL;
+    m_Size = 0;
 
-    cleanUp();
+    return true;
+}
 
-#ifdef DEBUG
-    cout << "pomocna pamet uvolnena" << endl;
-#endif
+//-----------------------------------------------------------------------------
+// This function keeps the error, the loader can run in a job of AJobSystem
+// so it doesn't set the Astral3D error
+//-----------------------------------------------------------------------------
 
-    return true;
+void A3DSLoader::setError(const std::string &description, const std::string &sender, const std::string &failed)
+{
+    m_Error.errorDescription = description;
+    m_Error.senderFunction = sender;
+    m_Error.failedFunction = failed;
 }
 
 //-----------------------------------------------------------------------------
-// This function cleans up our allocated memory and closes the file
+// This function reads in a chunk ID and it's length, false if the chunk
+// doesn't fit into the parent
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::cleanUp()
+bool A3DSLoader::readChunk(unsigned int offset, const AChunk &parent, AChunk *pChunk)
 {
-#ifdef DEBUG
-    cout << "uklid: zaviram soubor s modelem" << endl;
-#endif
+    if(offset + 6 < offset || offset + 6 > parent.end)
+        return false;
 
-    if (m_FilePointer) {
-        fclose(m_FilePointer);
-    }
+    const unsigned char *p = m_Data + offset;
+    unsigned int length = p[2] | (p[3] << 8) | (p[4] << 16) | ((unsigned int) p[5] << 24);
 
-#ifdef DEBUG
-    cout << "uklid: soubor uzavren" << endl;
-#endif
+    if(length < 6 || length > parent.end - offset)
+        return false;
 
-    delete m_CurrenAChunk;
-    delete m_TempChunk;
+    pChunk->ID = (unsigned short) (p[0] | (p[1] << 8));
+    pChunk->begin = offset + 6;
+    pChunk->end = offset + length;
+    return true;
 }
 
-
 //-----------------------------------------------------------------------------
-// This function reads the main sections of the .3DS file, then dives deeper with recursion
+// This function reads in the little endian short number
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::processNexAChunk(A3DModel *pModel, AChunk *pPreviousChunk)
+unsigned short A3DSLoader::readShort(unsigned int offset)
 {
-    A3DObject newObject = {0};
-    AMaterialInfo newTexture = {0};
-    unsigned short version = 0;
-    int buffer[50000] = {0};
-
-    m_CurrenAChunk = new AChunk;
-
-    while (pPreviousChunk->bytesRead < pPreviousChunk->length)
-    {
-        readChunk(m_CurrenAChunk);
+    return (unsigned short) (m_Data[offset] | (m_Data[offset + 1] << 8));
+}
 
-        switch (m_CurrenAChunk->ID)
-        {
-        case VERSION:
+//-----------------------------------------------------------------------------
+// This function reads in a string of characters, returns the bytes of the
+// string in the file
+//-----------------------------------------------------------------------------
 
-            m_CurrenAChunk->bytesRead += fread(&version, 1, m_CurrenAChunk->length - m_CurrenAChunk->bytesRead, m_FilePointer);
+unsigned int A3DSLoader::getString(unsigned int offset, unsigned int end, char *pBuffer, unsigned int size)
+{
+    const char *begin = (const char *) m_Data + offset;
+    const char *last = (const char *) memchr(begin, 0, end - offset);
 
-            if (version > 0x03);
-                //MessageBox(NULL, "This 3DS file is over version 3 so it may load incorrectly", "Warning", MB_OK);
-            break;
+    unsigned int length = last ? last - begin : end - offset;
+    unsigned int copied = min(length, size - 1);
 
-        case OBJECTINFO:
-            readChunk(m_TempChunk);
+    memcpy(pBuffer, begin, copied);
+    pBuffer[copied] = 0;
 
-            m_TempChunk->bytesRead += fread(&version, 1, m_TempChunk->length - m_TempChunk->bytesRead, m_FilePointer);
+    return last ? length + 1 : length;
+}
 
-            m_CurrenAChunk->bytesRead += m_TempChunk->bytesRead;
+//-----------------------------------------------------------------------------
+// This function reads the main sections of the .3DS file, then dives deeper with recursion
+//-----------------------------------------------------------------------------
 
-            processNexAChunk(pModel, m_CurrenAChunk);
+void A3DSLoader::processNextChunk(A3DModel *pModel, const AChunk &parent)
+{
+    AChunk chunk;
+    for(unsigned int offset = parent.begin; readChunk(offset, parent, &chunk); offset = chunk.end)
+    {
+        switch (chunk.ID)
+        {
+        case OBJECTINFO:
+            processNextChunk(pModel, chunk);
             break;
 
         case MATERIAL:
-            pModel->numOfMaterials++;
+        {
+            AMaterialInfo newTexture;
+            memset(&newTexture, 0, sizeof(AMaterialInfo));
 
+            pModel->numOfMaterials++;
             pModel->pMaterials.push_back(newTexture);
 
-            processNextMaterialChunk(pModel, m_CurrenAChunk);
+            processNextMaterialChunk(pModel, chunk);
             break;
+        }
 
         case OBJECT:
-            pModel->numOfObjects++;
+        {
+            A3DObject newObject;
+            memset(&newObject, 0, sizeof(A3DObject));
 
+            pModel->numOfObjects++;
             pModel->pObject.push_back(newObject);
 
-            memset(&(pModel->pObject[pModel->numOfObjects - 1]), 0, sizeof(A3DObject));
-
-            m_CurrenAChunk->bytesRead += getString(pModel->pObject[pModel->numOfObjects - 1].strName);
+            A3DObject *pObject = &(pModel->pObject[pModel->numOfObjects - 1]);
 
-            processNextObjecAChunk(pModel, &(pModel->pObject[pModel->numOfObjects - 1]), m_CurrenAChunk);
-            break;
-
-        case EDITKEYFRAME:
+            // the name precedes the sub chunks
+            AChunk mesh = chunk;
+            mesh.begin += getString(chunk.begin, chunk.end, pObject->strName, sizeof(pObject->strName));
 
-            m_CurrenAChunk->bytesRead += fread(buffer, 1, m_CurrenAChunk->length - m_CurrenAChunk->bytesRead, m_FilePointer);
+            processNextObjectChunk(pModel, pObject, mesh);
             break;
+        }
 
         default:
-
-            m_CurrenAChunk->bytesRead += fread(buffer, 1, m_CurrenAChunk->length - m_CurrenAChunk->bytesRead, m_FilePointer);
+            // VERSION, EDITKEYFRAME and unknown chunks are skipped
             break;
         }
-
-        pPreviousChunk->bytesRead += m_CurrenAChunk->bytesRead;
     }
-
-    delete m_CurrenAChunk;
-    m_CurrenAChunk = pPreviousChunk;
 }
 
-
 //-----------------------------------------------------------------------------
 // This function handles all the information about the objects in the file
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::processNextObjecAChunk(A3DModel *pModel, A3DObject *pObject, AChunk *pPreviousChunk)
+void A3DSLoader::processNextObjectChunk(A3DModel *pModel, A3DObject *pObject, const AChunk &parent)
 {
-    int buffer[50000] = {0};
-
-    m_CurrenAChunk = new AChunk;
-
-    while (pPreviousChunk->bytesRead < pPreviousChunk->length)
+    AChunk chunk;
+    for(unsigned int offset = parent.begin; readChunk(offset, parent, &chunk); offset = chunk.end)
     {
-        readChunk(m_CurrenAChunk);
-
-        switch (m_CurrenAChunk->ID)
+        switch (chunk.ID)
         {
         case OBJECT_MESH:
-            processNextObjecAChunk(pModel, pObject, m_CurrenAChunk);
+            processNextObjectChunk(pModel, pObject, chunk);
             break;
 
         case OBJECT_VERTICES:
-            readVertices(pObject, m_CurrenAChunk);
+            readVertices(pObject, chunk);
             break;
 
         case OBJECT_FACES:
-            readVertexIndices(pObject, m_CurrenAChunk);
+        {
+            // the material of the faces is the sub chunk behind the indices
+            AChunk faces = chunk;
+            faces.begin = readVertexIndices(pObject, chunk);
+
+            processNextObjectChunk(pModel, pObject, faces);
             break;
+        }
 
         case OBJECT_MATERIAL:
-            readObjectMaterial(pModel, pObject, m_CurrenAChunk);
+            readObjectMaterial(pModel, pObject, chunk);
             break;
 
         case OBJECT_UV:
-            readUVCoordinates(pObject, m_CurrenAChunk);
+            readUVCoordinates(pObject, chunk);
             break;
 
         default:
-            m_CurrenAChunk->bytesRead += fread(buffer, 1, m_CurrenAChunk->length - m_CurrenAChunk->bytesRead, m_FilePointer);
             break;
         }
-
-        pPreviousChunk->bytesRead += m_CurrenAChunk->bytesRead;
     }
-
-    delete m_CurrenAChunk;
-    m_CurrenAChunk = pPreviousChunk;
 }
 
-
 //-----------------------------------------------------------------------------
 //  This function handles all the information about the material (Texture)
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::processNextMaterialChunk(A3DModel *pModel, AChunk *pPreviousChunk)
+void A3DSLoader::processNextMaterialChunk(A3DModel *pModel, const AChunk &parent)
 {
-    int buffer[50000] = {0};
-    m_CurrenAChunk = new AChunk;
+    AMaterialInfo *pMaterial = &(pModel->pMaterials[pModel->numOfMaterials - 1]);
 
-    while (pPreviousChunk->bytesRead < pPreviousChunk->length)
+    AChunk chunk;
+    for(unsigned int offset = parent.begin; readChunk(offset, parent, &chunk); offset = chunk.end)
     {
-        readChunk(m_CurrenAChunk);
-
-        // switch (pModel, m_CurrenAChunk->ID)
-        switch (m_CurrenAChunk->ID)
+        switch (chunk.ID)
         {
         case MATNAME:
-            m_CurrenAChunk->bytesRead += fread(pModel->pMaterials[pModel->numOfMaterials - 1].strName, 1, m_CurrenAChunk->length - m_CurrenAChunk->bytesRead, m_FilePointer);
+            getString(chunk.begin, chunk.end, pMaterial->strName, sizeof(pMaterial->strName));
             break;
 
         case MATDIFFUSE:
-            readColorChunk(&(pModel->pMaterials[pModel->numOfMaterials - 1]), m_CurrenAChunk);
+            readColorChunk(pMaterial, chunk);
             break;
 
         case MATMAP:
-            processNextMaterialChunk(pModel, m_CurrenAChunk);
+            processNextMaterialChunk(pModel, chunk);
             break;
 
         case MATMAPFILE:
-            m_CurrenAChunk->bytesRead += fread(pModel->pMaterials[pModel->numOfMaterials - 1].strFile, 1, m_CurrenAChunk->length - m_CurrenAChunk->bytesRead, m_FilePointer);
+            getString(chunk.begin, chunk.end, pMaterial->strFile, sizeof(pMaterial->strFile));
             break;
 
         default:
-            m_CurrenAChunk->bytesRead += fread(buffer, 1, m_CurrenAChunk->length - m_CurrenAChunk->bytesRead, m_FilePointer);
             break;
         }
-        pPreviousChunk->bytesRead += m_CurrenAChunk->bytesRead;
-    }
-
-    delete m_CurrenAChunk;
-    m_CurrenAChunk = pPreviousChunk;
-}
-
-//-----------------------------------------------------------------------------
-// This function reads in a chunk ID and it's length in bytes
-//-----------------------------------------------------------------------------
-
-void A3DSLoader::readChunk(AChunk *pChunk)
-{
-    pChunk->bytesRead = fread(&pChunk->ID, 1, 2, m_FilePointer);
-
-    pChunk->bytesRead += fread(&pChunk->length, 1, 4, m_FilePointer);
-}
-
-//-----------------------------------------------------------------------------
-// This function reads in a string of characters
-//-----------------------------------------------------------------------------
-
-int A3DSLoader::getString(char *pBuffer)
-{
-    int index = 0;
-
-    fread(pBuffer, 1, 1, m_FilePointer);
-
-    while (*(pBuffer + index++) != 0)
-    {
-        fread(pBuffer + index, 1, 1, m_FilePointer);
     }
-
-    return strlen(pBuffer) + 1;
 }
 
-
 //-----------------------------------------------------------------------------
 // This function reads in the RGB color data
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::readColorChunk(AMaterialInfo *pMaterial, AChunk *pChunk)
+void A3DSLoader::readColorChunk(AMaterialInfo *pMaterial, const AChunk &chunk)
 {
-    readChunk(m_TempChunk);
-    m_TempChunk->bytesRead += fread(pMaterial->color, 1, m_TempChunk->length - m_TempChunk->bytesRead, m_FilePointer);
-    pChunk->bytesRead += m_TempChunk->bytesRead;
+    AChunk color;
+    if(readChunk(chunk.begin, chunk, &color))
+        memcpy(pMaterial->color, m_Data + color.begin, min(color.end - color.begin, (unsigned int) sizeof(pMaterial->color)));
 }
 
-
 //-----------------------------------------------------------------------------
-// This function reads in the indices for the vertex array
+// This function reads in the indices for the vertex array, returns the
+// offset behind them
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::readVertexIndices(A3DObject *pObject, AChunk *pPreviousChunk)
+unsigned int A3DSLoader::readVertexIndices(A3DObject *pObject, const AChunk &chunk)
 {
-    unsigned short index = 0;
-    pPreviousChunk->bytesRead += fread(&pObject->numOfFaces, 1, 2, m_FilePointer);
+    if(chunk.end - chunk.begin < 2)
+        return chunk.end;
+
+    // four shorts per face: three indices and the flags
+    unsigned int available = (chunk.end - chunk.begin - 2) / 8;
+    pObject->numOfFaces = min((unsigned int) readShort(chunk.begin), available);
 
     pObject->pFaces = new AFace [pObject->numOfFaces];
     memset(pObject->pFaces, 0, sizeof(AFace) * pObject->numOfFaces);
 
-
-    for(int i = 0; i < pObject->numOfFaces; i++)
+    const unsigned char *p = m_Data + chunk.begin + 2;
+    for(int i = 0; i < pObject->numOfFaces; i++, p += 8)
     {
-        for(int j = 0; j < 4; j++)
-        {
-            pPreviousChunk->bytesRead += fread(&index, 1, sizeof(index), m_FilePointer);
-
-            if(j < 3)
-            {
-                pObject->pFaces[i].vertIndex[j] = index;
-            }
-        }
+        pObject->pFaces[i].vertIndex[0] = p[0] | (p[1] << 8);
+        pObject->pFaces[i].vertIndex[1] = p[2] | (p[3] << 8);
+        pObject->pFaces[i].vertIndex[2] = p[4] | (p[5] << 8);
     }
-}
 
+    return chunk.begin + 2 + pObject->numOfFaces * 8;
+}
 
 //-----------------------------------------------------------------------------
 // This function reads in the UV coordinates for the object
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::readUVCoordinates(A3DObject *pObject, AChunk *pPreviousChunk)
+void A3DSLoader::readUVCoordinates(A3DObject *pObject, const AChunk &chunk)
 {
-    pPreviousChunk->bytesRead += fread(&pObject->numTexVertex, 1, 2, m_FilePointer);
+    if(chunk.end - chunk.begin < 2)
+        return;
 
-    pObject->pTexVerts = new AVector2 [pObject->numTexVertex];
+    unsigned int available = (chunk.end - chunk.begin - 2) / sizeof(AVector2);
+    pObject->numTexVertex = min((unsigned int) readShort(chunk.begin), available);
 
-    pPreviousChunk->bytesRead += fread(pObject->pTexVerts, 1, pPreviousChunk->length - pPreviousChunk->bytesRead, m_FilePointer);
+    // the floats are copied at once (little endian as the file)
+    pObject->pTexVerts = new AVector2 [pObject->numTexVertex];
+    memcpy(pObject->pTexVerts, m_Data + chunk.begin + 2, sizeof(AVector2) * pObject->numTexVertex);
 }
 
-
 //-----------------------------------------------------------------------------
 //  This function reads in the vertices for the object
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::readVertices(A3DObject *pObject, AChunk *pPreviousChunk)
+void A3DSLoader::readVertices(A3DObject *pObject, const AChunk &chunk)
 {
-    pPreviousChunk->bytesRead += fread(&(pObject->numOfVerts), 1, 2, m_FilePointer);
+    if(chunk.end - chunk.begin < 2)
+        return;
 
-    pObject->pVerts = new AVector3 [pObject->numOfVerts];
-    memset(pObject->pVerts, 0, sizeof(AVector3) * pObject->numOfVerts);
+    unsigned int available = (chunk.end - chunk.begin - 2) / sizeof(AVector3);
+    pObject->numOfVerts = min((unsigned int) readShort(chunk.begin), available);
 
-    pPreviousChunk->bytesRead += fread(pObject->pVerts, 1, pPreviousChunk->length - pPreviousChunk->bytesRead, m_FilePointer);
+    pObject->pVerts = new AVector3 [pObject->numOfVerts];
+    memcpy(pObject->pVerts, m_Data + chunk.begin + 2, sizeof(AVector3) * pObject->numOfVerts);
 }
 
-
 //-----------------------------------------------------------------------------
 // This function reads in the material name assigned to the object and sets the materialID
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::readObjectMaterial(A3DModel *pModel, A3DObject *pObject, AChunk *pPreviousChunk)
+void A3DSLoader::readObjectMaterial(A3DModel *pModel, A3DObject *pObject, const AChunk &chunk)
 {
     char strMaterial[255] = {0};
-    int buffer[50000] = {0};
 
-    pPreviousChunk->bytesRead += getString(strMaterial);
+    // the list of the faces behind the name isn't used
+    getString(chunk.begin, chunk.end, strMaterial, sizeof(strMaterial));
 
     for(int i = 0; i < pModel->numOfMaterials; i++)
     {
@@ -482,8 +591,6 @@ void A3DSLoader::readObjectMaterial(A3DModel *pModel, A3DObject *pObject, AChunk
             break;
         }
     }
-
-    pPreviousChunk->bytesRead += fread(buffer, 1, pPreviousChunk->length - pPreviousChunk->bytesRead, m_FilePointer);
 }
 
 
@@ -523,70 +630,141 @@ AVector3 DivideVectorByScaler(AVector3 vVector1, float Scaler)
 }
 
 //-----------------------------------------------------------------------------
-// This function computes the normals and vertex normals of the objects
+// Normals of one object
+//-----------------------------------------------------------------------------
+struct ANormalsData
+{
+    A3DObject *pObject;
+    std::vector<AVector3> faceNormals;      // not normalized
+    std::vector<int> offsets;               // faces of the vertex i are faces[offsets[i]] ...
+    std::vector<int> faces;                 // ... faces[offsets[i + 1] - 1] in the ascending order
+};
+
+//-----------------------------------------------------------------------------
+// This function computes the normals of the faces (job of AJobSystem::parallelFor)
 //-----------------------------------------------------------------------------
 
-void A3DSLoader::computeNormals(A3DModel *pModel)
+static void computeFaceNormals(int begin, int end, void *data)
 {
-    AVector3 vVector1, vVector2, vNormal, vPoly[3];
+    ANormalsData *pData = (ANormalsData *) data;
+    A3DObject *pObject = pData->pObject;
+    AVector3 vVector1, vVector2, vPoly[3];
 
-    if(pModel->numOfObjects <= 0)
-        return;
+    for(int i = begin; i < end; i++)
+    {
+        const int *index = pObject->pFaces[i].vertIndex;
+        if(index[0] >= pObject->numOfVerts || index[1] >= pObject->numOfVerts || index[2] >= pObject->numOfVerts)
+        {
+            pData->faceNormals[i] = AVector3(0.0, 0.0, 0.0);
+            continue;
+        }
+
+        vPoly[0] = pObject->pVerts[index[0]];
+        vPoly[1] = pObject->pVerts[index[1]];
+        vPoly[2] = pObject->pVerts[index[2]];
+
+        vVector1 = vPoly[0] - vPoly[2];
+        vVector2 = vPoly[2] - vPoly[1];
+
+        pData->faceNormals[i] = Cross(vVector1, vVector2);
+    }
+}
 
-    for(int index = 0; index < pModel->numOfObjects; index++)
+//-----------------------------------------------------------------------------
+// This function averages the normals of the faces sharing the vertices (job
+// of AJobSystem::parallelFor), the sums go in the order of the faces so the
+// normals don't depend on the threads
+//-----------------------------------------------------------------------------
+
+static void computeVertexNormals(int begin, int end, void *data)
+{
+    ANormalsData *pData = (ANormalsData *) data;
+    A3DObject *pObject = pData->pObject;
+
+    for(int i = begin; i < end; i++)
     {
-        A3DObject *pObject = &(pModel->pObject[index]);
+        AVector3 vSum(0.0, 0.0, 0.0);
+        int first = pData->offsets[i];
+        int shared = pData->offsets[i + 1] - first;
 
-        AVector3 *pNormals      = new AVector3 [pObject->numOfFaces];
-        AVector3 *pTempNormals  = new AVector3 [pObject->numOfFaces];
-        pObject->pNormals       = new AVector3 [pObject->numOfVerts];
+        for(int j = 0; j < shared; j++)
+            vSum = vSum + pData->faceNormals[pData->faces[first + j]];
 
-        for(int i=0; i < pObject->numOfFaces; i++)
-        {
-            vPoly[0] = pObject->pVerts[pObject->pFaces[i].vertIndex[0]];
-            vPoly[1] = pObject->pVerts[pObject->pFaces[i].vertIndex[1]];
-            vPoly[2] = pObject->pVerts[pObject->pFaces[i].vertIndex[2]];
+        pObject->pNormals[i] = DivideVectorByScaler(vSum, float(-shared));
+
+        pObject->pNormals[i] = Normalize(pObject->pNormals[i]);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This function computes the vertex normals of one object
+//-----------------------------------------------------------------------------
 
+static void computeObjectNormals(A3DObject *pObject)
+{
+    ANormalsData data;
+    data.pObject = pObject;
+    data.faceNormals.resize(pObject->numOfFaces);
 
-            vVector1 = vPoly[0] - vPoly[2];
-            vVector2 = vPoly[2] - vPoly[1];
+    pObject->pNormals = new AVector3 [pObject->numOfVerts];
 
-            vNormal  = Cross(vVector1, vVector2);
-            pTempNormals[i] = vNormal;
-            vNormal  = Normalize(vNormal);
+    AJobSystem::parallelFor(0, pObject->numOfFaces, computeFaceNormals, &data, 4096);
 
-            pNormals[i] = vNormal;
+    // faces of the vertices, every face is counted once for the vertex
+    data.offsets.assign(pObject->numOfVerts + 1, 0);
+    for(int i = 0; i < pObject->numOfFaces; i++)
+    {
+        const int *index = pObject->pFaces[i].vertIndex;
+        for(int j = 0; j < 3; j++)
+        {
+            if(index[j] < pObject->numOfVerts && (j < 1 || index[j] != index[0]) && (j < 2 || index[j] != index[1]))
+                data.offsets[index[j] + 1]++;
         }
+    }
 
+    for(int i = 0; i < pObject->numOfVerts; i++)
+        data.offsets[i + 1] += data.offsets[i];
 
-        AVector3 vSum(0.0, 0.0, 0.0);
-        AVector3 vZero = vSum;
-        int shared=0;
+    data.faces.resize(data.offsets[pObject->numOfVerts]);
 
-        for (int i = 0; i < pObject->numOfVerts; i++)
+    std::vector<int> next(data.offsets.begin(), data.offsets.end() - 1);
+    for(int i = 0; i < pObject->numOfFaces; i++)
+    {
+        const int *index = pObject->pFaces[i].vertIndex;
+        for(int j = 0; j < 3; j++)
         {
-            for (int j = 0; j < pObject->numOfFaces; j++)
-            {
-                if (pObject->pFaces[j].vertIndex[0] == i ||
-                    pObject->pFaces[j].vertIndex[1] == i ||
-                    pObject->pFaces[j].vertIndex[2] == i)
-                {
-                    vSum = vSum + pTempNormals[j];
-                    shared++;
-                }
-            }
+            if(index[j] < pObject->numOfVerts && (j < 1 || index[j] != index[0]) && (j < 2 || index[j] != index[1]))
+                data.faces[next[index[j]]++] = i;
+        }
+    }
 
-            pObject->pNormals[i] = DivideVectorByScaler(vSum, float(-shared));
+    AJobSystem::parallelFor(0, pObject->numOfVerts, computeVertexNormals, &data, 4096);
+}
 
-            pObject->pNormals[i] = Normalize(pObject->pNormals[i]);
+//-----------------------------------------------------------------------------
+// This function computes the normals of the objects (job of
+// AJobSystem::parallelFor)
+//-----------------------------------------------------------------------------
 
-            vSum = vZero;
-            shared = 0;
-        }
+static void computeObjectNormals(int begin, int end, void *data)
+{
+    A3DModel *pModel = (A3DModel *) data;
 
-        delete [] pTempNormals;
-        delete [] pNormals;
-    }
+    for(int i = begin; i < end; i++)
+        computeObjectNormals(&(pModel->pObject[i]));
+}
+
+//-----------------------------------------------------------------------------
+// This function computes the vertex normals of the objects
+//-----------------------------------------------------------------------------
+
+void A3DSLoader::computeNormals(A3DModel *pModel)
+{
+    if(pModel->numOfObjects <= 0)
+        return;
+
+    // objects in parallel, big objects split their faces and vertices
+    AJobSystem::parallelFor(0, pModel->numOfObjects, computeObjectNormals, pModel, 1);
 }
 
 } // namespace astral3d
@@ -199,13 +199,58 @@ struct AIndices {
 struct AChunk
 {
     unsigned short int ID;
-    unsigned int length;
-    unsigned int bytesRead;
+    unsigned int begin;         // offset of the data in the file
+    unsigned int end;           // offset behind the chunk
+};
+
+//-----------------------------------------------------------------------------
+// Mapped file
+//-----------------------------------------------------------------------------
+/**
+ * Read-only file mapped to the memory.
+ * Files which can't be mapped are read by one fread call.
+ */
+class AMappedFile
+{
+public:
+    AMappedFile();
+    ~AMappedFile();
+
+    bool open(const char *filename);
+    void close();
+
+    const unsigned char *getData() const { return data; }
+    unsigned int getSize() const { return size; }
+
+private:
+    const unsigned char *data;
+    unsigned int size;
+
+    bool mapped;
+    std::vector<unsigned char> buffer;      // content of files which aren't mapped
+
+#ifdef WIN32
+    HANDLE file;
+    HANDLE mapping;
+#else
+    int file;
+#endif
+
+    // no copies of the mapping
+    AMappedFile(const AMappedFile &);
+    AMappedFile &operator=(const AMappedFile &);
 };
 
 //-----------------------------------------------------------------------------
 // 3DS Loader
 //-----------------------------------------------------------------------------
+/**
+ * Loader of the 3DS files.
+ * The file is mapped to the memory and the chunks are walked by their
+ * offsets, every chunk is checked against the end of its parent. The
+ * loader doesn't use OpenGL and keeps its error (getError), so it can run
+ * in the jobs of AJobSystem.
+ */
 class A3DSLoader
 {
 public:
@@ -213,35 +258,41 @@ public:
 
     bool load3DSModel(A3DModel *pModel, char *strFileName);
 
+    const AError &getError() const { return m_Error; }
+
 private:
-    int getString(char *);
+    void setError(const std::string &description, const std::string &sender, const std::string &failed);
+
+    bool readChunk(unsigned int offset, const AChunk &parent, AChunk *pChunk);
+
+    unsigned short readShort(unsigned int offset);
 
-    void readChunk(AChunk *);
+    unsigned int getString(unsigned int offset, unsigned int end, char *pBuffer, unsigned int size);
 
-    void processNexAChunk(A3DModel *pModel, AChunk *);
+    void processNextChunk(A3DModel *pModel, const AChunk &parent);
 
-    void processNextObjecAChunk(A3DModel *pModel, A3DObject *pObject, AChunk *);
+    void processNextObjectChunk(A3DModel *pModel, A3DObject *pObject, const AChunk &parent);
 
-    void processNextMaterialChunk(A3DModel *pModel, AChunk *);
+    void processNextMaterialChunk(A3DModel *pModel, const AChunk &parent);
 
-    void readColorChunk(AMaterialInfo *pMaterial, AChunk *pChunk);
+    void readColorChunk(AMaterialInfo *pMaterial, const AChunk &chunk);
 
-    void readVertices(A3DObject *pObject, AChunk *);
+    void readVertices(A3DObject *pObject, const AChunk &chunk);
 
-    void readVertexIndices(A3DObject *pObject, AChunk *);
+    unsigned int readVertexIndices(A3DObject *pObject, const AChunk &chunk);
 
-    void readUVCoordinates(A3DObject *pObject, AChunk *);
+    void readUVCoordinates(A3DObject *pObject, const AChunk &chunk);
 
-    void readObjectMaterial(A3DModel *pModel, A3DObject *pObject, AChunk *pPreviousChunk);
+    void readObjectMaterial(A3DModel *pModel, A3DObject *pObject, const AChunk &chunk);
 
     void computeNormals(A3DModel *pModel);
 
-    void cleanUp();
+    AMappedFile m_File;
 
-    FILE *m_FilePointer;
+    const unsigned char *m_Data;
+    unsigned int m_Size;
 
-    AChunk *m_CurrenAChunk;
-    AChunk *m_TempChunk;
+    AError m_Error;         // description of the failure of load3DSModel
 };
 
 } // namespace astral3d
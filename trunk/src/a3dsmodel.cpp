@@ -25,6 +25,7 @@
 ******************************************************************************/
 
 #include "a3dsmodel.h"
+#include "amodelloader.h"
 
 using namespace std;
 namespace astral3d {
@@ -35,6 +36,12 @@ namespace astral3d {
 
 A3DSModel::A3DSModel(char* filename, char *texturePath)
 {
+    m3DModel = NULL;
+    mLoad3ds = NULL;
+    buffered = true;
+    radius = 0.0;
+    drawnObjects = culledObjects = 0;
+    memset(TextureArray3ds, 0, sizeof(TextureArray3ds));
     load(filename, texturePath);
 }
 
@@ -50,6 +57,9 @@ A3DSModel *A3DSModel::load(char* filename, char *texturePath)
     cout << "vytvarim novy A3DModel a A3DSLoader" << endl;
 #endif
 
+    // the previous model and its loading in AModelLoader
+    destroy();
+
     // we create new model
     m3DModel = new A3DModel;
     if(!m3DModel)
@@ -85,8 +95,13 @@ A3DSModel *A3DSModel::load(char* filename, char *texturePath)
     bool foo = mLoad3ds->load3DSModel(m3DModel, filename);
     if(foo == false)
     {
+        AError error = mLoad3ds->getError();
+        setAstral3DError(error.errorDescription, error.senderFunction, error.failedFunction);
+
         delete mLoad3ds;
         delete m3DModel;
+        mLoad3ds = NULL;
+        m3DModel = NULL;
 
         throw AException("A3DSModel *A3DSModel::load(char* filename, char *texturePath)");
     }
@@ -96,37 +111,254 @@ A3DSModel *A3DSModel::load(char* filename, char *texturePath)
     cout << "nacitam textury modelu" << endl;
 #endif
 
-    // save texture path
-    string bar(texturePath);
-    this->texturePath = bar;
-
     // model is loaded we don't need this any more
     delete mLoad3ds;
+    mLoad3ds = NULL;
+
+    // we have to take care of the textures and load them, they are
+    // decoded in parallel
+    ATextureLoader loader;
+    addTextures(m3DModel, texturePath, &loader);
+
+    if(!loader.load())
+    {
+        destroy();
+        throw ATextureException("A3DSModel *A3DSModel::load(char* filename, char *texturePath)");
+    }
+
+#ifdef DEBUG
+    cout << "textury nacteny" << endl;
+#endif
+
+    // geometry is uploaded once, render() only draws it
+    create(m3DModel, texturePath);
+
+    return this;
+}
+
+//-----------------------------------------------------------------------------
+// This method adds the textures of the parsed model to the loader
+//-----------------------------------------------------------------------------
+
+void A3DSModel::addTextures(A3DModel *pModel, const char *texturePath, ATextureLoader *loader)
+{
+    for(int i = 0; i < MAXTEXTURE; i++)
+        TextureArray3ds[i] = 0;
+
+    for(int i=0; i<pModel->numOfMaterials; i++)
+    {
+        if(strlen(pModel->pMaterials[i].strFile) > 0 && i < MAXTEXTURE)
+        {
+            string buf(texturePath);
+            buf += pModel->pMaterials[i].strFile;
+
+            loader->add(buf.c_str(), &TextureArray3ds[i]);
+        }
+        pModel->pMaterials[i].texureId = i;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method takes the parsed model with loaded textures and creates the
+// buffers
+//-----------------------------------------------------------------------------
+
+void A3DSModel::create(A3DModel *pModel, const char *texturePath)
+{
+    m3DModel = pModel;
+    this->texturePath = texturePath;
+
+    createBounds();
+    createBuffers();
+}
+
+//-----------------------------------------------------------------------------
+// This method uploads every object to the vertex and index buffers
+//-----------------------------------------------------------------------------
 
-    // we have to take care of the textures and load them
-    for(int i=0; i<m3DModel->numOfMaterials; i++)
+void A3DSModel::createBuffers()
+{
+    destroyBuffers();
+
+    // we need to know if the driver supports vertex buffer objects
+    initExtensions();
+    bool vbo = isVBOSupported();
+
+    for(int i = 0; i < m3DModel->numOfObjects; i++)
     {
-        if(strlen(m3DModel->pMaterials[i].strFile) > 0)
+        A3DObject *pObject = &m3DModel->pObject[i];
+
+        A3DSObjectBuffer buffer;
+        buffer.vertexBuffer = 0;
+        buffer.indexBuffer = 0;
+        buffer.indexCount = pObject->numOfFaces * 3;
+
+        // interleaved vertices: u, v, nx, ny, nz, x, y, z
+        buffer.vertexData = new GLfloat[pObject->numOfVerts * 8];
+        buffer.indexData = new GLushort[buffer.indexCount];
+
+        for(int j = 0; j < pObject->numOfVerts; j++)
         {
-            char buf[256];
-            strcpy(buf, texturePath);
-            strcat(buf, m3DModel->pMaterials[i].strFile);
+            GLfloat *v = &buffer.vertexData[j * 8];
 
-            bool foo = loadTextureMipMap(buf, &TextureArray3ds[i]);
-            if(foo == false)
+            if(pObject->pTexVerts && j < pObject->numTexVertex)
+            {
+                v[0] = pObject->pTexVerts[j].x;
+                v[1] = pObject->pTexVerts[j].y;
+            }
+            else
             {
-                destroy();
-                throw ATextureException("A3DSModel *A3DSModel::load(char* filename, char *texturePath)");
+                v[0] = v[1] = 0.0f;
             }
+
+            v[2] = pObject->pNormals[j].x;
+            v[3] = pObject->pNormals[j].y;
+            v[4] = pObject->pNormals[j].z;
+            v[5] = pObject->pVerts[j].x;
+            v[6] = pObject->pVerts[j].y;
+            v[7] = pObject->pVerts[j].z;
+        }
+
+        // 3DS files store at most 65535 vertices in the object so short
+        // indices are always enough
+        for(int j = 0; j < pObject->numOfFaces; j++)
+        {
+            buffer.indexData[j * 3 + 0] = (GLushort) pObject->pFaces[j].vertIndex[0];
+            buffer.indexData[j * 3 + 1] = (GLushort) pObject->pFaces[j].vertIndex[1];
+            buffer.indexData[j * 3 + 2] = (GLushort) pObject->pFaces[j].vertIndex[2];
         }
-        m3DModel->pMaterials[i].texureId = i;
+
+        // if we can we move the data to the graphics card memory
+        if(vbo)
+        {
+            aglGenBuffersARB(1, &buffer.vertexBuffer);
+            aglBindBufferARB(GL_ARRAY_BUFFER_ARB, buffer.vertexBuffer);
+            aglBufferDataARB(GL_ARRAY_BUFFER_ARB, pObject->numOfVerts * 8 * sizeof(GLfloat),
+                             buffer.vertexData, GL_STATIC_DRAW_ARB);
+
+            aglGenBuffersARB(1, &buffer.indexBuffer);
+            aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, buffer.indexBuffer);
+            aglBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, buffer.indexCount * sizeof(GLushort),
+                             buffer.indexData, GL_STATIC_DRAW_ARB);
+
+            delete [] buffer.vertexData;
+            delete [] buffer.indexData;
+            buffer.vertexData = NULL;
+            buffer.indexData = NULL;
+        }
+
+        buffers.push_back(buffer);
     }
 
-#ifdef DEBUG
-    cout << "textury nacteny" << endl;
-#endif
+    if(vbo)
+    {
+        aglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    }
+}
 
-    return this;
+//-----------------------------------------------------------------------------
+// This method computes the bounding spheres of the objects and of the model
+//-----------------------------------------------------------------------------
+
+void A3DSModel::createBounds()
+{
+    objectCenters.clear();
+    objectRadii.clear();
+    center = AVector(0.0, 0.0, 0.0);
+    radius = 0.0;
+
+    AVector modelMin, modelMax;
+    bool empty = true;
+
+    for(int i = 0; i < m3DModel->numOfObjects; i++)
+    {
+        A3DObject *pObject = &m3DModel->pObject[i];
+
+        // sphere around the bounding box is good enough for culling
+        AVector min, max;
+        for(int j = 0; j < pObject->numOfVerts; j++)
+        {
+            AVector v(pObject->pVerts[j].x, pObject->pVerts[j].y, pObject->pVerts[j].z);
+
+            if(j == 0)
+            {
+                min = max = v;
+                continue;
+            }
+
+            if(v.x < min.x) min.x = v.x;
+            if(v.y < min.y) min.y = v.y;
+            if(v.z < min.z) min.z = v.z;
+            if(v.x > max.x) max.x = v.x;
+            if(v.y > max.y) max.y = v.y;
+            if(v.z > max.z) max.z = v.z;
+        }
+
+        AVector c = (min + max) * 0.5;
+        double r = 0.0;
+        for(int j = 0; j < pObject->numOfVerts; j++)
+        {
+            AVector v(pObject->pVerts[j].x, pObject->pVerts[j].y, pObject->pVerts[j].z);
+            double d = (v - c).getLength();
+            if(d > r)
+                r = d;
+        }
+
+        objectCenters.push_back(c);
+        objectRadii.push_back(r);
+
+        if(pObject->numOfVerts == 0)
+            continue;
+
+        if(empty)
+        {
+            modelMin = min;
+            modelMax = max;
+            empty = false;
+            continue;
+        }
+
+        if(min.x < modelMin.x) modelMin.x = min.x;
+        if(min.y < modelMin.y) modelMin.y = min.y;
+        if(min.z < modelMin.z) modelMin.z = min.z;
+        if(max.x > modelMax.x) modelMax.x = max.x;
+        if(max.y > modelMax.y) modelMax.y = max.y;
+        if(max.z > modelMax.z) modelMax.z = max.z;
+    }
+
+    if(empty)
+        return;
+
+    // the model sphere has to contain the spheres of all objects
+    center = (modelMin + modelMax) * 0.5;
+    for(unsigned int i = 0; i < objectCenters.size(); i++)
+    {
+        double d = (objectCenters[i] - center).getLength() + objectRadii[i];
+        if(d > radius)
+            radius = d;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method frees the vertex and index buffers
+//-----------------------------------------------------------------------------
+
+void A3DSModel::destroyBuffers()
+{
+    for(unsigned int i = 0; i < buffers.size(); i++)
+    {
+        if(buffers[i].vertexBuffer)
+            aglDeleteBuffersARB(1, &buffers[i].vertexBuffer);
+
+        if(buffers[i].indexBuffer)
+            aglDeleteBuffersARB(1, &buffers[i].indexBuffer);
+
+        delete [] buffers[i].vertexData;
+        delete [] buffers[i].indexData;
+    }
+
+    buffers.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -135,66 +367,282 @@ A3DSModel *A3DSModel::load(char* filename, char *texturePath)
 
 void A3DSModel::render()
 {
+    // model of AModelLoader which isn't loaded yet
+    if(m3DModel == NULL)
+        return;
+
+    if(!buffered || buffers.size() != m3DModel->pObject.size())
+    {
+        renderImmediate();
+        return;
+    }
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
     // render all objects building the model
     for(int i = 0; i < m3DModel->numOfObjects; i++)
     {
+        // material state is set once for the whole object
+        setMaterial(&m3DModel->pObject[i], getObjectPixels(i));
 
-        if(m3DModel->pObject.size() <= 0)
-            break;
+        bindBuffer(&buffers[i]);
+        drawBuffer(&buffers[i]);
+    }
 
-        A3DObject *pObject = &m3DModel->pObject[i];
+    if(isVBOSupported())
+    {
+        aglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    }
+
+    glPopClientAttrib();
+}
+
+//-----------------------------------------------------------------------------
+// This method draws the objects inside the frustum
+//-----------------------------------------------------------------------------
+
+void A3DSModel::render(const AFrustum &frustum, const double *transform)
+{
+    APROFILE("model");
+
+    drawnObjects = 0;
+    culledObjects = 0;
+
+    if(m3DModel == NULL || objectCenters.size() != m3DModel->pObject.size())
+        return;
+
+    // sphere centers go to the world space, radii are scaled by the
+    // largest scale of the matrix
+    double scale = 1.0;
+    if(transform)
+    {
+        for(int i = 0; i < 3; i++)
+        {
+            double s = sqrt(transform[i * 4] * transform[i * 4] +
+                            transform[i * 4 + 1] * transform[i * 4 + 1] +
+                            transform[i * 4 + 2] * transform[i * 4 + 2]);
+            if(i == 0 || s > scale)
+                scale = s;
+        }
+    }
+
+    AVector c = center;
+    if(transform)
+        c.applyMatrix(const_cast<double *>(transform));
+
+    // whole model is outside
+    if(!frustum.sphereInFrustum(c, radius * scale))
+    {
+        culledObjects = m3DModel->numOfObjects;
+        return;
+    }
+
+    bool useBuffers = buffered && buffers.size() == m3DModel->pObject.size();
+
+    if(useBuffers)
+        glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+    for(int i = 0; i < m3DModel->numOfObjects; i++)
+    {
+        c = objectCenters[i];
+        if(transform)
+            c.applyMatrix(const_cast<double *>(transform));
+
+        if(!frustum.sphereInFrustum(c, objectRadii[i] * scale))
+        {
+            culledObjects++;
+            continue;
+        }
+
+        drawnObjects++;
 
-        // if the object has the texture we use it
-        if(pObject->bHasTexture)
+        setMaterial(&m3DModel->pObject[i], getObjectPixels(i));
+
+        if(useBuffers)
         {
-            glEnable(GL_TEXTURE_2D);
-            glColor3ub(255, 255, 255);
-            glBindTexture(GL_TEXTURE_2D, TextureArray3ds[pObject->materialID]);
+            bindBuffer(&buffers[i]);
+            drawBuffer(&buffers[i]);
         }
         else
         {
-            glDisable(GL_TEXTURE_2D);
-            glColor3ub(255, 255, 255);
+            renderObjectImmediate(&m3DModel->pObject[i]);
         }
+    }
 
-        // triangles are building the object
-        glBegin(GL_TRIANGLES);
+    if(useBuffers)
+    {
+        if(isVBOSupported())
+        {
+            aglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+            aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+        }
 
-        for(int j = 0; j < pObject->numOfFaces; j++)
+        glPopClientAttrib();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method estimates the size of the object on the screen
+//-----------------------------------------------------------------------------
+
+int A3DSModel::getObjectPixels(int object)
+{
+    // the current modelview matrix already places the model
+    if(!ATextureStreamer::isEnabled() || !m3DModel->pObject[object].bHasTexture ||
+       objectCenters.size() != m3DModel->pObject.size())
+        return 0;
+
+    return ATextureStreamer::getScreenSize(objectCenters[object], objectRadii[object]);
+}
+
+//-----------------------------------------------------------------------------
+// This method sets the texture and the color of the object
+//-----------------------------------------------------------------------------
+
+void A3DSModel::setMaterial(A3DObject *pObject, int pixels)
+{
+    // the state cache drops the calls when the objects share the material
+    if(pObject->bHasTexture)
+    {
+        ARenderState::enable(GL_TEXTURE_2D);
+        glColor3ub(255, 255, 255);
+        ARenderState::bindTexture(TextureArray3ds[pObject->materialID]);
+        ATextureStreamer::use(TextureArray3ds[pObject->materialID], pixels);
+    }
+    else
+    {
+        ARenderState::disable(GL_TEXTURE_2D);
+        glColor3ub(255, 255, 255);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method sets the vertex arrays to the buffer of the object
+//-----------------------------------------------------------------------------
+
+void A3DSModel::bindBuffer(A3DSObjectBuffer *pBuffer)
+{
+    if(pBuffer->vertexBuffer)
+    {
+        // the data are in the graphics card memory, pointers are offsets
+        aglBindBufferARB(GL_ARRAY_BUFFER_ARB, pBuffer->vertexBuffer);
+        aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, pBuffer->indexBuffer);
+        glInterleavedArrays(GL_T2F_N3F_V3F, 0, NULL);
+    }
+    else
+    {
+        glInterleavedArrays(GL_T2F_N3F_V3F, 0, pBuffer->vertexData);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method draws the buffer set by bindBuffer
+//-----------------------------------------------------------------------------
+
+void A3DSModel::drawBuffer(A3DSObjectBuffer *pBuffer)
+{
+    ARenderState::countDrawCall();
+    glDrawElements(GL_TRIANGLES, pBuffer->indexCount, GL_UNSIGNED_SHORT,
+                   pBuffer->vertexBuffer ? NULL : pBuffer->indexData);
+}
+
+//-----------------------------------------------------------------------------
+// This method draws the model vertex by vertex in immediate mode
+//-----------------------------------------------------------------------------
+
+void A3DSModel::renderImmediate()
+{
+    // render all objects building the model
+    for(int i = 0; i < m3DModel->numOfObjects; i++)
+    {
+
+        if(m3DModel->pObject.size() <= 0)
+            break;
+
+        A3DObject *pObject = &m3DModel->pObject[i];
+
+        setMaterial(pObject, getObjectPixels(i));
+        renderObjectImmediate(pObject);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method draws one object vertex by vertex
+//-----------------------------------------------------------------------------
+
+void A3DSModel::renderObjectImmediate(A3DObject *pObject)
+{
+    // triangles are building the object
+    ARenderState::countDrawCall();
+    glBegin(GL_TRIANGLES);
+
+    for(int j = 0; j < pObject->numOfFaces; j++)
+    {
+        // draws one face - triangle
+        for(int whichVertex = 0; whichVertex < 3; whichVertex++)
         {
-            // draws one face - triangle
-            for(int whichVertex = 0; whichVertex < 3; whichVertex++)
-            {
-                // find the index of the vertex
-                int index = pObject->pFaces[j].vertIndex[whichVertex];
+            // find the index of the vertex
+            int index = pObject->pFaces[j].vertIndex[whichVertex];
 
-                // sets the vertex normal
-                glNormal3f(pObject->pNormals[ index ].x, pObject->pNormals[ index ].y, pObject->pNormals[ index ].z);
+            // sets the vertex normal
+            glNormal3f(pObject->pNormals[ index ].x, pObject->pNormals[ index ].y, pObject->pNormals[ index ].z);
 
-                // if the object has the texture we set it
-                if(pObject->bHasTexture)
+            // if the object has the texture we set it
+            if(pObject->bHasTexture)
+            {
+                // vertex needs to have the texture coordinates to be able to use the texture
+                if(pObject->pTexVerts)
                 {
-                    // vertex needs to have the texture coordinates to be able to use the texture
-                    if(pObject->pTexVerts)
-                    {
-                        glTexCoord2f(pObject->pTexVerts[ index ].x, pObject->pTexVerts[ index ].y);
-                    }
+                    glTexCoord2f(pObject->pTexVerts[ index ].x, pObject->pTexVerts[ index ].y);
                 }
-                else
+            }
+            else
+            {
+                // object hasn't the texture we use color if we are able to
+                if((int)m3DModel->pMaterials.size() < pObject->materialID)
                 {
-                    // object hasn't the texture we use color if we are able to
-                    if((int)m3DModel->pMaterials.size() < pObject->materialID)
-                    {
-                        int *pColor = m3DModel->pMaterials[pObject->materialID].color;
-                        glColor3ub(pColor[0], pColor[1], pColor[2]);
-                    }
+                    int *pColor = m3DModel->pMaterials[pObject->materialID].color;
+                    glColor3ub(pColor[0], pColor[1], pColor[2]);
                 }
-                // finally we draw the vertex
-                glVertex3f(pObject->pVerts[ index ].x, pObject->pVerts[ index ].y, pObject->pVerts[ index ].z);
             }
+            // finally we draw the vertex
+            glVertex3f(pObject->pVerts[ index ].x, pObject->pVerts[ index ].y, pObject->pVerts[ index ].z);
         }
-        glEnd();
     }
+    glEnd();
+}
+
+//-----------------------------------------------------------------------------
+// This method releases the textures
+//-----------------------------------------------------------------------------
+
+void A3DSModel::destroyTextures()
+{
+    // textures are shared by ATextureManager, this releases the references
+    for(int i = 0; i < MAXTEXTURE; i++)
+    {
+        if(TextureArray3ds[i])
+            deleteTexture(&TextureArray3ds[i]);
+        TextureArray3ds[i] = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method frees the model data
+//-----------------------------------------------------------------------------
+
+void A3DSModel::destroyModel(A3DModel *pModel)
+{
+    for(int i = 0; i < pModel->numOfObjects; i++)
+    {
+        delete [] pModel->pObject[i].pFaces;
+        delete [] pModel->pObject[i].pNormals;
+        delete [] pModel->pObject[i].pVerts;
+        delete [] pModel->pObject[i].pTexVerts;
+    }
+
+    delete pModel;
 }
 
 //-----------------------------------------------------------------------------
@@ -203,18 +651,16 @@ void A3DSModel::render()
 
 void A3DSModel::destroy()
 {
+    // the jobs of AModelLoader write to the model
+    AModelLoader::cancel(this);
+
     if(m3DModel == NULL)
         return;
 
-    for(int i = 0; i < m3DModel->numOfObjects; i++)
-    {
-        delete [] m3DModel->pObject[i].pFaces;
-        delete [] m3DModel->pObject[i].pNormals;
-        delete [] m3DModel->pObject[i].pVerts;
-        delete [] m3DModel->pObject[i].pTexVerts;
-    }
+    destroyBuffers();
+    destroyTextures();
 
-    delete m3DModel;
+    destroyModel(m3DModel);
     m3DModel = NULL;
 }
 
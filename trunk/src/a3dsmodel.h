@@ -50,6 +50,11 @@
 #include <GL/glu.h>
 
 #include "atexture.h"
+#include "aextensions.h"
+#include "aprofiler.h"
+#include "atextureloader.h"
+#include "afrustum.h"
+#include "avector.h"
 #include "a3ds.h"
 #include "aerror.h"
 #include "aabstract.h"
@@ -62,6 +67,23 @@ namespace astral3d {
 
 #define MAXTEXTURE 100
 
+class AModelLoader;
+
+/**
+ * Vertex and index buffers of one object of the 3DS model.
+ * Vertices are interleaved in GL_T2F_N3F_V3F format. If vertex buffer
+ * objects aren't supported by the driver the data stay in the client memory
+ * and are drawn as vertex arrays.
+ */
+struct A3DSObjectBuffer
+{
+    GLuint    vertexBuffer;     // VBO with vertices (0 if client arrays are used)
+    GLuint    indexBuffer;      // VBO with indices (0 if client arrays are used)
+    GLfloat  *vertexData;       // client copy of vertices (NULL if VBO is used)
+    GLushort *indexData;        // client copy of indices (NULL if VBO is used)
+    GLsizei   indexCount;       // number of indices (3 per face)
+};
+
 /**
  * Class for loading and displaying 3D Studio (3DS) models.
  */
@@ -73,11 +95,70 @@ class A3DSModel : public Model3D
     GLuint TextureArray3ds[MAXTEXTURE];   // textures for 3ds model
     std::string texturePath;              // texture path directory
 
+    std::vector<A3DSObjectBuffer> buffers;  // buffers of the objects
+    bool buffered;                          // render from buffers
+
+    // bounding spheres of the objects and of the whole model
+    std::vector<AVector> objectCenters;
+    std::vector<double> objectRadii;
+    AVector center;
+    double radius;
+
+    unsigned int drawnObjects;              // objects drawn by the last render
+    unsigned int culledObjects;             // objects culled by the last render
+
+    // computes the bounding spheres
+    void createBounds();
+
+    // adds the textures of the parsed model to the loader
+    void addTextures(A3DModel *pModel, const char *texturePath, ATextureLoader *loader);
+
+    // takes the parsed model with loaded textures and creates the buffers
+    void create(A3DModel *pModel, const char *texturePath);
+
+    // uploads all objects to the buffers
+    void createBuffers();
+
+    // frees the buffers
+    void destroyBuffers();
+
+    // releases the textures
+    void destroyTextures();
+
+    // frees the model data
+    static void destroyModel(A3DModel *pModel);
+
+    // renders the model in immediate mode
+    void renderImmediate();
+
+    // renders one object in immediate mode
+    void renderObjectImmediate(A3DObject *pObject);
+
+    // returns the size of the textured object on the screen for
+    // ATextureStreamer::use, 0 for all levels
+    int getObjectPixels(int object);
+
+    // sets texture and color of the object, pixels is its size on the screen
+    void setMaterial(A3DObject *pObject, int pixels = 0);
+
+    // sets vertex arrays to the buffer
+    static void bindBuffer(A3DSObjectBuffer *pBuffer);
+
+    // draws the bound buffer
+    static void drawBuffer(A3DSObjectBuffer *pBuffer);
+
+    // instance batches draw the buffers of the model
+    friend class AInstanceBatch;
+
+    // asynchronous loading
+    friend class AModelLoader;
+
   public:
     /**
      * Constructor.
      */
-    A3DSModel() { m3DModel = NULL; mLoad3ds = NULL; }
+    A3DSModel() { m3DModel = NULL; mLoad3ds = NULL; buffered = true; radius = 0.0; drawnObjects = culledObjects = 0;
+                  memset(TextureArray3ds, 0, sizeof(TextureArray3ds)); }
 
     /**
      * Constructor.
@@ -98,7 +179,8 @@ class A3DSModel : public Model3D
 
     /**
      * Loads the model.
-     * Loads 3DS model from the file.
+     * Loads 3DS model from the file. AModelLoader::load loads the model
+     * in the background.
      * @param filename Filename of the 3DS model
      * @param texturePath Path to the directory containing model textures
      * @return Pointer to this instance
@@ -108,15 +190,70 @@ class A3DSModel : public Model3D
      * @throw ATextureException
      */
     A3DSModel *load(char* filename, char *texturePath);
+    /**
+     * Tests if the model is loaded.
+     * The model loaded by AModelLoader isn't loaded until
+     * AModelLoader::update creates it.
+     * @return True if the model can be rendered
+     */
+    bool isLoaded() { return m3DModel != NULL; }
     /**
      * Renderes the model.
+     * Every object of the model is drawn with a single glDrawElements call
+     * from its vertex and index buffers. Material state is set once per
+     * object.
      * @see load
+     * @see setBufferedRendering
      */
     void render();
+    /**
+     * Renders the visible part of the model.
+     * The bounding sphere of the whole model is tested first, then the spheres
+     * of the single objects. Only objects intersecting the frustum are drawn.
+     * @param frustum View frustum in the world space (see ACamera::getFrustum)
+     * @param transform OpenGL matrix placing the model in the world or NULL
+     *                  if the model is drawn in the world coordinates. The
+     *                  matrix isn't applied, it must be already set in the
+     *                  modelview matrix.
+     * @see getDrawnObjects
+     * @see getCulledObjects
+     */
+    void render(const AFrustum &frustum, const double *transform = NULL);
+    /**
+     * Returns the number of drawn objects.
+     * @return Number of objects drawn by the last render call
+     */
+    unsigned int getDrawnObjects() { return drawnObjects; }
+    /**
+     * Returns the number of culled objects.
+     * @return Number of objects skipped by the last render call
+     */
+    unsigned int getCulledObjects() { return culledObjects; }
+    /**
+     * Returns the bounding sphere of the model.
+     * @param center Center of the sphere in the model coordinates
+     * @return Radius of the sphere
+     */
+    double getBoundingSphere(AVector &center) { center = this->center; return radius; }
+    /**
+     * Enables or disables rendering from the buffers.
+     * Buffered rendering is enabled by default. When it is disabled the model
+     * is drawn vertex by vertex in immediate mode. This is useful only for
+     * comparing the speed of both methods.
+     * @param buffered True to render from vertex and index buffers
+     */
+    void setBufferedRendering(bool buffered) { this->buffered = buffered; }
+    /**
+     * Returns true if the model is rendered from the buffers.
+     * @return True if buffered rendering is enabled
+     * @see setBufferedRendering
+     */
+    bool isBufferedRendering() { return buffered; }
     /**
      * Destroys the model.
      * This method frees the memory and destroys the model. This method is called
-     * automatically from the destructor.
+     * automatically from the destructor. Loading of the model by AModelLoader
+     * is canceled.
      */
     void destroy();
     /**
@@ -0,0 +1,363 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "aatlas.h"
+
+#ifndef GL_TEXTURE_MAX_LEVEL
+    #define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+using namespace std;
+namespace astral3d {
+
+// rounds up to the power of two
+static int powerOfTwo(int value)
+{
+    int result = 1;
+    while(result < value)
+        result <<= 1;
+    return result;
+}
+
+// rounds up to the multiple of step
+static int roundUp(int value, int step)
+{
+    return (value + step - 1) / step * step;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+AAtlas::AAtlas(int pageWidth, int pageHeight, int padding)
+{
+    this->pageWidth = powerOfTwo(pageWidth);
+    this->pageHeight = powerOfTwo(pageHeight);
+    this->padding = padding > 0 ? powerOfTwo(padding) : 0;
+    this->mipmap = false;
+    this->built = false;
+}
+
+//-----------------------------------------------------------------------------
+// destroy
+//-----------------------------------------------------------------------------
+
+void AAtlas::destroy()
+{
+    for(unsigned int i = 0; i < images.size(); i++)
+        delete [] images[i].data;
+    images.clear();
+
+    for(unsigned int i = 0; i < pages.size(); i++)
+        deleteTexture(&pages[i]);
+    pages.clear();
+
+    built = false;
+}
+
+//-----------------------------------------------------------------------------
+// addImage
+//-----------------------------------------------------------------------------
+
+int AAtlas::addImage(char *filename)
+{
+    SDL_Surface *surface = IMG_Load(filename);
+    if(!surface)
+    {
+        stringstream foo;
+        stringstream bar;
+        foo << "AAtlas::addImage(\""<<filename<<"\")";
+        bar << "IMG_Load("<<filename<<")";
+        setAstral3DError("Can't open file with the texture", foo.str(), bar.str());
+        return -1;
+    }
+
+    int image = addImage(surface, fileType(filename));
+    SDL_FreeSurface(surface);
+
+    return image;
+}
+
+//-----------------------------------------------------------------------------
+// addImage
+//-----------------------------------------------------------------------------
+
+int AAtlas::addImage(SDL_Surface *surface, int type)
+{
+    if(built)
+    {
+        stringstream foo;
+        foo << "AAtlas::addImage("<<surface<<", "<<type<<")";
+        setAstral3DError("The atlas is already built", foo.str(), "N/A");
+        return -1;
+    }
+
+    if(!surface)
+    {
+        stringstream foo;
+        foo << "AAtlas::addImage("<<surface<<", "<<type<<")";
+        setAstral3DError("Can't read SDL_Surface structure", foo.str(), "SDL_Surface is NULL");
+        return -1;
+    }
+
+    if(roundUp(surface->w + 2 * padding, padding ? padding : 1) > pageWidth ||
+       roundUp(surface->h + 2 * padding, padding ? padding : 1) > pageHeight)
+    {
+        stringstream foo;
+        stringstream bar;
+        foo << "AAtlas::addImage("<<surface<<", "<<type<<")";
+        bar << surface->w << "x" << surface->h << " image, " << pageWidth << "x" << pageHeight << " page";
+        setAstral3DError("The image doesn't fit to the page of the atlas", foo.str(), bar.str());
+        return -1;
+    }
+
+    Image image;
+    image.data = getTextureData(surface, type);
+    if(!image.data)
+        return -1;
+
+    image.width = surface->w;
+    image.height = surface->h;
+    image.page = -1;
+    image.x = 0;
+    image.y = 0;
+
+    images.push_back(image);
+
+    return images.size() - 1;
+}
+
+//-----------------------------------------------------------------------------
+// order of packing
+//-----------------------------------------------------------------------------
+
+bool AAtlas::compare(const Image *a, const Image *b)
+{
+    // the shelves are filled best from the highest images
+    if(a->height != b->height)
+        return a->height > b->height;
+
+    return a->width > b->width;
+}
+
+//-----------------------------------------------------------------------------
+// pack
+//-----------------------------------------------------------------------------
+
+void AAtlas::pack()
+{
+    int step = padding ? padding : 1;
+
+    vector<Image*> order(images.size());
+    for(unsigned int i = 0; i < images.size(); i++)
+        order[i] = &images[i];
+
+    stable_sort(order.begin(), order.end(), compare);
+
+    // shelf packing, cells are aligned to the padding so the blocks of
+    // the mipmaps never cross two cells
+    int page = 0;
+    int x = 0;
+    int y = 0;
+    int shelfHeight = 0;
+
+    for(unsigned int i = 0; i < order.size(); i++)
+    {
+        int cellWidth = roundUp(order[i]->width + 2 * padding, step);
+        int cellHeight = roundUp(order[i]->height + 2 * padding, step);
+
+        if(x + cellWidth > pageWidth)
+        {
+            x = 0;
+            y += shelfHeight;
+            shelfHeight = 0;
+        }
+
+        if(y + cellHeight > pageHeight)
+        {
+            page++;
+            x = 0;
+            y = 0;
+            shelfHeight = 0;
+        }
+
+        order[i]->page = page;
+        order[i]->x = x + padding;
+        order[i]->y = y + padding;
+
+        x += cellWidth;
+        shelfHeight = max(shelfHeight, cellHeight);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// copyImage
+//-----------------------------------------------------------------------------
+
+void AAtlas::copyImage(const Image &image, unsigned char *page)
+{
+    int step = padding ? padding : 1;
+    int cellWidth = roundUp(image.width + 2 * padding, step);
+    int cellHeight = roundUp(image.height + 2 * padding, step);
+    int cellX = image.x - padding;
+    int cellY = image.y - padding;
+
+    // the whole cell is filled, pixels outside the image repeat its edge
+    for(int j = 0; j < cellHeight; j++)
+    {
+        int sy = min(max(j - padding, 0), image.height - 1);
+        unsigned char *target = page + ((cellY + j) * pageWidth + cellX) * 3;
+        const unsigned char *row = image.data + sy * image.width * 3;
+
+        for(int i = 0; i < cellWidth; i++)
+        {
+            int sx = min(max(i - padding, 0), image.width - 1);
+            target[i * 3 + 0] = row[sx * 3 + 0];
+            target[i * 3 + 1] = row[sx * 3 + 1];
+            target[i * 3 + 2] = row[sx * 3 + 2];
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// build
+//-----------------------------------------------------------------------------
+
+bool AAtlas::build(bool mipmap)
+{
+    if(built)
+        return true;
+
+    this->mipmap = mipmap;
+
+    pack();
+
+    int numOfPages = 0;
+    for(unsigned int i = 0; i < images.size(); i++)
+        numOfPages = max(numOfPages, images[i].page + 1);
+
+    vector<unsigned char> pixels(pageWidth * pageHeight * 3);
+
+    // highest mipmap level not mixing the images
+    int maxLevel = 0;
+    while((2 << maxLevel) <= padding)
+        maxLevel++;
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    for(int p = 0; p < numOfPages; p++)
+    {
+        fill(pixels.begin(), pixels.end(), 0);
+
+        for(unsigned int i = 0; i < images.size(); i++)
+        {
+            if(images[i].page == p)
+                copyImage(images[i], &pixels[0]);
+        }
+
+        GLuint texture;
+        glGenTextures(1, &texture);
+        ARenderState::bindTexture(texture);
+        pages.push_back(texture);
+
+        if(mipmap)
+        {
+            gluBuild2DMipmaps(GL_TEXTURE_2D, 3, pageWidth, pageHeight, GL_RGB,
+                              GL_UNSIGNED_BYTE, &pixels[0]);
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, maxLevel);
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                            GL_LINEAR_MIPMAP_NEAREST);
+        }
+        else
+        {
+            glTexImage2D(GL_TEXTURE_2D, 0, 3, pageWidth, pageHeight, 0,
+                         GL_RGB, GL_UNSIGNED_BYTE, &pixels[0]);
+
+            glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        }
+
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // the pixels are in the pages now
+    for(unsigned int i = 0; i < images.size(); i++)
+    {
+        delete [] images[i].data;
+        images[i].data = NULL;
+    }
+
+    built = true;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// getTexture
+//-----------------------------------------------------------------------------
+
+GLuint AAtlas::getTexture(int image)
+{
+    if(!built || image < 0 || image >= (int) images.size())
+        return 0;
+
+    return pages[images[image].page];
+}
+
+//-----------------------------------------------------------------------------
+// getPosition
+//-----------------------------------------------------------------------------
+
+void AAtlas::getPosition(int image, int *x, int *y)
+{
+    *x = images[image].x;
+    *y = images[image].y;
+}
+
+//-----------------------------------------------------------------------------
+// getMapping
+//-----------------------------------------------------------------------------
+
+void AAtlas::getMapping(int image, double *offset, double *scale)
+{
+    offset[0] = (double) images[image].x / pageWidth;
+    offset[1] = (double) images[image].y / pageHeight;
+    scale[0] = (double) images[image].width / pageWidth;
+    scale[1] = (double) images[image].height / pageHeight;
+}
+
+//-----------------------------------------------------------------------------
+// getEfficiency
+//-----------------------------------------------------------------------------
+
+double AAtlas::getEfficiency()
+{
+    if(pages.empty())
+        return 0.0;
+
+    double used = 0.0;
+    for(unsigned int i = 0; i < images.size(); i++)
+        used += (double) images[i].width * images[i].height;
+
+    return used / ((double) pages.size() * pageWidth * pageHeight);
+}
+
+} // namespace astral3d
@@ -0,0 +1,235 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file aatlas.h AAtlas class.
+ */
+#ifndef AATLAS_H
+#define AATLAS_H
+
+#ifdef WIN32
+    #include <windows.h>
+    #include <SDL.h>
+    #include <SDL_image.h>
+#else
+    #include "SDL.h"
+    #include "SDL_image.h"
+#endif
+
+#include <vector>
+#include <algorithm>
+#include <sstream>
+#include <GL/gl.h>
+#include <GL/glu.h>
+
+#include "aerror.h"
+#include "atexture.h"
+#include "arenderstate.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Texture atlas.
+ * Many small images are packed at load time into a few large textures
+ * (pages) so that the things using them can share one texture bind.
+ * Images are added by AAtlas::addImage and packed and uploaded by
+ * AAtlas::build. ASurface, AText2D and ALevel remap their texture
+ * coordinates to the atlas themselves.
+ * @n
+ * @n
+ * Every image is surrounded by at least @a padding pixels copied from its
+ * edges and placed at a multiple of the padding, so mipmap levels up to
+ * log2(padding) never mix two images. Higher levels are not used. Images
+ * are only usable for texture coordinates from 0 to 1, repeated textures
+ * must stay in their own textures.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * AAtlas atlas(1024, 1024, 4);
+ * int panel = atlas.addImage("panel.png");
+ * int font = atlas.addImage("font.bmp");
+ * level.addToAtlas(&atlas, "textures/");
+ * atlas.build();
+ * level.useAtlas();
+ * ASurface hud(&atlas, panel, &window);
+ * text.build(&atlas, font, 16, 640, 480, 256, 256, 16, 16);
+ * cout << atlas.getPageCount() << " pages, " << atlas.getEfficiency() * 100 << "% used" << endl;
+ * @endcode
+ */
+class AAtlas
+{
+    private:
+        struct Image
+        {
+            unsigned char *data;    // RGB pixels until the atlas is built
+            int width;
+            int height;
+            int page;               // position in the atlas
+            int x;
+            int y;
+        };
+
+        // images in the order of packing
+        static bool compare(const Image *a, const Image *b);
+
+        int pageWidth;
+        int pageHeight;
+        int padding;
+        bool mipmap;
+        bool built;
+
+        std::vector<Image> images;
+        std::vector<GLuint> pages;          // page textures
+
+        // places the images to the pages
+        void pack();
+
+        // copies the image with its padding to the page
+        void copyImage(const Image &image, unsigned char *page);
+
+    public:
+        /**
+         * Constructor.
+         * Sizes of the pages are rounded up to the power of two, the
+         * padding too.
+         * @param pageWidth Width of one page
+         * @param pageHeight Height of one page
+         * @param padding Minimal number of pixels around every image
+         */
+        AAtlas(int pageWidth = 1024, int pageHeight = 1024, int padding = 4);
+
+        /**
+         * Destructor.
+         * Calls AAtlas::destroy method.
+         */
+        ~AAtlas() { destroy(); }
+
+        /**
+         * Frees the pages and the images.
+         */
+        void destroy();
+
+        /**
+         * Adds the image to the atlas.
+         * @param filename Image filename (BMP, TGA, PNG, JPEG)
+         * @return Index of the image or -1 if the image can't be loaded,
+         * doesn't fit to the page or the atlas is already built
+         */
+        int addImage(char *filename);
+
+        /**
+         * Adds the image to the atlas.
+         * @param image Pointer to the SDL_Surface structure
+         * @param type Type of the image in the surface (BMP, TGA, PNG, JPG)
+         * @return Index of the image or -1 if the image doesn't fit to the
+         * page or the atlas is already built
+         */
+        int addImage(SDL_Surface *image, int type = BMP);
+
+        /**
+         * Packs the images and creates the pages.
+         * @param mipmap Create mipmaps (needs the padding)
+         * @return True if the pages are created successfuly
+         */
+        bool build(bool mipmap = true);
+
+        /**
+         * Returns whether the atlas is built.
+         * @return True after AAtlas::build
+         */
+        bool isBuilt() { return built; }
+
+        /**
+         * Returns the texture with the image.
+         * @param image Index of the image
+         * @return Texture ID of the page or 0 before AAtlas::build
+         */
+        GLuint getTexture(int image);
+
+        /**
+         * Returns the position of the image in its page.
+         * @param image Index of the image
+         * @param x x-position of the image in pixels
+         * @param y y-position of the image in pixels
+         */
+        void getPosition(int image, int *x, int *y);
+
+        /**
+         * Returns the width of the image.
+         * @param image Index of the image
+         * @return Width in pixels
+         */
+        int getImageWidth(int image) { return images[image].width; }
+
+        /**
+         * Returns the height of the image.
+         * @param image Index of the image
+         * @return Height in pixels
+         */
+        int getImageHeight(int image) { return images[image].height; }
+
+        /**
+         * Returns the mapping of the texture coordinates.
+         * Coordinate u of the image is (offset[0] + u * scale[0]) in the
+         * page, v the same with the second items.
+         * @param image Index of the image
+         * @param offset Array of two offsets
+         * @param scale Array of two scales
+         */
+        void getMapping(int image, double *offset, double *scale);
+
+        /**
+         * Returns the width of the pages.
+         * @return Width of the page in pixels
+         */
+        int getPageWidth() { return pageWidth; }
+
+        /**
+         * Returns the height of the pages.
+         * @return Height of the page in pixels
+         */
+        int getPageHeight() { return pageHeight; }
+
+        /**
+         * Returns the number of pages.
+         * @return Number of created textures
+         */
+        unsigned int getPageCount() { return pages.size(); }
+
+        /**
+         * Returns the number of images.
+         * @return Number of added images
+         */
+        unsigned int getImageCount() { return images.size(); }
+
+        /**
+         * Returns the packing efficiency.
+         * @return Pixels of the images divided by pixels of all pages (0 to 1)
+         */
+        double getEfficiency();
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef AATLAS_H
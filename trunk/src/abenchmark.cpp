@@ -0,0 +1,294 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "abenchmark.h"
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+ABenchmark::ABenchmark(AWindow *window)
+{
+    if(!window)
+    {
+        throw ANullPointerException("ABenchmark::ABenchmark(AWindow *window)");
+    }
+
+    this->window = window;
+    frames = 100;
+    warmupFrames = 10;
+    checksums = false;
+}
+
+//-----------------------------------------------------------------------------
+// addKey
+//-----------------------------------------------------------------------------
+
+void ABenchmark::addKey(const AVector &eye, const AVector &target)
+{
+    eyes.push_back(eye);
+    targets.push_back(target);
+}
+
+//-----------------------------------------------------------------------------
+// loadPath
+//-----------------------------------------------------------------------------
+
+void ABenchmark::loadPath(char *filename)
+{
+    ifstream file;
+    file.open(filename);
+
+    if(!file.is_open())
+    {
+        stringstream foo;
+        stringstream bar;
+        foo << "ABenchmark::loadPath(\""<<filename<<"\")";
+        bar << "ifstream.open(\"" << filename << "\")";
+        setAstral3DError("Can't open file", foo.str(), bar.str());
+
+        throw AReadFileException("void ABenchmark::loadPath(char *filename)");
+    }
+
+    AVector eye, target;
+    while(file >> eye.x >> eye.y >> eye.z >> target.x >> target.y >> target.z)
+        addKey(eye, target);
+
+    file.close();
+}
+
+//-----------------------------------------------------------------------------
+// setFrames
+//-----------------------------------------------------------------------------
+
+void ABenchmark::setFrames(int frames, int warmupFrames)
+{
+    this->frames = frames > 0 ? frames : 1;
+    this->warmupFrames = warmupFrames > 0 ? warmupFrames : 0;
+}
+
+//-----------------------------------------------------------------------------
+// position on the path
+//-----------------------------------------------------------------------------
+
+// Catmull-Rom spline through p1 and p2
+static AVector catmullRom(const AVector &p0, const AVector &p1, const AVector &p2, const AVector &p3, double f)
+{
+    return 0.5 * ((p1 * 2.0) +
+                  (p2 - p0) * f +
+                  (p0 * 2.0 - p1 * 5.0 + p2 * 4.0 - p3) * (f * f) +
+                  (p1 * 3.0 - p0 - p2 * 3.0 + p3) * (f * f * f));
+}
+
+void ABenchmark::getCamera(double t, AVector *eye, AVector *target)
+{
+    int keys = eyes.size();
+    if(keys == 1)
+    {
+        *eye = eyes[0];
+        *target = targets[0];
+        return;
+    }
+
+    double s = t * (keys - 1);
+    int i = min((int) s, keys - 2);
+    double f = s - i;
+
+    int i0 = max(i - 1, 0);
+    int i3 = min(i + 2, keys - 1);
+
+    *eye = catmullRom(eyes[i0], eyes[i], eyes[i + 1], eyes[i3], f);
+    *target = catmullRom(targets[i0], targets[i], targets[i + 1], targets[i3], f);
+}
+
+//-----------------------------------------------------------------------------
+// checksum of the image
+//-----------------------------------------------------------------------------
+
+unsigned int ABenchmark::computeChecksum()
+{
+    int width = window->getWidth();
+    int height = window->getHeight();
+
+    pixels.resize(width * height * 4);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &pixels[0]);
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+    // FNV-1a
+    unsigned int hash = 2166136261u;
+    for(unsigned int i = 0; i < pixels.size(); i++)
+    {
+        hash ^= pixels[i];
+        hash *= 16777619u;
+    }
+
+    return hash;
+}
+
+//-----------------------------------------------------------------------------
+// run
+//-----------------------------------------------------------------------------
+
+void ABenchmark::run(ABenchmarkScene scene, void *data)
+{
+    if(!scene)
+    {
+        throw ANullPointerException("void ABenchmark::run(ABenchmarkScene scene, void *data)");
+    }
+
+    if(eyes.empty())
+    {
+        setAstral3DError("The path of the camera is empty", "ABenchmark::run()", "ABenchmark::addKey");
+
+        throw AIllegalArgumentException("void ABenchmark::run(ABenchmarkScene scene, void *data)");
+    }
+
+    frameTimes.clear();
+    frameChecksums.clear();
+
+    for(int frame = -warmupFrames; frame < frames; frame++)
+    {
+        // warm-up frames stay at the start of the path
+        double t = (frame > 0 && frames > 1) ? (double) frame / (frames - 1) : 0.0;
+
+        AVector eye, target;
+        getCamera(t, &eye, &target);
+
+        double start = AProfiler::getTime();
+
+        ARenderState::beginFrame();
+        glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+        glMatrixMode(GL_MODELVIEW);
+        glLoadIdentity();
+        gluLookAt(eye.x, eye.y, eye.z, target.x, target.y, target.z, 0.0, 1.0, 0.0);
+
+        // frustum of the current matrices
+        double projection[16], modelview[16], matrix[16];
+        glGetDoublev(GL_PROJECTION_MATRIX, projection);
+        glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+        for(int c = 0; c < 4; c++)
+        {
+            for(int r = 0; r < 4; r++)
+            {
+                matrix[c * 4 + r] = 0.0;
+                for(int k = 0; k < 4; k++)
+                    matrix[c * 4 + r] += projection[k * 4 + r] * modelview[c * 4 + k];
+            }
+        }
+
+        AFrustum frustum;
+        frustum.set(matrix, eye);
+
+        scene(frustum, data);
+
+        glFinish();
+
+        double time = AProfiler::getTime() - start;
+
+        if(frame >= 0)
+        {
+            frameTimes.push_back(time);
+
+            if(checksums)
+                frameChecksums.push_back(computeChecksum());
+        }
+
+        window->swapBuffers();
+    }
+}
+
+//-----------------------------------------------------------------------------
+// checksum of all frames
+//-----------------------------------------------------------------------------
+
+unsigned int ABenchmark::getChecksum()
+{
+    unsigned int hash = 2166136261u;
+    for(unsigned int i = 0; i < frameChecksums.size(); i++)
+    {
+        for(int b = 0; b < 4; b++)
+        {
+            hash ^= (frameChecksums[i] >> (b * 8)) & 0xff;
+            hash *= 16777619u;
+        }
+    }
+
+    return frameChecksums.empty() ? 0 : hash;
+}
+
+//-----------------------------------------------------------------------------
+// getAverageTime
+//-----------------------------------------------------------------------------
+
+double ABenchmark::getAverageTime()
+{
+    if(frameTimes.empty())
+        return 0.0;
+
+    double sum = 0.0;
+    for(unsigned int i = 0; i < frameTimes.size(); i++)
+        sum += frameTimes[i];
+
+    return sum / frameTimes.size();
+}
+
+//-----------------------------------------------------------------------------
+// getPercentile
+//-----------------------------------------------------------------------------
+
+double ABenchmark::getPercentile(double percent)
+{
+    if(frameTimes.empty())
+        return 0.0;
+
+    vector<double> sorted(frameTimes);
+    sort(sorted.begin(), sorted.end());
+
+    percent = max(0.0, min(100.0, percent));
+    int index = (int) (percent / 100.0 * (sorted.size() - 1) + 0.5);
+
+    return sorted[index];
+}
+
+//-----------------------------------------------------------------------------
+// report
+//-----------------------------------------------------------------------------
+
+void ABenchmark::report(ostream &out)
+{
+    double average = getAverageTime();
+
+    out << "frames:  " << frameTimes.size() << " (" << window->getWidth() << "x" << window->getHeight()
+        << (window->isOffscreen() ? ", offscreen)" : ")") << endl;
+    out << "average: " << average << " ms (" << (average > 0.0 ? 1000.0 / average : 0.0) << " fps)" << endl;
+    out << "min:     " << getPercentile(0.0) << " ms" << endl;
+    out << "median:  " << getPercentile(50.0) << " ms" << endl;
+    out << "95%:     " << getPercentile(95.0) << " ms" << endl;
+    out << "max:     " << getPercentile(100.0) << " ms" << endl;
+
+    if(!frameChecksums.empty())
+        out << "checksum: " << hex << getChecksum() << dec << endl;
+}
+
+} // namespace astral3d
@@ -0,0 +1,209 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file abenchmark.h ABenchmark class.
+ */
+#ifndef ABENCHMARK_H
+#define ABENCHMARK_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <vector>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <algorithm>
+#include <GL/gl.h>
+#include <GL/glu.h>
+
+#include "avector.h"
+#include "afrustum.h"
+#include "awindow.h"
+#include "arenderstate.h"
+#include "aprofiler.h"
+#include "aerror.h"
+#include "aexceptions.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Function drawing the scene of the benchmark.
+ * The camera is already set in the modelview matrix, the frustum belongs
+ * to it.
+ */
+typedef void (*ABenchmarkScene)(const AFrustum &frustum, void *data);
+
+/**
+ * Render benchmark.
+ * The camera flies through the scene along the path given by key positions
+ * (Catmull-Rom spline through the keys), the scene is drawn by the given
+ * function every frame and the time of every frame is measured (from the
+ * clear to glFinish). Optionally a checksum of the image of every frame is
+ * computed to find changes of the output. With the offscreen window (see
+ * AWindow::createOffscreen) the benchmark runs without a display.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * void drawLevel(const AFrustum &frustum, void *data)
+ * {
+ *     ((ALevel *) data)->render(frustum);
+ * }
+ * ...
+ * window.createOffscreen(640, 480);
+ * ALevel level("level.lvl", "textures/");
+ * ABenchmark benchmark(&window);
+ * benchmark.loadPath("flythrough.txt");
+ * benchmark.setFrames(500);
+ * benchmark.setChecksums(true);
+ * benchmark.run(drawLevel, &level);
+ * benchmark.report(cout);
+ * @endcode
+ */
+class ABenchmark
+{
+    private:
+        AWindow *window;
+
+        std::vector<AVector> eyes;          // key positions of the camera
+        std::vector<AVector> targets;       // key points the camera looks at
+
+        int frames;                         // measured frames
+        int warmupFrames;                   // frames before the measuring
+        bool checksums;                     // compute checksums of the images
+
+        std::vector<double> frameTimes;     // times of the frames (ms)
+        std::vector<unsigned int> frameChecksums;
+        std::vector<unsigned char> pixels;  // image of the frame
+
+        // position on the path (0 to 1)
+        void getCamera(double t, AVector *eye, AVector *target);
+
+        // checksum of the image of the window
+        unsigned int computeChecksum();
+
+    public:
+        /**
+         * Constructor.
+         * @param window Created window (AWindow::create or
+         *               AWindow::createOffscreen)
+         * @throw ANullPointerException
+         */
+        ABenchmark(AWindow *window);
+
+        /**
+         * Adds the key position of the camera to the path.
+         * @param eye Position of the camera
+         * @param target Point the camera looks at
+         */
+        void addKey(const AVector &eye, const AVector &target);
+
+        /**
+         * Loads the path of the camera.
+         * Every line of the file contains one key position: six numbers,
+         * the position of the camera and the point it looks at.
+         * @param filename File with the path
+         * @throw AReadFileException
+         */
+        void loadPath(char *filename);
+
+        /**
+         * Removes all key positions.
+         */
+        void clearPath() { eyes.clear(); targets.clear(); }
+
+        /**
+         * Sets the number of frames.
+         * @param frames Number of measured frames
+         * @param warmupFrames Number of frames drawn before the measuring
+         */
+        void setFrames(int frames, int warmupFrames = 10);
+
+        /**
+         * Turns computing of the image checksums on or off.
+         * Reading the image is not included in the frame times.
+         * @param checksums True to compute the checksums
+         */
+        void setChecksums(bool checksums) { this->checksums = checksums; }
+
+        /**
+         * Runs the benchmark.
+         * @param scene Function drawing the scene
+         * @param data Parameter of the function
+         * @throw ANullPointerException
+         * @throw AIllegalArgumentException
+         */
+        void run(ABenchmarkScene scene, void *data);
+
+        /**
+         * Returns the number of measured frames.
+         * @return Number of frames of the last run
+         */
+        int getFrameCount() { return frameTimes.size(); }
+
+        /**
+         * Returns the time of the frame.
+         * @param frame Index of the frame
+         * @return Time of the frame in milliseconds
+         */
+        double getFrameTime(int frame) { return frameTimes[frame]; }
+
+        /**
+         * Returns the checksum of the frame.
+         * @param frame Index of the frame
+         * @return Checksum of the image (0 without checksums)
+         */
+        unsigned int getChecksum(int frame) { return frameChecksums.empty() ? 0 : frameChecksums[frame]; }
+
+        /**
+         * Returns the checksum of all frames.
+         * @return Checksum of all images (0 without checksums)
+         */
+        unsigned int getChecksum();
+
+        /**
+         * Returns the average frame time.
+         * @return Average time in milliseconds
+         */
+        double getAverageTime();
+
+        /**
+         * Returns the percentile of the frame times.
+         * @param percent Percentile (0 is the minimum, 50 median, 100 maximum)
+         * @return Time in milliseconds
+         */
+        double getPercentile(double percent);
+
+        /**
+         * Writes the results.
+         * @param out Output stream
+         */
+        void report(std::ostream &out);
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ABENCHMARK_H
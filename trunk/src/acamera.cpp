@@ -67,6 +67,9 @@ ACamera::ACamera(AVector a)
     this->mouse = false;
     this->sensitivity = 10.0;
 
+    this->window = NULL;
+    this->level = NULL;
+
     this->collision = false;
 
     this->rotX = this->rotY = this->rotZ = 0.0;
@@ -76,6 +79,8 @@ ACamera::ACamera(AVector a)
     this->right.x += 1.0;
 
     this->speed = DEFAULT_SPEED;
+
+    saveState();
 }
 
 //----------------------------------------------------------------------
@@ -328,4 +333,62 @@ void ACamera::turn(int direction, double angle)
     glPopMatrix();
 }
 
+//----------------------------------------------------------------------
+// builds the view frustum
+//----------------------------------------------------------------------
+
+AFrustum ACamera::getFrustum()
+{
+    if(!window)
+    {
+        throw ANullPointerException("AFrustum ACamera::getFrustum()");
+    }
+
+    // view matrix has the same axes as the one made by gluLookAt in set()
+    AVector f = this->front - this->eye;
+    AVector s = this->right - this->eye;
+    AVector u = this->top - this->eye;
+    f.normalize();
+    s.normalize();
+    u.normalize();
+
+    double view[16];
+    view[0] = s.x;  view[4] = s.y;  view[8]  = s.z;  view[12] = -(s * this->eye);
+    view[1] = u.x;  view[5] = u.y;  view[9]  = u.z;  view[13] = -(u * this->eye);
+    view[2] = -f.x; view[6] = -f.y; view[10] = -f.z; view[14] = (f * this->eye);
+    view[3] = 0.0;  view[7] = 0.0;  view[11] = 0.0;  view[15] = 1.0;
+
+    // the same projection as gluPerspective in AWindow::resizeScreen
+    double n = window->getNearPlane();
+    double fr = window->getFarPlane();
+    double c = 1.0 / tan(window->getFieldOfView() * PI / 360.0);
+
+    double proj[16];
+    for(int i = 0; i < 16; i++)
+        proj[i] = 0.0;
+
+    proj[0]  = c / window->getAspect();
+    proj[5]  = c;
+    proj[10] = (fr + n) / (n - fr);
+    proj[11] = -1.0;
+    proj[14] = 2.0 * fr * n / (n - fr);
+
+    double viewProj[16];
+    for(int col = 0; col < 4; col++)
+    {
+        for(int row = 0; row < 4; row++)
+        {
+            viewProj[col * 4 + row] = proj[row]      * view[col * 4] +
+                                      proj[4 + row]  * view[col * 4 + 1] +
+                                      proj[8 + row]  * view[col * 4 + 2] +
+                                      proj[12 + row] * view[col * 4 + 3];
+        }
+    }
+
+    AFrustum frustum;
+    frustum.set(viewProj, this->eye);
+
+    return frustum;
+}
+
 } // namespace astral3d
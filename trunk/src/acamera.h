@@ -37,6 +37,7 @@
 #include <GL/glu.h>
 
 #include "avector.h"
+#include "afrustum.h"
 #include "aabstract.h"
 #include "awindow.h"
 #include "aerror.h"
@@ -72,6 +73,7 @@ class ACamera : public CollisionEllipsoid
 {
   private:
        AVector eye, front, top, right;        // position vectors
+       AVector savedEye, savedFront;          // position before the simulation step
        double speed;                          // speed of movement
        double rotX, rotY, rotZ;               // degree of rotation
        double sensitivity;                    // mouse sensitivity
@@ -109,6 +111,22 @@ class ACamera : public CollisionEllipsoid
      * It should be called before rendering the scene.
      */
     inline   void    set();
+    /**
+     * Sets the scene according to the interpolated camera.
+     * The camera is placed between the position stored by
+     * ACamera::saveState and the current position, so the motion is
+     * smooth with the fixed simulation step (see AWindow::setTimestep).
+     * @param interpolation 0 for the stored position to 1 for the current
+     *                      one (AWindow::getInterpolation)
+     */
+    inline   void    set(double interpolation);
+    /**
+     * Stores the position of the camera.
+     * It should be called at the start of every simulation step
+     * (AWindow::update), before the camera moves.
+     * @see set
+     */
+    void     saveState()      { savedEye = eye; savedFront = front; }
     /**
      * Updates camera position.
      * This method updates camera position by adding the vector to the
@@ -351,6 +369,18 @@ class ACamera : public CollisionEllipsoid
         this->window = window;
     }
 
+    /**
+     * Returns the view frustum of the camera.
+     * This method builds the view frustum from the camera vectors and the
+     * perspective projection of the window set by ACamera::setWindow (see
+     * AWindow::setPerspective). The frustum is used for culling, see
+     * ALevel::render and A3DSModel::render.
+     * @return View frustum in the world space
+     * @see setWindow
+     * @throw ANullPointerException
+     */
+    AFrustum getFrustum();
+
     /**
      * Returns the position of the camera.
      * @return Position of the camera
@@ -392,6 +422,18 @@ void ACamera::set()
         0.0, 1.0, 0.0);
 }
 
+//-----------------------------------------------------------------------------
+// sets the scene according the interpolated camera
+//-----------------------------------------------------------------------------
+
+void ACamera::set(double interpolation)
+{
+    AVector e = this->savedEye + (this->eye - this->savedEye) * interpolation;
+    AVector f = this->savedFront + (this->front - this->savedFront) * interpolation;
+
+    gluLookAt(e.x, e.y, e.z, f.x, f.y, f.z, 0.0, 1.0, 0.0);
+}
+
 //-----------------------------------------------------------------------------
 // adds the given vector to the camera position
 //-----------------------------------------------------------------------------
@@ -417,6 +459,9 @@ void ACamera::setPosition(AVector a)
     this->front.z -= 1.0;
     this->top.y += 1.0;
     this->right.x += 1.0;
+
+    // no interpolation from the old position
+    saveState();
 }
 
 //-----------------------------------------------------------------------------
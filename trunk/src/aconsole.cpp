@@ -40,6 +40,7 @@ AConsole::AConsole()
 {
     text2D = NULL;
     lineBuffer = NULL;
+    firstLine = 0;
     visible = true;
     consoleOnOffKey = SDLK_F1;
     r=g=b=255;
@@ -92,6 +93,7 @@ AConsole *AConsole::build(AText2D *text2D, int x, int y, int w, int h, int borde
     // se budou vypisovat od pozice 0 a ne od pozice 1
 
     lineBuffer = new string[noOfLines];
+    firstLine = 0;
     if(!lineBuffer)
     {
         throw AMemoryAllocException("AConsole *AConsole::build(AText2D *text2D, int x, int y, int w, int h, int border)");
@@ -108,31 +110,36 @@ AConsole *AConsole::build(AText2D *text2D, int x, int y, int w, int h, int borde
 
 void AConsole::print(const char *str, ...)
 {
-    char buf[256];
-
     va_list list;
 
-    if(str == NULL)
+    if(str == NULL || noOfLines <= 0)
         return;
 
-    va_start(list, str);
-    vsprintf(buf, str, list);
-    va_end(list);
+    if(formatBuffer.size() < 256)
+        formatBuffer.resize(256);
 
-    // pokud text bude delsi nez se vejde na radek, bude zkracen
-    if (strlen(buf) > (unsigned int) maxLineChars)
+    // the buffer grows until the whole text fits in it
+    while(true)
     {
-        buf[maxLineChars-1] = '\0';
-    }
+        va_start(list, str);
+        int length = vsnprintf(&formatBuffer[0], formatBuffer.size(), str, list);
+        va_end(list);
 
-    // posuneme vsechny radky o jeden nahoru
-    for(int p=noOfLines-1; p>0; p--)
-    {
-        lineBuffer[p] = lineBuffer[p-1];
+        if(length >= 0 && (unsigned int) length < formatBuffer.size())
+            break;
+
+        // older C libraries return -1 instead of the needed length
+        formatBuffer.resize(length >= 0 ? length + 1 : formatBuffer.size() * 2);
     }
 
-    string foo(buf);
-    lineBuffer[0] = foo;
+    // pokud text bude delsi nez se vejde na radek, bude zkracen
+    size_t length = strlen(&formatBuffer[0]);
+    if (length > (unsigned int) maxLineChars)
+        length = maxLineChars > 0 ? maxLineChars - 1 : 0;
+
+    // the oldest line is replaced, the other lines stay where they are
+    firstLine = (firstLine + noOfLines - 1) % noOfLines;
+    lineBuffer[firstLine].assign(&formatBuffer[0], length);
 }
 
 //-----------------------------------------------------------------------------
@@ -143,10 +150,16 @@ void AConsole::render()
 {
     if(!visible) return;
 
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
+    ARenderState::polygonMode(GL_FILL);
+
+    // matrices are set only once for the background and all lines
+    ARenderState::begin2D(text2D->getWindowWidth(), text2D->getWindowHeight());
 
     renderBackground();
 
+    // all lines are drawn with one draw call
+    text2D->beginBatch();
+
     unsigned char difference;
     unsigned char alpha = 255;
 
@@ -156,15 +169,13 @@ void AConsole::render()
         difference = (unsigned char) (255 / noOfLines);
 
 
-    glColor4ub(r, g, b, alpha);
+    text2D->setColor(r, g, b, alpha);
 
     // pokud je povolen vstup uzivatele, zobrazujeme prikazovou radku
     if(userInput)
     {
         // vypis prikazove radky
-        char buf[256];
-        strcpy(buf, commandLine.c_str());
-        text2D->print(posX+border, posY+border, buf);
+        text2D->printText(posX+border, posY+border, commandLine.c_str());
     }
 
     // pocatecni pozice pro vypis radku
@@ -186,19 +197,21 @@ void AConsole::render()
 
     for(int p=0; p<noOfLines-foo; p++)
     {
-        char buf[256];
-        strcpy(buf, lineBuffer[p].c_str());
-
         // pokud je zapnut efekt zeslabnuti, zeslabujeme...
         if(fadeOut)
             alpha-=difference;
 
-        glColor4ub(r, g, b, alpha);
-        text2D->print(posX+border, y, buf);
+        text2D->setColor(r, g, b, alpha);
+        text2D->printText(posX+border, y, lineBuffer[(firstLine + p) % noOfLines].c_str());
 
         // posun vypisu radku nahoru
         y += text2D->getSizeHeight();
     }
+
+    text2D->endBatch();
+    text2D->resetColor();
+
+    ARenderState::end2D();
 }
 
 //-----------------------------------------------------------------------------
@@ -219,13 +232,8 @@ void AConsole::input(char c)
         if(commandLine.length()+1 >= (unsigned int) maxLineChars)
             return;
 
-        char buf[256];
-        strcpy(buf, commandLine.c_str());
-        buf[strlen(buf)-1] = '\0';
-        string foo(buf);
-        foo += c;
-        foo += "_";
-        commandLine = foo;
+        // znak vlozime pred kurzor
+        commandLine.insert(commandLine.length()-1, 1, c);
     }
 
     // backspace maze jeden znak
@@ -235,25 +243,22 @@ void AConsole::input(char c)
         if(commandLine.length() == 1)
             return;
 
-        char buf[256];
-        strcpy(buf, commandLine.c_str());
-        buf[strlen(buf)-2] = '\0';
-        string foo(buf);
-        foo += "_";
-        commandLine = foo;
+        commandLine.erase(commandLine.length()-2, 1);
     }
     // pokud stiskneme enter, potvrdime zadany prikaz
     if(c == '\r')
     {
-        char buf[256];
-        strcpy(buf, commandLine.c_str());
-        buf[strlen(buf)-1] = '\0';
+        string command = commandLine.substr(0, commandLine.length()-1);
 
-        print(buf);
+        print("%s", command.c_str());
 
         //zavolame funkci pro zpracovani prikazu
         if(func)
-            func(buf);
+        {
+            vector<char> buf(command.begin(), command.end());
+            buf.push_back('\0');
+            func(&buf[0]);
+        }
 
         commandLine = "_";
     }
@@ -272,6 +277,8 @@ void AConsole::clear()
         lineBuffer[p] = "";
         commandLine = "_";
     }
+
+    firstLine = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -301,7 +308,7 @@ void AConsole::keyDownInput(SDL_keysym *keysym)
 
 void AConsole::backgroundTexture(char *filename)
 {
-    if (!loadTexture(filename, &texture))
+    if (!(texture = ATextureManager::load(filename, false)))
     {
         throw ATextureException("void AConsole::backgroundTexture(char *filename)");
     }
@@ -318,21 +325,15 @@ void AConsole::renderBackground()
         return;
 
     glColor4ub(255, 255, 255, backgroundAlpha);
-    glEnable(GL_BLEND);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    glEnable(GL_TEXTURE_2D);
-    glDisable(GL_LIGHTING);
-
-    glBindTexture(GL_TEXTURE_2D, texture);
-    glDisable(GL_DEPTH_TEST);
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glOrtho(0,text2D->getWindowWidth(),0,text2D->getWindowHeight(),-100,100);
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
+    ARenderState::enable(GL_BLEND);
+    ARenderState::blendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+    ARenderState::enable(GL_TEXTURE_2D);
+    ARenderState::disable(GL_LIGHTING);
+    ARenderState::bindTexture(texture);
+
+    ARenderState::begin2D(text2D->getWindowWidth(), text2D->getWindowHeight());
 
+    ARenderState::countDrawCall();
     glBegin(GL_QUADS);
 
         glTexCoord2f(0.0, 1.0);
@@ -349,11 +350,7 @@ void AConsole::renderBackground()
 
     glEnd();
 
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
-    glEnable(GL_DEPTH_TEST);
+    ARenderState::end2D();
 }
 
 } // namespace astral3d
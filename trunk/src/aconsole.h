@@ -31,13 +31,16 @@
 #endif
 
 #include <cstdarg>
+#include <cstdio>
 #include <cstring>
 #include <cctype>
 #include <string>
+#include <vector>
 #include <sstream>
 
 #include "atext.h"
 #include "atexture.h"
+#include "atexturemanager.h"
 #include "aerror.h"
 #include "aexceptions.h"
 
@@ -61,7 +64,9 @@ class AConsole
       int            border;            // border
 
       std::string    commandLine;       // command line text
-      std::string   *lineBuffer;        // lines of the console
+      std::string   *lineBuffer;        // lines of the console (ring buffer)
+      int            firstLine;         // index of the newest line
+      std::vector<char> formatBuffer;   // buffer for formatting the lines
       int            maxLineChars;      // max chars in the line
       int            noOfLines;         // number of lines except command line
 
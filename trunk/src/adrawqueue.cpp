@@ -0,0 +1,103 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "adrawqueue.h"
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// order of the draws
+//-----------------------------------------------------------------------------
+
+bool ADrawQueue::compare(const Item &a, const Item &b)
+{
+    if(a.state.blend != b.state.blend)
+        return !a.state.blend;
+
+    // blended draws keep their order
+    if(a.state.blend)
+        return a.order < b.order;
+
+    if(a.state.depthTest != b.state.depthTest)
+        return a.state.depthTest;
+
+    if(a.state.lighting != b.state.lighting)
+        return a.state.lighting;
+
+    if(a.state.texture != b.state.texture)
+        return a.state.texture < b.state.texture;
+
+    return a.order < b.order;
+}
+
+//-----------------------------------------------------------------------------
+// adds the draw
+//-----------------------------------------------------------------------------
+
+void ADrawQueue::submit(const ADrawState &state, ADrawFunction draw, void *data)
+{
+    if(!draw)
+        return;
+
+    Item item;
+    item.state = state;
+    item.draw = draw;
+    item.data = data;
+    item.order = items.size();
+
+    items.push_back(item);
+}
+
+//-----------------------------------------------------------------------------
+// executes the draws
+//-----------------------------------------------------------------------------
+
+void ADrawQueue::flush()
+{
+    unsigned int changes = ARenderState::getStateChanges();
+    unsigned int calls = ARenderState::getDrawCalls();
+
+    sort(items.begin(), items.end(), compare);
+
+    for(unsigned int i = 0; i < items.size(); i++)
+    {
+        const ADrawState &state = items[i].state;
+
+        // the cache drops the calls that don't change anything
+        ARenderState::setEnabled(GL_DEPTH_TEST, state.depthTest);
+        ARenderState::setEnabled(GL_LIGHTING, state.lighting);
+        ARenderState::setEnabled(GL_BLEND, state.blend);
+        if(state.blend)
+            ARenderState::blendFunc(state.blendSrc, state.blendDst);
+
+        ARenderState::setEnabled(GL_TEXTURE_2D, state.texture != 0);
+        if(state.texture)
+            ARenderState::bindTexture(state.texture);
+
+        items[i].draw(items[i].data);
+    }
+
+    items.clear();
+
+    stateChanges = ARenderState::getStateChanges() - changes;
+    drawCalls = ARenderState::getDrawCalls() - calls;
+}
+
+} // namespace astral3d
@@ -0,0 +1,156 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file adrawqueue.h ADrawQueue class.
+ */
+#ifndef ADRAWQUEUE_H
+#define ADRAWQUEUE_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <vector>
+#include <algorithm>
+#include <GL/gl.h>
+
+#include "arenderstate.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Function drawing one item of the draw queue.
+ * The state of the item is already set when the function is called.
+ */
+typedef void (*ADrawFunction)(void *data);
+
+/**
+ * State needed by one draw of the draw queue.
+ */
+struct ADrawState
+{
+    GLuint texture;         // 2D texture or 0 for untextured draws
+    bool blend;             // blending
+    GLenum blendSrc;        // blend function
+    GLenum blendDst;
+    bool depthTest;         // depth test
+    bool lighting;          // lighting
+
+    /**
+     * Constructor.
+     * Default state is an opaque, untextured, depth tested draw without
+     * lighting.
+     */
+    ADrawState(GLuint texture = 0, bool blend = false,
+               GLenum blendSrc = GL_SRC_ALPHA, GLenum blendDst = GL_ONE_MINUS_SRC_ALPHA,
+               bool depthTest = true, bool lighting = false)
+    : texture(texture), blend(blend), blendSrc(blendSrc), blendDst(blendDst),
+      depthTest(depthTest), lighting(lighting) {}
+};
+
+/**
+ * Queue of draws sorted by the state.
+ * Draws are submitted with the state they need and executed by
+ * ADrawQueue::flush. Opaque draws are sorted by the depth test, lighting
+ * and texture so each state is set as few times as possible. Blended draws
+ * go after the opaque ones in the order they were submitted (their order
+ * changes the picture), only neighbours with the same state share it. All
+ * states are set through ARenderState.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * void drawCrate(void *data) { ((A3DSModel *) data)->render(); }
+ * ...
+ * queue.submit(ADrawState(0, false, GL_ONE, GL_ZERO, true, true), drawCrate, &crate);
+ * queue.submit(ADrawState(glassTexture, true), drawGlass, &glass);
+ * queue.flush();
+ * @endcode
+ */
+class ADrawQueue
+{
+    private:
+        struct Item
+        {
+            ADrawState state;
+            ADrawFunction draw;
+            void *data;
+            unsigned int order;     // order of the submission
+        };
+
+        // opaque draws first, sorted by the state; blended by the order
+        static bool compare(const Item &a, const Item &b);
+
+        std::vector<Item> items;
+
+        unsigned int stateChanges;  // statistics of the last flush
+        unsigned int drawCalls;
+
+    public:
+        /**
+         * Constructor.
+         */
+        ADrawQueue() { stateChanges = 0; drawCalls = 0; }
+
+        /**
+         * Adds the draw to the queue.
+         * @param state State needed by the draw
+         * @param draw Function drawing the item
+         * @param data Parameter of the function
+         */
+        void submit(const ADrawState &state, ADrawFunction draw, void *data);
+
+        /**
+         * Sorts and executes all draws.
+         * The queue is empty afterwards.
+         */
+        void flush();
+
+        /**
+         * Removes all draws without executing them.
+         */
+        void clear() { items.clear(); }
+
+        /**
+         * Returns the number of draws in the queue.
+         * @return Number of submitted draws
+         */
+        unsigned int getSize() { return items.size(); }
+
+        /**
+         * Returns the number of state changes.
+         * @return Number of OpenGL state calls made by the last flush
+         */
+        unsigned int getStateChanges() { return stateChanges; }
+
+        /**
+         * Returns the number of draw calls.
+         * @return Number of draw calls made by the last flush
+         */
+        unsigned int getDrawCalls() { return drawCalls; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ADRAWQUEUE_H
@@ -0,0 +1,200 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "aextensions.h"
+
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
+
+#ifdef HAVE_OSMESA
+    #include <GL/osmesa.h>
+#endif
+
+using namespace std;
+namespace astral3d {
+
+PFNGLGENBUFFERSARBPROC    aglGenBuffersARB    = NULL;
+PFNGLBINDBUFFERARBPROC    aglBindBufferARB    = NULL;
+PFNGLBUFFERDATAARBPROC    aglBufferDataARB    = NULL;
+PFNGLBUFFERSUBDATAARBPROC aglBufferSubDataARB = NULL;
+PFNGLDELETEBUFFERSARBPROC aglDeleteBuffersARB = NULL;
+PFNGLMAPBUFFERARBPROC     aglMapBufferARB     = NULL;
+PFNGLUNMAPBUFFERARBPROC   aglUnmapBufferARB   = NULL;
+
+PFNGLCOMPRESSEDTEXIMAGE2DARBPROC    aglCompressedTexImage2DARB    = NULL;
+PFNGLCOMPRESSEDTEXSUBIMAGE2DARBPROC aglCompressedTexSubImage2DARB = NULL;
+
+PFNGLGENQUERIESARBPROC          aglGenQueriesARB          = NULL;
+PFNGLDELETEQUERIESARBPROC       aglDeleteQueriesARB       = NULL;
+PFNGLBEGINQUERYARBPROC          aglBeginQueryARB          = NULL;
+PFNGLENDQUERYARBPROC            aglEndQueryARB            = NULL;
+PFNGLGETQUERYOBJECTIVARBPROC    aglGetQueryObjectivARB    = NULL;
+PFNGLGETQUERYOBJECTUI64VEXTPROC aglGetQueryObjectui64vEXT = NULL;
+
+// extensions are loaded only once
+static bool extensionsLoaded = false;
+static bool vboSupported = false;
+static bool pboSupported = false;
+static bool s3tcSupported = false;
+static bool timerQuerySupported = false;
+
+//-----------------------------------------------------------------------------
+// entry point of the current context (window or offscreen)
+//-----------------------------------------------------------------------------
+
+static void *getProcAddress(const char *name)
+{
+#ifdef HAVE_OSMESA
+    if(OSMesaGetCurrentContext())
+        return (void *) OSMesaGetProcAddress(name);
+#endif
+
+    return SDL_GL_GetProcAddress(name);
+}
+
+//-----------------------------------------------------------------------------
+// tests if the extension is in the extension string of the driver
+//-----------------------------------------------------------------------------
+
+bool isExtensionSupported(const char *name)
+{
+    const char *extensions = (const char *) glGetString(GL_EXTENSIONS);
+    if(extensions == NULL || name == NULL)
+        return false;
+
+    size_t length = strlen(name);
+    const char *start = extensions;
+
+    // extension names can be prefixes of other names so we have to check
+    // that the whole word matches
+    while((start = strstr(start, name)) != NULL)
+    {
+        if((start == extensions || *(start - 1) == ' ') &&
+           (start[length] == ' ' || start[length] == '\0'))
+            return true;
+
+        start += length;
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// loads the entry points of the extensions
+//-----------------------------------------------------------------------------
+
+bool initExtensions()
+{
+    if(extensionsLoaded)
+        return true;
+
+    // we need an OpenGL context
+    if(glGetString(GL_EXTENSIONS) == NULL)
+        return false;
+
+    if(isExtensionSupported("GL_ARB_vertex_buffer_object"))
+    {
+        aglGenBuffersARB    = (PFNGLGENBUFFERSARBPROC)    getProcAddress("glGenBuffersARB");
+        aglBindBufferARB    = (PFNGLBINDBUFFERARBPROC)    getProcAddress("glBindBufferARB");
+        aglBufferDataARB    = (PFNGLBUFFERDATAARBPROC)    getProcAddress("glBufferDataARB");
+        aglBufferSubDataARB = (PFNGLBUFFERSUBDATAARBPROC) getProcAddress("glBufferSubDataARB");
+        aglDeleteBuffersARB = (PFNGLDELETEBUFFERSARBPROC) getProcAddress("glDeleteBuffersARB");
+        aglMapBufferARB     = (PFNGLMAPBUFFERARBPROC)     getProcAddress("glMapBufferARB");
+        aglUnmapBufferARB   = (PFNGLUNMAPBUFFERARBPROC)   getProcAddress("glUnmapBufferARB");
+
+        vboSupported = aglGenBuffersARB && aglBindBufferARB && aglBufferDataARB &&
+                       aglBufferSubDataARB && aglDeleteBuffersARB;
+    }
+
+    // pixel buffers are filled through the mapped memory
+    if(vboSupported && aglMapBufferARB && aglUnmapBufferARB &&
+       (isExtensionSupported("GL_ARB_pixel_buffer_object") || isExtensionSupported("GL_EXT_pixel_buffer_object")))
+        pboSupported = true;
+
+    if(isExtensionSupported("GL_ARB_texture_compression") &&
+       isExtensionSupported("GL_EXT_texture_compression_s3tc"))
+    {
+        aglCompressedTexImage2DARB    = (PFNGLCOMPRESSEDTEXIMAGE2DARBPROC)    getProcAddress("glCompressedTexImage2DARB");
+        aglCompressedTexSubImage2DARB = (PFNGLCOMPRESSEDTEXSUBIMAGE2DARBPROC) getProcAddress("glCompressedTexSubImage2DARB");
+
+        s3tcSupported = aglCompressedTexImage2DARB && aglCompressedTexSubImage2DARB;
+    }
+
+    // timer queries use the query objects of GL_ARB_occlusion_query
+    if(isExtensionSupported("GL_ARB_occlusion_query") &&
+       (isExtensionSupported("GL_EXT_timer_query") || isExtensionSupported("GL_ARB_timer_query")))
+    {
+        aglGenQueriesARB          = (PFNGLGENQUERIESARBPROC)          getProcAddress("glGenQueriesARB");
+        aglDeleteQueriesARB       = (PFNGLDELETEQUERIESARBPROC)       getProcAddress("glDeleteQueriesARB");
+        aglBeginQueryARB          = (PFNGLBEGINQUERYARBPROC)          getProcAddress("glBeginQueryARB");
+        aglEndQueryARB            = (PFNGLENDQUERYARBPROC)            getProcAddress("glEndQueryARB");
+        aglGetQueryObjectivARB    = (PFNGLGETQUERYOBJECTIVARBPROC)    getProcAddress("glGetQueryObjectivARB");
+        aglGetQueryObjectui64vEXT = (PFNGLGETQUERYOBJECTUI64VEXTPROC) getProcAddress("glGetQueryObjectui64vEXT");
+
+        // the ARB version names the function without the suffix
+        if(!aglGetQueryObjectui64vEXT)
+            aglGetQueryObjectui64vEXT = (PFNGLGETQUERYOBJECTUI64VEXTPROC) getProcAddress("glGetQueryObjectui64v");
+
+        timerQuerySupported = aglGenQueriesARB && aglDeleteQueriesARB && aglBeginQueryARB &&
+                              aglEndQueryARB && aglGetQueryObjectivARB && aglGetQueryObjectui64vEXT;
+    }
+
+    extensionsLoaded = true;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// vertex buffer objects
+//-----------------------------------------------------------------------------
+
+bool isVBOSupported()
+{
+    return vboSupported;
+}
+
+//-----------------------------------------------------------------------------
+// pixel buffer objects
+//-----------------------------------------------------------------------------
+
+bool isPBOSupported()
+{
+    return pboSupported;
+}
+
+//-----------------------------------------------------------------------------
+// S3TC texture compression
+//-----------------------------------------------------------------------------
+
+bool isS3TCSupported()
+{
+    return s3tcSupported;
+}
+
+//-----------------------------------------------------------------------------
+// timer queries
+//-----------------------------------------------------------------------------
+
+bool isTimerQuerySupported()
+{
+    return timerQuerySupported;
+}
+
+} // namespace astral3d
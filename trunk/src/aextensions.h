@@ -0,0 +1,134 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file aextensions.h Functions for loading OpenGL extensions.
+ */
+#ifndef AEXTENSIONS_H
+#define AEXTENSIONS_H
+
+#ifdef WIN32
+    #include <windows.h>
+    #include <SDL.h>
+#else
+    #include "SDL.h"
+#endif
+
+#include <cstring>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// GL_ARB_vertex_buffer_object
+//-----------------------------------------------------------------------------
+
+extern PFNGLGENBUFFERSARBPROC    aglGenBuffersARB;
+extern PFNGLBINDBUFFERARBPROC    aglBindBufferARB;
+extern PFNGLBUFFERDATAARBPROC    aglBufferDataARB;
+extern PFNGLBUFFERSUBDATAARBPROC aglBufferSubDataARB;
+extern PFNGLDELETEBUFFERSARBPROC aglDeleteBuffersARB;
+extern PFNGLMAPBUFFERARBPROC     aglMapBufferARB;
+extern PFNGLUNMAPBUFFERARBPROC   aglUnmapBufferARB;
+
+#ifndef GL_PIXEL_UNPACK_BUFFER_ARB
+    #define GL_PIXEL_UNPACK_BUFFER_ARB 0x88EC
+#endif
+
+//-----------------------------------------------------------------------------
+// GL_ARB_occlusion_query, GL_EXT_timer_query
+//-----------------------------------------------------------------------------
+
+extern PFNGLGENQUERIESARBPROC          aglGenQueriesARB;
+extern PFNGLDELETEQUERIESARBPROC       aglDeleteQueriesARB;
+extern PFNGLBEGINQUERYARBPROC          aglBeginQueryARB;
+extern PFNGLENDQUERYARBPROC            aglEndQueryARB;
+extern PFNGLGETQUERYOBJECTIVARBPROC    aglGetQueryObjectivARB;
+extern PFNGLGETQUERYOBJECTUI64VEXTPROC aglGetQueryObjectui64vEXT;
+
+//-----------------------------------------------------------------------------
+// GL_ARB_texture_compression, GL_EXT_texture_compression_s3tc
+//-----------------------------------------------------------------------------
+
+extern PFNGLCOMPRESSEDTEXIMAGE2DARBPROC    aglCompressedTexImage2DARB;
+extern PFNGLCOMPRESSEDTEXSUBIMAGE2DARBPROC aglCompressedTexSubImage2DARB;
+
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+    #define GL_COMPRESSED_RGB_S3TC_DXT1_EXT  0x83F0
+    #define GL_COMPRESSED_RGBA_S3TC_DXT5_EXT 0x83F3
+#endif
+
+#ifndef GL_TIME_ELAPSED_EXT
+    #define GL_TIME_ELAPSED_EXT 0x88BF
+#endif
+
+/**
+ * Initializes OpenGL extensions.
+ * This function reads the extension string of the current OpenGL context
+ * and loads entry points of the extensions used by Astral3D. It is called
+ * automatically from AWindow::create. It can be called more than once,
+ * the extensions are loaded only the first time.
+ * @return True if the extensions are initialized (OpenGL context exists)
+ */
+bool initExtensions();
+
+/**
+ * Tests the extension.
+ * This function tests if the extension is advertised by the OpenGL driver.
+ * @param name Name of the extension (e.g. "GL_ARB_vertex_buffer_object")
+ * @return True if the extension is supported
+ */
+bool isExtensionSupported(const char *name);
+
+/**
+ * Tests vertex buffer objects.
+ * @return True if GL_ARB_vertex_buffer_object can be used
+ */
+bool isVBOSupported();
+
+/**
+ * Tests pixel buffer objects.
+ * The buffers are created and mapped by the functions of
+ * GL_ARB_vertex_buffer_object.
+ * @return True if GL_ARB_pixel_buffer_object (or the EXT version) can be
+ *         used for the uploads of the textures
+ */
+bool isPBOSupported();
+
+/**
+ * Tests S3TC texture compression.
+ * @return True if the textures can be uploaded in the DXT1 and DXT5
+ *         formats (GL_EXT_texture_compression_s3tc)
+ */
+bool isS3TCSupported();
+
+/**
+ * Tests timer queries.
+ * @return True if GL_EXT_timer_query (or GL_ARB_timer_query) can be used
+ *         for measuring the time of OpenGL commands
+ */
+bool isTimerQuerySupported();
+
+} // namespace astral3d
+
+#endif    // #ifndef AEXTENSIONS_H
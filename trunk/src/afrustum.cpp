@@ -0,0 +1,125 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "afrustum.h"
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+AFrustum::AFrustum()
+{
+    // planes with zero normal and positive distance accept everything
+    for(int i = 0; i < 6; i++)
+    {
+        planes[i][0] = planes[i][1] = planes[i][2] = 0.0;
+        planes[i][3] = 1.0;
+    }
+
+    for(int i = 0; i < 16; i++)
+        matrix[i] = (i % 5 == 0) ? 1.0 : 0.0;
+}
+
+//-----------------------------------------------------------------------------
+// extracts the planes from the view-projection matrix
+//-----------------------------------------------------------------------------
+
+void AFrustum::set(const double m[16], const AVector &position)
+{
+    for(int i = 0; i < 16; i++)
+        matrix[i] = m[i];
+
+    this->position = position;
+
+    // rows of the matrix (the matrix is stored by columns)
+    for(int i = 0; i < 3; i++)
+    {
+        for(int j = 0; j < 4; j++)
+        {
+            double row = m[j * 4 + i];
+            double w = m[j * 4 + 3];
+
+            planes[i * 2][j]     = w + row;     // left, bottom, near
+            planes[i * 2 + 1][j] = w - row;     // right, top, far
+        }
+    }
+
+    // normalization gives us real distances for the sphere test
+    for(int i = 0; i < 6; i++)
+    {
+        double length = sqrt(planes[i][0] * planes[i][0] +
+                             planes[i][1] * planes[i][1] +
+                             planes[i][2] * planes[i][2]);
+
+        if(length > 0.0)
+        {
+            for(int j = 0; j < 4; j++)
+                planes[i][j] /= length;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// point test
+//-----------------------------------------------------------------------------
+
+bool AFrustum::pointInFrustum(const AVector &p) const
+{
+    return sphereInFrustum(p, 0.0);
+}
+
+//-----------------------------------------------------------------------------
+// sphere test
+//-----------------------------------------------------------------------------
+
+bool AFrustum::sphereInFrustum(const AVector &c, double radius) const
+{
+    for(int i = 0; i < 6; i++)
+    {
+        if(planes[i][0] * c.x + planes[i][1] * c.y + planes[i][2] * c.z + planes[i][3] < -radius)
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// box test
+//-----------------------------------------------------------------------------
+
+bool AFrustum::boxInFrustum(const AVector &min, const AVector &max) const
+{
+    for(int i = 0; i < 6; i++)
+    {
+        // corner of the box lying furthest along the plane normal
+        double x = planes[i][0] >= 0.0 ? max.x : min.x;
+        double y = planes[i][1] >= 0.0 ? max.y : min.y;
+        double z = planes[i][2] >= 0.0 ? max.z : min.z;
+
+        if(planes[i][0] * x + planes[i][1] * y + planes[i][2] * z + planes[i][3] < 0.0)
+            return false;
+    }
+
+    return true;
+}
+
+} // namespace astral3d
@@ -0,0 +1,116 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file afrustum.h AFrustum class.
+ */
+#ifndef AFRUSTUM_H
+#define AFRUSTUM_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <cmath>
+
+#include "avector.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * View frustum.
+ * This class represents the view frustum of the camera in the world space.
+ * It is made of six planes extracted from the combined view and projection
+ * matrix. See ACamera::getFrustum.
+ */
+class AFrustum
+{
+    private:
+        double planes[6][4];    // left, right, bottom, top, near, far
+        double matrix[16];      // projection * view matrix (OpenGL order)
+        AVector position;       // position of the camera
+
+    public:
+        /**
+         * Constructor.
+         * Frustum contains the whole space until AFrustum::set is called.
+         */
+        AFrustum();
+
+        /**
+         * Sets the frustum.
+         * This method extracts frustum planes from the matrix.
+         * @param viewProjection Projection matrix multiplied by the view
+         *                       matrix (OpenGL column-major order)
+         * @param position Position of the camera
+         */
+        void set(const double viewProjection[16], const AVector &position);
+
+        /**
+         * Tests the point.
+         * @param point Point in the world space
+         * @return True if the point is inside the frustum
+         */
+        bool pointInFrustum(const AVector &point) const;
+
+        /**
+         * Tests the sphere.
+         * @param center Center of the sphere in the world space
+         * @param radius Radius of the sphere
+         * @return True if the sphere is at least partially inside the frustum
+         */
+        bool sphereInFrustum(const AVector &center, double radius) const;
+
+        /**
+         * Tests the axis aligned box.
+         * @param min Minimal corner of the box in the world space
+         * @param max Maximal corner of the box in the world space
+         * @return True if the box is at least partially inside the frustum
+         */
+        bool boxInFrustum(const AVector &min, const AVector &max) const;
+
+        /**
+         * Returns the combined view and projection matrix.
+         * @return Projection matrix multiplied by the view matrix
+         */
+        const double *getMatrix() const { return matrix; }
+
+        /**
+         * Returns the frustum plane.
+         * Plane is returned as (a, b, c, d) where a*x + b*y + c*z + d >= 0
+         * for the points inside. (a, b, c) is normalized.
+         * @param i Index of the plane (0 left, 1 right, 2 bottom, 3 top,
+         *          4 near, 5 far)
+         * @return Pointer to four coefficients of the plane
+         */
+        const double *getPlane(int i) const { return planes[i]; }
+
+        /**
+         * Returns the position of the camera.
+         * @return Position of the camera the frustum was made for
+         */
+        AVector getPosition() const { return position; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef AFRUSTUM_H
@@ -0,0 +1,411 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "ainstancebatch.h"
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+AInstanceBatch::AInstanceBatch()
+{
+    model = NULL;
+    dynamic = false;
+    drawCalls = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+AInstanceBatch::AInstanceBatch(A3DSModel *model, const double *transforms, int count, bool dynamic)
+{
+    this->model = NULL;
+    this->dynamic = false;
+    drawCalls = 0;
+
+    build(model, transforms, count, dynamic);
+}
+
+//-----------------------------------------------------------------------------
+// This method sets the model and the transformations
+//-----------------------------------------------------------------------------
+
+AInstanceBatch *AInstanceBatch::build(A3DSModel *model, const double *transforms, int count, bool dynamic)
+{
+    if(!model || !model->get3DModel())
+    {
+        throw ANullPointerException("AInstanceBatch *AInstanceBatch::build(A3DSModel *model, const double *transforms, int count, bool dynamic)");
+    }
+
+    destroy();
+
+    this->model = model;
+    this->dynamic = dynamic;
+
+    setTransforms(transforms, count);
+
+    return this;
+}
+
+//-----------------------------------------------------------------------------
+// This method sets new transformations of the copies
+//-----------------------------------------------------------------------------
+
+void AInstanceBatch::setTransforms(const double *transforms, int count)
+{
+    if(!transforms && count > 0)
+    {
+        throw ANullPointerException("void AInstanceBatch::setTransforms(const double *transforms, int count)");
+    }
+
+    if(count < 0)
+        count = 0;
+
+    this->transforms.assign(transforms, transforms + count * 16);
+
+    if(!dynamic)
+        createMergedBuffers();
+}
+
+//-----------------------------------------------------------------------------
+// This method frees the memory
+//-----------------------------------------------------------------------------
+
+void AInstanceBatch::destroy()
+{
+    destroyMergedBuffers();
+    transforms.clear();
+    model = NULL;
+    drawCalls = 0;
+}
+
+//-----------------------------------------------------------------------------
+// This method transforms the vertices of all copies and merges them
+//-----------------------------------------------------------------------------
+
+void AInstanceBatch::createMergedBuffers()
+{
+    destroyMergedBuffers();
+
+    A3DModel *pModel = model->get3DModel();
+    int count = getInstanceCount();
+
+    if(count == 0 || !pModel)
+        return;
+
+    bool vbo = isVBOSupported();
+
+    for(int i = 0; i < pModel->numOfObjects; i++)
+    {
+        A3DObject *pObject = &pModel->pObject[i];
+
+        if(pObject->numOfVerts <= 0 || pObject->numOfFaces <= 0)
+            continue;
+
+        // copies are split into chunks that can still use short indices
+        int perChunk = 65535 / pObject->numOfVerts;
+        if(perChunk < 1)
+            perChunk = 1;
+
+        for(int first = 0; first < count; first += perChunk)
+        {
+            int last = first + perChunk;
+            if(last > count)
+                last = count;
+
+            int copies = last - first;
+
+            A3DSObjectBuffer buffer;
+            buffer.vertexBuffer = 0;
+            buffer.indexBuffer = 0;
+            buffer.indexCount = copies * pObject->numOfFaces * 3;
+            buffer.vertexData = new GLfloat[copies * pObject->numOfVerts * 8];
+            buffer.indexData = new GLushort[buffer.indexCount];
+
+            GLfloat *v = buffer.vertexData;
+            GLushort *idx = buffer.indexData;
+
+            for(int c = first; c < last; c++)
+            {
+                const GLdouble *m = &transforms[c * 16];
+
+                // normals are transformed by the inverse transpose of the
+                // upper 3x3 matrix (it is the cofactor matrix divided by
+                // the determinant), n[3 * c + r] is the cofactor of the
+                // row r and the column c
+                double n[9];
+                n[0] = m[5] * m[10] - m[6] * m[9];
+                n[1] = m[6] * m[8]  - m[4] * m[10];
+                n[2] = m[4] * m[9]  - m[5] * m[8];
+                n[3] = m[2] * m[9]  - m[1] * m[10];
+                n[4] = m[0] * m[10] - m[2] * m[8];
+                n[5] = m[1] * m[8]  - m[0] * m[9];
+                n[6] = m[1] * m[6]  - m[2] * m[5];
+                n[7] = m[2] * m[4]  - m[0] * m[6];
+                n[8] = m[0] * m[5]  - m[1] * m[4];
+
+                double det = m[0] * n[0] + m[1] * n[1] + m[2] * n[2];
+                if(det != 0.0)
+                {
+                    for(int k = 0; k < 9; k++)
+                        n[k] /= det;
+                }
+
+                for(int j = 0; j < pObject->numOfVerts; j++)
+                {
+                    if(pObject->pTexVerts && j < pObject->numTexVertex)
+                    {
+                        v[0] = pObject->pTexVerts[j].x;
+                        v[1] = pObject->pTexVerts[j].y;
+                    }
+                    else
+                    {
+                        v[0] = v[1] = 0.0f;
+                    }
+
+                    double nx = pObject->pNormals[j].x;
+                    double ny = pObject->pNormals[j].y;
+                    double nz = pObject->pNormals[j].z;
+
+                    double tx = nx * n[0] + ny * n[3] + nz * n[6];
+                    double ty = nx * n[1] + ny * n[4] + nz * n[7];
+                    double tz = nx * n[2] + ny * n[5] + nz * n[8];
+
+                    // scaled transforms change the length
+                    double length = sqrt(tx * tx + ty * ty + tz * tz);
+                    if(length > 0.0)
+                    {
+                        tx /= length;
+                        ty /= length;
+                        tz /= length;
+                    }
+
+                    v[2] = (GLfloat) tx;
+                    v[3] = (GLfloat) ty;
+                    v[4] = (GLfloat) tz;
+
+                    double px = pObject->pVerts[j].x;
+                    double py = pObject->pVerts[j].y;
+                    double pz = pObject->pVerts[j].z;
+
+                    v[5] = (GLfloat) (px * m[0] + py * m[4] + pz * m[8]  + m[12]);
+                    v[6] = (GLfloat) (px * m[1] + py * m[5] + pz * m[9]  + m[13]);
+                    v[7] = (GLfloat) (px * m[2] + py * m[6] + pz * m[10] + m[14]);
+
+                    v += 8;
+                }
+
+                GLushort base = (GLushort) ((c - first) * pObject->numOfVerts);
+
+                for(int j = 0; j < pObject->numOfFaces; j++)
+                {
+                    *idx++ = base + (GLushort) pObject->pFaces[j].vertIndex[0];
+                    *idx++ = base + (GLushort) pObject->pFaces[j].vertIndex[1];
+                    *idx++ = base + (GLushort) pObject->pFaces[j].vertIndex[2];
+                }
+            }
+
+            if(vbo)
+            {
+                aglGenBuffersARB(1, &buffer.vertexBuffer);
+                aglBindBufferARB(GL_ARRAY_BUFFER_ARB, buffer.vertexBuffer);
+                aglBufferDataARB(GL_ARRAY_BUFFER_ARB, copies * pObject->numOfVerts * 8 * sizeof(GLfloat),
+                                 buffer.vertexData, GL_STATIC_DRAW_ARB);
+
+                aglGenBuffersARB(1, &buffer.indexBuffer);
+                aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, buffer.indexBuffer);
+                aglBufferDataARB(GL_ELEMENT_ARRAY_BUFFER_ARB, buffer.indexCount * sizeof(GLushort),
+                                 buffer.indexData, GL_STATIC_DRAW_ARB);
+
+                delete [] buffer.vertexData;
+                delete [] buffer.indexData;
+                buffer.vertexData = NULL;
+                buffer.indexData = NULL;
+            }
+
+            merged.push_back(buffer);
+            mergedObject.push_back(i);
+        }
+    }
+
+    if(vbo)
+    {
+        aglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// This method frees the merged buffers
+//-----------------------------------------------------------------------------
+
+void AInstanceBatch::destroyMergedBuffers()
+{
+    for(unsigned int i = 0; i < merged.size(); i++)
+    {
+        if(merged[i].vertexBuffer)
+            aglDeleteBuffersARB(1, &merged[i].vertexBuffer);
+
+        if(merged[i].indexBuffer)
+            aglDeleteBuffersARB(1, &merged[i].indexBuffer);
+
+        delete [] merged[i].vertexData;
+        delete [] merged[i].indexData;
+    }
+
+    merged.clear();
+    mergedObject.clear();
+}
+
+//-----------------------------------------------------------------------------
+// This method estimates the size of the biggest copy of the object
+//-----------------------------------------------------------------------------
+
+int AInstanceBatch::getObjectPixels(int object)
+{
+    A3DModel *pModel = model->get3DModel();
+    if(!ATextureStreamer::isEnabled() || !pModel->pObject[object].bHasTexture ||
+       model->objectCenters.size() != pModel->pObject.size())
+        return 0;
+
+    // the copies aren't in the modelview matrix, spheres are moved by
+    // their transformations and scaled by the largest scale
+    int pixels = 1;
+    int count = getInstanceCount();
+    for(int c = 0; c < count; c++)
+    {
+        double *m = &transforms[c * 16];
+
+        double scale = 0.0;
+        for(int i = 0; i < 3; i++)
+            scale = max(scale, sqrt(m[i * 4] * m[i * 4] + m[i * 4 + 1] * m[i * 4 + 1] + m[i * 4 + 2] * m[i * 4 + 2]));
+
+        AVector center = model->objectCenters[object];
+        center.applyMatrix(m);
+
+        int size = ATextureStreamer::getScreenSize(center, model->objectRadii[object] * scale);
+        if(size == 0)
+            return 0;
+
+        pixels = max(pixels, size);
+    }
+
+    return pixels;
+}
+
+//-----------------------------------------------------------------------------
+// This method draws all copies of the model
+//-----------------------------------------------------------------------------
+
+void AInstanceBatch::render()
+{
+    drawCalls = 0;
+
+    if(!model || !model->get3DModel())
+        return;
+
+    A3DModel *pModel = model->get3DModel();
+    int count = getInstanceCount();
+
+    // the model isn't in the buffers, we can only draw it copy by copy
+    if(!model->isBufferedRendering() || model->buffers.size() != pModel->pObject.size())
+    {
+        glMatrixMode(GL_MODELVIEW);
+        for(int c = 0; c < count; c++)
+        {
+            glPushMatrix();
+            glMultMatrixd(&transforms[c * 16]);
+            model->render();
+            glPopMatrix();
+        }
+
+        drawCalls = getUnbatchedDrawCalls();
+        return;
+    }
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+
+    if(!dynamic)
+    {
+        // copies are already transformed, one draw call per merged buffer
+        int lastObject = -1;
+        for(unsigned int k = 0; k < merged.size(); k++)
+        {
+            if(mergedObject[k] != lastObject)
+            {
+                lastObject = mergedObject[k];
+                model->setMaterial(&pModel->pObject[lastObject], getObjectPixels(lastObject));
+            }
+
+            A3DSModel::bindBuffer(&merged[k]);
+            A3DSModel::drawBuffer(&merged[k]);
+            drawCalls++;
+        }
+    }
+    else
+    {
+        // material and arrays are set once, then we only change the matrix
+        glMatrixMode(GL_MODELVIEW);
+        for(int i = 0; i < pModel->numOfObjects; i++)
+        {
+            A3DSObjectBuffer *pBuffer = &model->buffers[i];
+
+            if(pBuffer->indexCount == 0)
+                continue;
+
+            model->setMaterial(&pModel->pObject[i], getObjectPixels(i));
+            A3DSModel::bindBuffer(pBuffer);
+
+            for(int c = 0; c < count; c++)
+            {
+                glPushMatrix();
+                glMultMatrixd(&transforms[c * 16]);
+                A3DSModel::drawBuffer(pBuffer);
+                glPopMatrix();
+                drawCalls++;
+            }
+        }
+    }
+
+    if(isVBOSupported())
+    {
+        aglBindBufferARB(GL_ARRAY_BUFFER_ARB, 0);
+        aglBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, 0);
+    }
+
+    glPopClientAttrib();
+}
+
+//-----------------------------------------------------------------------------
+// This method returns number of draw calls without batching
+//-----------------------------------------------------------------------------
+
+unsigned int AInstanceBatch::getUnbatchedDrawCalls()
+{
+    if(!model || !model->get3DModel())
+        return 0;
+
+    return getInstanceCount() * model->get3DModel()->numOfObjects;
+}
+
+} // namespace astral3d
@@ -0,0 +1,176 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file ainstancebatch.h AInstanceBatch class.
+ */
+#ifndef AINSTANCEBATCH_H
+#define AINSTANCEBATCH_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <vector>
+#include <GL/gl.h>
+
+#include "a3dsmodel.h"
+#include "aextensions.h"
+#include "aexceptions.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Class for drawing many copies of one 3DS model.
+ * This class draws the same A3DSModel many times with different
+ * transformations in as few draw calls as possible.
+ * @n
+ * @n
+ * Static batches (default) transform the vertices of all copies once
+ * when the transformations are set and merge them into shared buffers,
+ * so the whole batch is drawn with one glDrawElements call per model object
+ * (more only if the merged object has more than 65535 vertices). Dynamic
+ * batches keep the model buffers and draw every copy with glMultMatrixd,
+ * but the material and vertex arrays are set only once per model object.
+ * Use dynamic batches when the transformations change every frame.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * double transforms[16 * 300];   // 300 OpenGL matrices
+ * ...
+ * AInstanceBatch crates(&crateModel, transforms, 300);
+ * ...
+ * crates.render();
+ * @endcode
+ */
+class AInstanceBatch
+{
+    private:
+        A3DSModel *model;                       // model to draw
+        std::vector<GLdouble> transforms;       // 16 values per copy
+        bool dynamic;                           // draw copies one by one
+
+        // merged buffers of the static batch and the model object they belong to
+        std::vector<A3DSObjectBuffer> merged;
+        std::vector<int> mergedObject;
+
+        unsigned int drawCalls;                 // draw calls of the last render
+
+        // transforms and merges the copies
+        void createMergedBuffers();
+
+        // frees merged buffers
+        void destroyMergedBuffers();
+
+        // returns the size of the biggest copy of the object on the screen
+        int getObjectPixels(int object);
+
+    public:
+        /**
+         * Constructor.
+         */
+        AInstanceBatch();
+
+        /**
+         * Constructor.
+         * @param model Model to draw
+         * @param transforms Array of OpenGL matrices (16 values per copy)
+         * @param count Number of copies
+         * @param dynamic True if the transformations change often
+         * @throw ANullPointerException
+         */
+        AInstanceBatch(A3DSModel *model, const double *transforms, int count, bool dynamic = false);
+
+        /**
+         * Destructor.
+         * Calls AInstanceBatch::destroy method.
+         */
+        ~AInstanceBatch() { destroy(); }
+
+        /**
+         * Builds the batch.
+         * This method sets the model and the transformations of its copies.
+         * The model must be loaded and must stay loaded while the batch
+         * is used.
+         * @param model Model to draw
+         * @param transforms Array of OpenGL matrices (16 values per copy)
+         * @param count Number of copies
+         * @param dynamic True if the transformations change often
+         * @return Pointer to this instance
+         * @throw ANullPointerException
+         */
+        AInstanceBatch *build(A3DSModel *model, const double *transforms, int count, bool dynamic = false);
+
+        /**
+         * Sets new transformations.
+         * This method replaces the transformations of the copies. Static
+         * batches transform and upload all vertices again.
+         * @param transforms Array of OpenGL matrices (16 values per copy)
+         * @param count Number of copies
+         * @throw ANullPointerException
+         */
+        void setTransforms(const double *transforms, int count);
+
+        /**
+         * Renders all copies of the model.
+         */
+        void render();
+
+        /**
+         * Destroys the batch.
+         * This method frees the memory. It is called automatically from
+         * the destructor. The model isn't destroyed.
+         */
+        void destroy();
+
+        /**
+         * Returns the number of copies.
+         * @return Number of copies of the model
+         */
+        int getInstanceCount() { return (int) transforms.size() / 16; }
+
+        /**
+         * Returns the number of draw calls.
+         * @return Number of glDrawElements calls issued by the last
+         *         AInstanceBatch::render
+         */
+        unsigned int getDrawCalls() { return drawCalls; }
+
+        /**
+         * Returns the number of draw calls without batching.
+         * @return Number of draw calls needed to draw all copies by calling
+         *         A3DSModel::render for every copy
+         */
+        unsigned int getUnbatchedDrawCalls();
+
+        /**
+         * Returns true if the batch is dynamic.
+         * @return True if the copies are drawn one by one
+         */
+        bool isDynamic() { return dynamic; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef AINSTANCEBATCH_H
@@ -0,0 +1,463 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "ajobsystem.h"
+#include "aprofiler.h"
+
+#include <cmath>
+
+#ifndef WIN32
+    #include <unistd.h>
+#endif
+
+using namespace std;
+namespace astral3d {
+
+vector<AJobSystem::Worker *> AJobSystem::workers;
+SDL_sem *AJobSystem::wakeSem = NULL;
+SDL_mutex *AJobSystem::groupMutex = NULL;
+volatile int AJobSystem::sleeping = 0;
+volatile bool AJobSystem::quit = false;
+
+//-----------------------------------------------------------------------------
+// atomic addition, returns the new value
+//-----------------------------------------------------------------------------
+
+static int atomicAdd(volatile int *value, int add)
+{
+#ifdef WIN32
+    return InterlockedExchangeAdd((volatile LONG *) value, add) + add;
+#else
+    return __sync_add_and_fetch(value, add);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// AJobGroup destructor
+//-----------------------------------------------------------------------------
+
+AJobGroup::~AJobGroup()
+{
+    AJobSystem::wait(this);
+}
+
+//-----------------------------------------------------------------------------
+// number of processors
+//-----------------------------------------------------------------------------
+
+int AJobSystem::getProcessorCount()
+{
+#ifdef WIN32
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    int count = info.dwNumberOfProcessors;
+#else
+    int count = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+
+    return count > 0 ? count : 1;
+}
+
+//-----------------------------------------------------------------------------
+// init
+//-----------------------------------------------------------------------------
+
+bool AJobSystem::init(int threads)
+{
+    if(!workers.empty())
+        return false;
+
+    if(threads <= 0)
+        threads = getProcessorCount();
+
+    groupMutex = SDL_CreateMutex();
+    wakeSem = SDL_CreateSemaphore(0);
+
+    if(!groupMutex || !wakeSem)
+    {
+        if(groupMutex)
+            SDL_DestroyMutex(groupMutex);
+        if(wakeSem)
+            SDL_DestroySemaphore(wakeSem);
+
+        groupMutex = NULL;
+        wakeSem = NULL;
+        return false;
+    }
+
+    quit = false;
+    sleeping = 0;
+
+    for(int i = 0; i < threads; i++)
+    {
+        Worker *worker = new Worker;
+        worker->mutex = SDL_CreateMutex();
+        worker->thread = NULL;
+        worker->id = (i == 0) ? SDL_ThreadID() : 0;
+        workers.push_back(worker);
+    }
+
+    // the vector doesn't change while the threads run
+    for(int i = 1; i < threads; i++)
+        workers[i]->thread = SDL_CreateThread(workerThread, (void *) (size_t) i);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// shutdown
+//-----------------------------------------------------------------------------
+
+void AJobSystem::shutdown()
+{
+    if(workers.empty())
+        return;
+
+    quit = true;
+
+    for(unsigned int i = 1; i < workers.size(); i++)
+        SDL_SemPost(wakeSem);
+
+    for(unsigned int i = 1; i < workers.size(); i++)
+    {
+        if(workers[i]->thread)
+            SDL_WaitThread(workers[i]->thread, NULL);
+        workers[i]->thread = NULL;
+    }
+
+    // jobs which weren't started
+    while(runOne(0))
+        ;
+
+    for(unsigned int i = 0; i < workers.size(); i++)
+    {
+        if(workers[i]->mutex)
+            SDL_DestroyMutex(workers[i]->mutex);
+        delete workers[i];
+    }
+    workers.clear();
+
+    SDL_DestroyMutex(groupMutex);
+    SDL_DestroySemaphore(wakeSem);
+    groupMutex = NULL;
+    wakeSem = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// index of the calling thread
+//-----------------------------------------------------------------------------
+
+int AJobSystem::getWorker()
+{
+    Uint32 id = SDL_ThreadID();
+
+    for(unsigned int i = 0; i < workers.size(); i++)
+    {
+        if(workers[i]->id == id)
+            return i;
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// adds the job to the queue
+//-----------------------------------------------------------------------------
+
+void AJobSystem::push(int worker, const AJob &job)
+{
+    // one thread, nobody else would run the job
+    if(workers.size() <= 1)
+    {
+        execute(job);
+        return;
+    }
+
+    Worker *w = workers[worker];
+    SDL_mutexP(w->mutex);
+    w->jobs.push_back(job);
+    SDL_mutexV(w->mutex);
+
+    if(sleeping > 0)
+        SDL_SemPost(wakeSem);
+}
+
+//-----------------------------------------------------------------------------
+// takes the job
+//-----------------------------------------------------------------------------
+
+bool AJobSystem::take(int worker, AJob *job)
+{
+    int count = workers.size();
+
+    // own jobs from the end, stolen ones from the start
+    for(int i = 0; i < count; i++)
+    {
+        Worker *w = workers[(worker + i) % count];
+
+        SDL_mutexP(w->mutex);
+        if(!w->jobs.empty())
+        {
+            if(i == 0)
+            {
+                *job = w->jobs.back();
+                w->jobs.pop_back();
+            }
+            else
+            {
+                *job = w->jobs.front();
+                w->jobs.pop_front();
+            }
+
+            SDL_mutexV(w->mutex);
+            return true;
+        }
+        SDL_mutexV(w->mutex);
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// runs the job
+//-----------------------------------------------------------------------------
+
+void AJobSystem::execute(const AJob &job)
+{
+    job.function(job.data);
+
+    AJobGroup *group = job.group;
+    if(!group)
+        return;
+
+    // the group is finished under the lock, AJobSystem::wait takes the
+    // lock too, so the group isn't destroyed before we leave it
+    vector<AJob> waiting;
+
+    if(groupMutex)
+        SDL_mutexP(groupMutex);
+
+    if(atomicAdd(&group->pending, -1) == 0)
+        waiting.swap(group->waiting);
+
+    if(groupMutex)
+        SDL_mutexV(groupMutex);
+
+    int worker = getWorker();
+    for(unsigned int i = 0; i < waiting.size(); i++)
+        push(worker, waiting[i]);
+}
+
+//-----------------------------------------------------------------------------
+// runs one job
+//-----------------------------------------------------------------------------
+
+bool AJobSystem::runOne(int worker)
+{
+    AJob job;
+    if(!take(worker, &job))
+        return false;
+
+    execute(job);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// worker thread
+//-----------------------------------------------------------------------------
+
+int AJobSystem::workerThread(void *data)
+{
+    int index = (int) (size_t) data;
+    workers[index]->id = SDL_ThreadID();
+
+    while(!quit)
+    {
+        if(runOne(index))
+            continue;
+
+        // the timeout covers the job pushed just before we fell asleep
+        atomicAdd(&sleeping, 1);
+        if(!runOne(index))
+            SDL_SemWaitTimeout(wakeSem, 10);
+        atomicAdd(&sleeping, -1);
+    }
+
+    return 0;
+}
+
+//-----------------------------------------------------------------------------
+// submit
+//-----------------------------------------------------------------------------
+
+void AJobSystem::submit(AJobFunction function, void *data, AJobGroup *group, AJobGroup *after)
+{
+    if(!function)
+        return;
+
+    AJob job;
+    job.function = function;
+    job.data = data;
+    job.group = group;
+
+    if(group)
+        atomicAdd(&group->pending, 1);
+
+    if(after)
+    {
+        if(groupMutex)
+            SDL_mutexP(groupMutex);
+
+        bool wait = after->pending > 0;
+        if(wait)
+            after->waiting.push_back(job);
+
+        if(groupMutex)
+            SDL_mutexV(groupMutex);
+
+        // the last job of the group submits it
+        if(wait)
+            return;
+    }
+
+    push(getWorker(), job);
+}
+
+//-----------------------------------------------------------------------------
+// wait
+//-----------------------------------------------------------------------------
+
+void AJobSystem::wait(AJobGroup *group)
+{
+    if(!group)
+        return;
+
+    int worker = getWorker();
+
+    while(group->pending > 0)
+    {
+        if(!runOne(worker))
+            SDL_Delay(0);
+    }
+
+    // the thread finishing the group has left it
+    if(groupMutex)
+    {
+        SDL_mutexP(groupMutex);
+        SDL_mutexV(groupMutex);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// part of parallelFor
+//-----------------------------------------------------------------------------
+
+void AJobSystem::rangeJob(void *data)
+{
+    Range *range = (Range *) data;
+    range->function(range->begin, range->end, range->data);
+}
+
+//-----------------------------------------------------------------------------
+// parallelFor
+//-----------------------------------------------------------------------------
+
+void AJobSystem::parallelFor(int begin, int end, AParallelFunction function, void *data, int grain)
+{
+    if(!function || end <= begin)
+        return;
+
+    int threads = getThreadCount();
+    if(threads <= 1)
+    {
+        function(begin, end, data);
+        return;
+    }
+
+    int count = end - begin;
+    if(grain <= 0)
+        grain = (count + threads * 4 - 1) / (threads * 4);
+
+    vector<Range> ranges;
+    for(int i = begin; i < end; i += grain)
+    {
+        Range range;
+        range.begin = i;
+        range.end = min(i + grain, end);
+        range.function = function;
+        range.data = data;
+        ranges.push_back(range);
+    }
+
+    AJobGroup group;
+    for(unsigned int i = 1; i < ranges.size(); i++)
+        submit(rangeJob, &ranges[i], &group);
+
+    // the calling thread takes the first part
+    rangeJob(&ranges[0]);
+
+    wait(&group);
+}
+
+//-----------------------------------------------------------------------------
+// benchmark
+//-----------------------------------------------------------------------------
+
+static void emptyJob(void *data)
+{
+}
+
+static void benchmarkRange(int begin, int end, void *data)
+{
+    double *values = (double *) data;
+    for(int i = begin; i < end; i++)
+        values[i] = sqrt((double) i) * sin((double) i);
+}
+
+void AJobSystem::benchmark(ostream &out, int jobs)
+{
+    out << "threads:     " << getThreadCount() << " (" << getProcessorCount() << " processors)" << endl;
+
+    if(jobs > 0)
+    {
+        AJobGroup group;
+        double start = AProfiler::getTime();
+        for(int i = 0; i < jobs; i++)
+            submit(emptyJob, NULL, &group);
+        wait(&group);
+        double time = AProfiler::getTime() - start;
+
+        out << "empty job:   " << time * 1000.0 / jobs << " us" << endl;
+    }
+
+    vector<double> values(1 << 22);
+
+    double start = AProfiler::getTime();
+    benchmarkRange(0, values.size(), &values[0]);
+    double serial = AProfiler::getTime() - start;
+
+    start = AProfiler::getTime();
+    parallelFor(0, values.size(), benchmarkRange, &values[0]);
+    double parallel = AProfiler::getTime() - start;
+
+    out << "parallelFor: " << serial << " ms in one thread, " << parallel << " ms in "
+        << getThreadCount() << " threads (speed-up " << (parallel > 0.0 ? serial / parallel : 0.0) << ")" << endl;
+}
+
+} // namespace astral3d
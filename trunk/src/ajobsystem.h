@@ -0,0 +1,261 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file ajobsystem.h AJobSystem class.
+ */
+#ifndef AJOBSYSTEM_H
+#define AJOBSYSTEM_H
+
+#ifdef WIN32
+    #include <windows.h>
+    #include <SDL.h>
+    #include <SDL_thread.h>
+#else
+    #include "SDL.h"
+    #include "SDL_thread.h"
+#endif
+
+#include <vector>
+#include <deque>
+#include <iostream>
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+class AJobGroup;
+
+/**
+ * Function of the job.
+ */
+typedef void (*AJobFunction)(void *data);
+
+/**
+ * Function processing the part of the range of AJobSystem::parallelFor.
+ * @param begin First index of the part
+ * @param end Index after the last one of the part
+ * @param data Parameter given to AJobSystem::parallelFor
+ */
+typedef void (*AParallelFunction)(int begin, int end, void *data);
+
+/**
+ * Job waiting for its thread.
+ */
+struct AJob
+{
+    AJobFunction function;
+    void *data;
+    AJobGroup *group;       // group counting the job or NULL
+};
+
+/**
+ * Group of jobs.
+ * It counts the jobs which weren't finished yet. Jobs can wait for the
+ * whole group (AJobSystem::submit with the 'after' parameter), the thread
+ * can wait for it with AJobSystem::wait. The destructor waits for the jobs
+ * of the group.
+ */
+class AJobGroup
+{
+    friend class AJobSystem;
+
+    private:
+        volatile int pending;           // jobs of the group not finished
+        std::vector<AJob> waiting;      // jobs submitted after the group
+
+        AJobGroup(const AJobGroup &);
+        AJobGroup &operator=(const AJobGroup &);
+
+    public:
+        /**
+         * Constructor.
+         */
+        AJobGroup() { pending = 0; }
+
+        /**
+         * Destructor.
+         * Waits until all jobs of the group are done.
+         */
+        ~AJobGroup();
+
+        /**
+         * Returns true if all jobs of the group are done.
+         * @return True if no job of the group is waiting or running
+         */
+        bool isDone() { return pending == 0; }
+};
+
+/**
+ * Work-stealing job system.
+ * Every thread has its own queue of jobs. A thread takes the jobs it
+ * submitted from the end of its queue (the newest, its data are still in
+ * the cache), an idle thread steals the oldest jobs from the start of the
+ * queues of other threads. The thread which called AJobSystem::init is
+ * one of the threads, it runs the jobs while it waits (AJobSystem::wait).
+ * Jobs can be submitted from any thread, including the jobs.
+ * @n
+ * @n
+ * When the system isn't running (or runs with one thread) the jobs are run
+ * immediately by AJobSystem::submit, which is useful for debugging.
+ * AOcclusionBuffer and ALevel::buildPVS use the system.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * void transform(int begin, int end, void *data)
+ * {
+ *     AVector *points = (AVector *) data;
+ *     for(int i = begin; i < end; i++)
+ *         points[i] = points[i] * 2.0;
+ * }
+ * ...
+ * AJobSystem::init();
+ * AJobSystem::parallelFor(0, points.size(), transform, &points[0]);
+ *
+ * AJobGroup loading;
+ * AJobSystem::submit(loadTextures, &textures, &loading);
+ * AJobSystem::submit(loadModels, &models, &loading);
+ * AJobSystem::submit(buildScene, &scene, NULL, &loading);  // after both
+ * @endcode
+ */
+class AJobSystem
+{
+    private:
+        struct Worker
+        {
+            std::deque<AJob> jobs;
+            SDL_mutex *mutex;           // guards the queue
+            SDL_Thread *thread;         // NULL for the main thread
+            Uint32 id;                  // SDL_ThreadID of the thread
+        };
+
+        // part of the range of parallelFor
+        struct Range
+        {
+            int begin;
+            int end;
+            AParallelFunction function;
+            void *data;
+        };
+
+        static std::vector<Worker *> workers;   // 0 is the main thread
+        static SDL_sem *wakeSem;                // posted for sleeping workers
+        static SDL_mutex *groupMutex;           // guards AJobGroup::waiting
+        static volatile int sleeping;           // workers waiting for jobs
+        static volatile bool quit;
+
+        // index of the calling thread (0 for threads outside the system)
+        static int getWorker();
+
+        // adds the job to the queue of the worker
+        static void push(int worker, const AJob &job);
+
+        // takes the job of the worker or steals one
+        static bool take(int worker, AJob *job);
+
+        // runs the job and finishes its group
+        static void execute(const AJob &job);
+
+        // runs one job if there is any
+        static bool runOne(int worker);
+
+        static int workerThread(void *data);
+        static void rangeJob(void *data);
+
+    public:
+        /**
+         * Starts the job system.
+         * @param threads Number of threads including the calling one (0 for
+         *                the number of processors, 1 runs all jobs in the
+         *                calling thread)
+         * @return True if the system runs (false if it was running)
+         */
+        static bool init(int threads = 0);
+
+        /**
+         * Stops the worker threads.
+         * The jobs which weren't started are run by the calling thread.
+         */
+        static void shutdown();
+
+        /**
+         * Returns true if the system runs.
+         * @return True after AJobSystem::init
+         */
+        static bool isRunning() { return !workers.empty(); }
+
+        /**
+         * Returns the number of threads.
+         * @return Number of threads running the jobs (1 if the system isn't
+         *         running)
+         */
+        static int getThreadCount() { return workers.empty() ? 1 : workers.size(); }
+
+        /**
+         * Returns the number of processors.
+         * @return Number of processors online
+         */
+        static int getProcessorCount();
+
+        /**
+         * Submits the job.
+         * @param function Function of the job
+         * @param data Parameter of the function
+         * @param group Group counting the job or NULL
+         * @param after The job starts after all jobs of this group are done
+         *              (NULL to start it immediately)
+         */
+        static void submit(AJobFunction function, void *data, AJobGroup *group = NULL, AJobGroup *after = NULL);
+
+        /**
+         * Waits until all jobs of the group are done.
+         * The thread runs other jobs meanwhile.
+         * @param group Group to wait for
+         */
+        static void wait(AJobGroup *group);
+
+        /**
+         * Runs the function for the range of indices in parallel.
+         * The range is split into parts which are run as the jobs, the
+         * method returns when all parts are done.
+         * @param begin First index
+         * @param end Index after the last one
+         * @param function Function processing one part
+         * @param data Parameter of the function
+         * @param grain Minimum size of the part (0 for about four parts per
+         *              thread)
+         */
+        static void parallelFor(int begin, int end, AParallelFunction function, void *data, int grain = 0);
+
+        /**
+         * Measures the job system.
+         * Writes the cost of one empty job and the speed-up of
+         * AJobSystem::parallelFor against one thread.
+         * @param out Output stream
+         * @param jobs Number of the empty jobs
+         */
+        static void benchmark(std::ostream &out, int jobs = 100000);
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef AJOBSYSTEM_H
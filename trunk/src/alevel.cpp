@@ -59,6 +59,15 @@ ALevel::ALevel()
     this->sphereRadius = 0.0;
     this->sphere = false;
     this->textureNames = NULL;
+    this->clustersValid = false;
+    this->clusterSize = 0.0;
+    this->drawnClusters = 0;
+    this->culledClusters = 0;
+    this->occludedClusters = 0;
+    this->drawnTriangles = 0;
+    this->pvsRowBytes = 0;
+    this->pvsEnabled = true;
+    this->atlas = NULL;
 }
 
 //-----------------------------------------------------------------------------
@@ -82,6 +91,10 @@ ALevel *ALevel::load(char *filename, char *texturePath)
         throw AReadFileException("ALevel *ALevel::load(char *filename, char *texturePath)");
     }
 
+    // old clusters and their visibility can't be used
+    this->clustersValid = false;
+    this->pvs.clear();
+
     // nacteni poctu textur
     file >> this->numOfTextures;
 
@@ -111,6 +124,9 @@ ALevel *ALevel::load(char *filename, char *texturePath)
         throw AMemoryAllocException("ALevel *ALevel::load(char *filename, char *texturePath)");
     }
 
+    // textures are decoded in parallel after the list is read
+    ATextureLoader loader;
+
     // nacteni a vytvoreni textur levelu
     for(GLuint p=0; p<this->numOfTextures; p++)
     {
@@ -127,13 +143,15 @@ ALevel *ALevel::load(char *filename, char *texturePath)
         strcpy(buffer, texturePath);
         strcat(buffer, texFile);
 
-        // testujeme zda-li muzeme soubor s texturou otevrit
-        if(!loadTextureMipMap(buffer, &(this->textures[texNumber])))
-        {
-            this->destroy();
+        loader.add(buffer, &(this->textures[texNumber]));
+    }
 
-            throw ATextureException("ALevel *ALevel::load(char *filename, char *texturePath)");
-        }
+    // testujeme zda-li muzeme soubory s texturami otevrit
+    if(!loader.load())
+    {
+        this->destroy();
+
+        throw ATextureException("ALevel *ALevel::load(char *filename, char *texturePath)");
     }
 
     // nacteni poctu trojuhelniku
@@ -190,6 +208,11 @@ ALevel *ALevel::load(char *filename, char *texturePath)
         file >> this->triangles[p].normal.z;
     }
 
+    // optional potentially visible set
+    string section;
+    if(file >> section && section == "pvs")
+        loadPVS(file);
+
     file.close();
 
     // finally we create triangle lists
@@ -269,7 +292,7 @@ bool ALevel::removeTriangle(GLuint id)
 
     // trojuhelnik neni validni (pri ukladani - metoda save - se neulozi)
     this->triangles[id].valid = false;
-
+    this->clustersValid = false;
 
     return true;
 }
@@ -375,6 +398,8 @@ bool ALevel::addTriangle(ATriangle triangle)
     // nakonec zvysime pocet trojuhelniku v tomto seznamu na citaci o jednicku
     numberOfTrianglesInList[triangle.textureID]++;
 
+    this->clustersValid = false;
+
     return true;
 }
 
@@ -461,28 +486,32 @@ void ALevel::save(char *filename)
         // ukladame pouze validni trojuhelniky
         if(this->triangles[p].valid)
         {
+        double texCoord[2];     // coordinates without the atlas
         file << this->triangles[p].textureID << endl;
 
         // ulozeni bodu A a jeho texturovych koordinatu
         file << this->triangles[p].a.x << " ";
         file << this->triangles[p].a.y << " ";
         file << this->triangles[p].a.z << " ";
-        file << this->triangles[p].texCoordA[0] << " ";
-        file << this->triangles[p].texCoordA[1] << endl;
+        unmapTexCoord(this->triangles[p].textureID, this->triangles[p].texCoordA, texCoord);
+        file << texCoord[0] << " ";
+        file << texCoord[1] << endl;
 
         // ulozeni bodu B a jeho texturovych koordinatu
         file << this->triangles[p].b.x << " ";
         file << this->triangles[p].b.y << " ";
         file << this->triangles[p].b.z << " ";
-        file << this->triangles[p].texCoordB[0] << " ";
-        file << this->triangles[p].texCoordB[1] << endl;
+        unmapTexCoord(this->triangles[p].textureID, this->triangles[p].texCoordB, texCoord);
+        file << texCoord[0] << " ";
+        file << texCoord[1] << endl;
 
         // ulozeni bodu C a jeho texturovych koordinatu
         file << this->triangles[p].c.x << " ";
         file << this->triangles[p].c.y << " ";
         file << this->triangles[p].c.z << " ";
-        file << this->triangles[p].texCoordC[0] << " ";
-        file << this->triangles[p].texCoordC[1] << endl;
+        unmapTexCoord(this->triangles[p].textureID, this->triangles[p].texCoordC, texCoord);
+        file << texCoord[0] << " ";
+        file << texCoord[1] << endl;
 
         // ulozeni normaly trojuhelniku
         file << this->triangles[p].normal.x << " ";
@@ -493,6 +522,10 @@ void ALevel::save(char *filename)
         } // if(this->triangles[p].valid)
     }
 
+    // the potentially visible set is saved with the clusters it was made for
+    if(!pvs.empty() && clustersValid)
+        savePVS(file);
+
     file.close();
 }
 
@@ -645,52 +678,405 @@ void ALevel::splitTriangles(double s, bool recursive)
 
 void ALevel::render()
 {
+    APROFILE("level");
+
     /* vzdy vykreslujeme vsechny trojuhelniky pro prislusnou texturu */
 
-    for(GLuint p=0; p<this->numOfTextures; p++)
+    // streamed textures need the size of the triangles on the screen
+    bool streaming = ATextureStreamer::isEnabled();
+    if(streaming)
     {
-        // vybereme danou texturu
-        glBindTexture(GL_TEXTURE_2D, this->textures[p]);
+        if(!this->clustersValid)
+            createClusters();
+
+        computeClusterPixels(false);
+    }
 
-        glBegin(GL_TRIANGLES);
+    bool drawing = false;
+    GLuint bound = 0;
+    for(GLuint i=0; i<this->numOfTextures; i++)
+    {
+        GLuint p = textureOrder.empty() ? i : textureOrder[i];
+
+        // textures without triangles aren't bound at all
+        if(this->numberOfTrianglesInList[p] == 0)
+            continue;
+
+        // vybereme danou texturu, textury na stejne strance atlasu se
+        // kresli najednou
+        if(!drawing || this->textures[p] != bound)
+        {
+            if(drawing)
+                glEnd();
+
+            bound = this->textures[p];
+            ARenderState::bindTexture(bound);
+
+            ARenderState::countDrawCall();
+            glBegin(GL_TRIANGLES);
+            drawing = true;
+        }
+
+        ATextureStreamer::use(bound, streaming ? getTexturePixels(p) : 0);
 
         // prochazime seznam trojuhelniku majici tuto texturu
         for(GLuint q=0; q<this->numberOfTrianglesInList[p]; q++)
+            renderTriangle(listOfTriangles[p][q]);
+    }
+
+    if(drawing)
+        glEnd();
+}
+
+//-----------------------------------------------------------------------------
+// renderuje viditelnou cast levelu
+//-----------------------------------------------------------------------------
+
+void ALevel::render(const AFrustum &frustum, AOcclusionBuffer *occlusion)
+{
+    APROFILE("level");
+
+    if(!this->clustersValid)
+        createClusters();
+
+    drawnClusters = 0;
+    culledClusters = 0;
+    occludedClusters = 0;
+    drawnTriangles = 0;
+
+    // clusters potentially visible from the cell of the camera, the camera
+    // outside the grid sees everything
+    const unsigned char *row = NULL;
+    if(!pvs.empty() && pvsEnabled)
+    {
+        int cell = getGridCell(frustum.getPosition(), false);
+        if(cell >= 0)
+            row = &pvs[cell * pvsRowBytes];
+    }
+
+    // first we find visible clusters
+    clusterVisible.resize(clusters.size());
+    for(GLuint c=0; c<clusters.size(); c++)
+    {
+        if(row && !(row[c >> 3] & (1 << (c & 7))))
+            clusterVisible[c] = false;
+        else
+            clusterVisible[c] = frustum.boxInFrustum(clusters[c].min, clusters[c].max);
+
+        if(clusterVisible[c] && occlusion && !occlusion->testBox(clusters[c].min, clusters[c].max))
+        {
+            clusterVisible[c] = false;
+            occludedClusters++;
+        }
+
+        if(clusterVisible[c])
+        {
+            drawnClusters++;
+            drawnTriangles += clusters[c].triangles.size();
+        }
+        else
+        {
+            culledClusters++;
+        }
+    }
+
+    bool streaming = ATextureStreamer::isEnabled();
+    if(streaming)
+        computeClusterPixels(true);
+
+    // textures are still bound only once per frame, textures sharing the
+    // atlas page are drawn together
+    bool drawing = false;
+    GLuint bound = 0;
+    for(GLuint i=0; i<this->numOfTextures; i++)
+    {
+        GLuint p = textureOrder.empty() ? i : textureOrder[i];
+
+        // textures without visible triangles aren't bound at all
+        bool used = false;
+        for(GLuint c=0; c<clusters.size() && !used; c++)
+            used = clusterVisible[c] && clusters[c].textureStart[p] < clusters[c].textureStart[p+1];
+
+        if(!used)
+            continue;
+
+        if(!drawing || this->textures[p] != bound)
+        {
+            if(drawing)
+                glEnd();
+
+            bound = this->textures[p];
+            ARenderState::bindTexture(bound);
+
+            ARenderState::countDrawCall();
+            glBegin(GL_TRIANGLES);
+            drawing = true;
+        }
+
+        for(GLuint c=0; c<clusters.size(); c++)
         {
-            GLuint t = listOfTriangles[p][q];
-
-            double v[3];
-
-            // nastaveni normaly
-            v[0] = this->triangles[t].normal.x;
-            v[1] = this->triangles[t].normal.y;
-            v[2] = this->triangles[t].normal.z;
-            glNormal3dv(v);
-
-            // nastaveni a vykresleni bodu A
-            glTexCoord2dv(this->triangles[t].texCoordA);
-            v[0] = this->triangles[t].a.x;
-            v[1] = this->triangles[t].a.y;
-            v[2] = this->triangles[t].a.z;
-            glVertex3dv(v);
-
-            // nastaveni a vykresleni bodu B
-            glTexCoord2dv(this->triangles[t].texCoordB);
-            v[0] = this->triangles[t].b.x;
-            v[1] = this->triangles[t].b.y;
-            v[2] = this->triangles[t].b.z;
-            glVertex3dv(v);
-
-            // nastaveni a vykresleni bodu C
-            glTexCoord2dv(this->triangles[t].texCoordC);
-            v[0] = this->triangles[t].c.x;
-            v[1] = this->triangles[t].c.y;
-            v[2] = this->triangles[t].c.z;
-            glVertex3dv(v);
+            if(!clusterVisible[c])
+                continue;
+
+            const ALevelCluster &cluster = clusters[c];
+            for(GLuint q=cluster.textureStart[p]; q<cluster.textureStart[p+1]; q++)
+                renderTriangle(cluster.triangles[q]);
         }
 
+        // only the textures of visible triangles get finer levels
+        ATextureStreamer::use(bound, streaming ? getTexturePixels(p) : 0);
+    }
+
+    if(drawing)
         glEnd();
+}
+
+//-----------------------------------------------------------------------------
+// estimates the size of the clusters on the screen
+//-----------------------------------------------------------------------------
+
+void ALevel::computeClusterPixels(bool visibleOnly)
+{
+    clusterPixels.resize(clusters.size());
+    for(GLuint c=0; c<clusters.size(); c++)
+    {
+        if(visibleOnly && !clusterVisible[c])
+        {
+            clusterPixels[c] = -1;
+            continue;
+        }
+
+        AVector center = (clusters[c].min + clusters[c].max) * 0.5;
+        double radius = (clusters[c].max - clusters[c].min).getLength() * 0.5;
+        clusterPixels[c] = ATextureStreamer::getScreenSize(center, radius);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// returns the size of the drawn triangles with the texture on the screen
+//-----------------------------------------------------------------------------
+
+int ALevel::getTexturePixels(GLuint texture)
+{
+    // the biggest cluster decides, 0 (camera inside the cluster) means
+    // all levels
+    int pixels = -1;
+    for(GLuint c=0; c<clusters.size(); c++)
+    {
+        const ALevelCluster &cluster = clusters[c];
+        if(clusterPixels[c] < 0 || cluster.textureStart[texture] == cluster.textureStart[texture + 1])
+            continue;
+
+        if(clusterPixels[c] == 0)
+            return 0;
+
+        pixels = max(pixels, clusterPixels[c]);
     }
+
+    return pixels > 0 ? pixels : 0;
+}
+
+//-----------------------------------------------------------------------------
+// groups the triangles into clusters according to their position
+//-----------------------------------------------------------------------------
+
+void ALevel::createClusters()
+{
+    clusters.clear();
+    gridClusters.clear();
+    gridSize[0] = gridSize[1] = gridSize[2] = 0;
+    clustersValid = true;
+
+    // visibility was computed for the old clusters
+    pvs.clear();
+    pvsRowBytes = 0;
+
+    // bounding box of the rendered triangles
+    GLuint count = 0;
+    AVector min, max;
+
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        if(!triangles[p].valid || triangles[p].textureID >= numOfTextures)
+            continue;
+
+        const AVector *v[3] = { &triangles[p].a, &triangles[p].b, &triangles[p].c };
+        for(int i=0; i<3; i++)
+        {
+            if(count == 0 && i == 0)
+            {
+                min = max = *v[i];
+                continue;
+            }
+
+            if(v[i]->x < min.x) min.x = v[i]->x;
+            if(v[i]->y < min.y) min.y = v[i]->y;
+            if(v[i]->z < min.z) min.z = v[i]->z;
+            if(v[i]->x > max.x) max.x = v[i]->x;
+            if(v[i]->y > max.y) max.y = v[i]->y;
+            if(v[i]->z > max.z) max.z = v[i]->z;
+        }
+        count++;
+    }
+
+    if(count == 0)
+        return;
+
+    AVector extent = max - min;
+
+    // edge of the cluster cube
+    double edge = clusterSize;
+    if(edge <= 0.0)
+    {
+        // about 256 triangles in one cluster
+        GLuint wanted = count / 256 + 1;
+
+        edge = extent.x;
+        if(extent.y > edge) edge = extent.y;
+        if(extent.z > edge) edge = extent.z;
+        if(edge <= 0.0) edge = 1.0;
+
+        for(int i=0; i<64; i++)
+        {
+            double cells = ceil(extent.x / edge + 0.001) *
+                           ceil(extent.y / edge + 0.001) *
+                           ceil(extent.z / edge + 0.001);
+            if(cells >= wanted)
+                break;
+            edge *= 0.8;
+        }
+    }
+
+    // the grid can't be too big
+    for(int i=0; i<3; i++)
+    {
+        double size = ceil(extent[i] / edge + 0.001);
+        if(size > 64.0)
+            edge = extent[i] / 63.0;
+    }
+
+    gridOrigin = min;
+    gridCell = edge;
+    gridSize[0] = (int) ceil(extent.x / edge + 0.001);
+    gridSize[1] = (int) ceil(extent.y / edge + 0.001);
+    gridSize[2] = (int) ceil(extent.z / edge + 0.001);
+
+    gridClusters.assign(gridSize[0] * gridSize[1] * gridSize[2], -1);
+
+    // triangles go to the cell containing their centre
+    vector<int> clusterOfTriangle(numOfTriangles, -1);
+    GLuint numOfClusters = 0;
+
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        if(!triangles[p].valid || triangles[p].textureID >= numOfTextures)
+            continue;
+
+        int index = getGridCell((triangles[p].a + triangles[p].b + triangles[p].c) * (1.0 / 3.0), true);
+
+        // new cluster
+        if(gridClusters[index] < 0)
+            gridClusters[index] = numOfClusters++;
+
+        clusterOfTriangle[p] = gridClusters[index];
+    }
+
+    fillClusters(clusterOfTriangle, numOfClusters);
+}
+
+//-----------------------------------------------------------------------------
+// returns the grid cell containing the point
+//-----------------------------------------------------------------------------
+
+int ALevel::getGridCell(const AVector &point, bool clamp)
+{
+    if(gridClusters.empty())
+        return -1;
+
+    int cell[3];
+    for(int i=0; i<3; i++)
+    {
+        cell[i] = (int) floor((point[i] - gridOrigin[i]) / gridCell);
+
+        if(cell[i] < 0 || cell[i] >= gridSize[i])
+        {
+            if(!clamp)
+                return -1;
+
+            cell[i] = cell[i] < 0 ? 0 : gridSize[i] - 1;
+        }
+    }
+
+    return (cell[2] * gridSize[1] + cell[1]) * gridSize[0] + cell[0];
+}
+
+//-----------------------------------------------------------------------------
+// fills the clusters with the triangles assigned to them
+//-----------------------------------------------------------------------------
+
+void ALevel::fillClusters(const vector<int> &clusterOfTriangle, GLuint numOfClusters)
+{
+    clusters.assign(numOfClusters, ALevelCluster());
+
+    vector<bool> empty(numOfClusters, true);
+
+    for(GLuint c=0; c<numOfClusters; c++)
+        clusters[c].textureStart.assign(numOfTextures + 1, 0);
+
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        if(clusterOfTriangle[p] < 0)
+            continue;
+
+        int c = clusterOfTriangle[p];
+        ALevelCluster &cluster = clusters[c];
+
+        if(empty[c])
+        {
+            cluster.min = cluster.max = triangles[p].a;
+            empty[c] = false;
+        }
+
+        const AVector *v[3] = { &triangles[p].a, &triangles[p].b, &triangles[p].c };
+        for(int i=0; i<3; i++)
+        {
+            if(v[i]->x < cluster.min.x) cluster.min.x = v[i]->x;
+            if(v[i]->y < cluster.min.y) cluster.min.y = v[i]->y;
+            if(v[i]->z < cluster.min.z) cluster.min.z = v[i]->z;
+            if(v[i]->x > cluster.max.x) cluster.max.x = v[i]->x;
+            if(v[i]->y > cluster.max.y) cluster.max.y = v[i]->y;
+            if(v[i]->z > cluster.max.z) cluster.max.z = v[i]->z;
+        }
+
+        // we only count the triangles for now
+        cluster.textureStart[triangles[p].textureID + 1]++;
+    }
+
+    // counts become offsets of the textures in the cluster
+    for(GLuint c=0; c<clusters.size(); c++)
+    {
+        for(GLuint t=0; t<numOfTextures; t++)
+            clusters[c].textureStart[t + 1] += clusters[c].textureStart[t];
+
+        clusters[c].triangles.resize(clusters[c].textureStart[numOfTextures]);
+    }
+
+    // and finally we sort the triangles by the textures
+    vector<GLuint> fill;
+    for(GLuint c=0; c<clusters.size(); c++)
+        fill.insert(fill.end(), clusters[c].textureStart.begin(), clusters[c].textureStart.end() - 1);
+
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        if(clusterOfTriangle[p] < 0)
+            continue;
+
+        int c = clusterOfTriangle[p];
+        GLuint &position = fill[c * numOfTextures + triangles[p].textureID];
+        clusters[c].triangles[position++] = p;
+    }
+
+    clustersValid = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -706,7 +1092,13 @@ void ALevel::destroy()
     {
         // uvolneni textur z pameti
         for(GLuint p=0; p<this->numOfTextures; p++)
+        {
+            // pages of the atlas are deleted by the atlas
+            if(p < this->atlasImages.size() && this->atlasImages[p] >= 0)
+                continue;
+
             deleteTexture(&(this->textures[p]));
+        }
 
         delete [] this->textures;
     }
@@ -734,6 +1126,16 @@ void ALevel::destroy()
     this->listOfTriangles = NULL;
     this->numberOfTrianglesInList = NULL;
     this->textureNames = NULL;
+
+    this->clusters.clear();
+    this->gridClusters.clear();
+    this->clustersValid = false;
+    this->pvs.clear();
+
+    this->atlas = NULL;
+    this->atlasImages.clear();
+    this->atlasMapping.clear();
+    this->textureOrder.clear();
 }
 
 //-----------------------------------------------------------------------------
@@ -770,6 +1172,8 @@ AVector ALevel::getGravityPosition(const AVector &pos)
 
 AVector ALevel::getPosition(const AVector &pos, const AVector &vel)
 {
+    APROFILE("collision");
+
     // nastaveni parametru kolizni struktury
     colPackage.r3Position = pos;
     colPackage.r3Velocity = vel;
@@ -952,7 +1356,8 @@ ALevel *ALevel::buildFromModel(Model3D *model)
         throw AMemoryAllocException("ALevel *ALevel::buildFromModel(Model3D *model)");
     }
 
-    // than we load textures
+    // than we load textures, they are decoded in parallel
+    ATextureLoader loader;
     for(int i = 0; i < pModel->numOfObjects; i++)
     {
         if(pModel->pObject.size() <= 0)
@@ -974,15 +1379,17 @@ ALevel *ALevel::buildFromModel(Model3D *model)
             strcpy(buf, bar.c_str());
             strcat(buf, textureNames[ID].c_str());
 
-            // loads the texture
-            if(!loadTextureMipMap(buf, &(textures[ID])))
-            {
-                this->destroy();
-                throw ATextureException("ALevel *ALevel::buildFromModel(Model3D *model)");
-            }
+            // the texture shared by more objects is loaded once
+            loader.add(buf, &(textures[ID]));
         }
     }
 
+    if(!loader.load())
+    {
+        this->destroy();
+        throw ATextureException("ALevel *ALevel::buildFromModel(Model3D *model)");
+    }
+
     // we find total count of triangles
     GLuint triangleCount = 0;
     for(int i = 0; i < pModel->numOfObjects; i++)
@@ -1164,4 +1571,540 @@ void ALevel::applyMatrix(double mat[16])
         triangles[p].c.applyMatrix(mat);
         triangles[p].normal.applyMatrix(mat);
     }
+
+    clustersValid = false;
+}
+
+//-----------------------------------------------------------------------------
+// data of the jobs building the PVS
+//-----------------------------------------------------------------------------
+
+struct APVSBuildData
+{
+    ALevel *level;
+    int samples;
+};
+
+//-----------------------------------------------------------------------------
+// job computing the rows of the PVS
+//-----------------------------------------------------------------------------
+
+void ALevel::pvsJob(int begin, int end, void *data)
+{
+    APVSBuildData *build = (APVSBuildData *) data;
+
+    // every row is written by one job only
+    for(int cell = begin; cell < end; cell++)
+        build->level->computePVSRow(cell, build->samples);
+}
+
+//-----------------------------------------------------------------------------
+// tests if the segment from a to b hits a triangle outside the cluster
+//-----------------------------------------------------------------------------
+
+bool ALevel::segmentBlocked(const AVector &a, const AVector &b, GLuint ignoredCluster)
+{
+    AVector dir = b - a;
+
+    for(GLuint c=0; c<clusters.size(); c++)
+    {
+        if(c == ignoredCluster)
+            continue;
+
+        // segment against the box of the cluster (slabs)
+        double tMin = 0.0, tMax = 1.0;
+        bool miss = false;
+
+        for(int i=0; i<3 && !miss; i++)
+        {
+            double lo = clusters[c].min[i];
+            double hi = clusters[c].max[i];
+
+            if(fabs(dir[i]) < 1e-12)
+            {
+                if(a[i] < lo || a[i] > hi)
+                    miss = true;
+                continue;
+            }
+
+            double t1 = (lo - a[i]) / dir[i];
+            double t2 = (hi - a[i]) / dir[i];
+            if(t1 > t2) { double t = t1; t1 = t2; t2 = t; }
+            if(t1 > tMin) tMin = t1;
+            if(t2 < tMax) tMax = t2;
+            if(tMin > tMax)
+                miss = true;
+        }
+
+        if(miss)
+            continue;
+
+        // segment against the triangles (Moller-Trumbore)
+        for(GLuint q=0; q<clusters[c].triangles.size(); q++)
+        {
+            const ATriangle &tri = triangles[clusters[c].triangles[q]];
+
+            AVector e1 = tri.b - tri.a;
+            AVector e2 = tri.c - tri.a;
+            AVector p = dir % e2;
+            double det = e1 * p;
+
+            if(fabs(det) < 1e-12)
+                continue;
+
+            double inv = 1.0 / det;
+            AVector s = a - tri.a;
+            double u = (s * p) * inv;
+            if(u < 0.0 || u > 1.0)
+                continue;
+
+            AVector r = s % e1;
+            double v = (dir * r) * inv;
+            if(v < 0.0 || u + v > 1.0)
+                continue;
+
+            double t = (e2 * r) * inv;
+            if(t > 1e-6 && t < 1.0 - 1e-6)
+                return true;
+        }
+    }
+
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// computes clusters potentially visible from one cell of the grid
+//-----------------------------------------------------------------------------
+
+void ALevel::computePVSRow(int cell, int samples)
+{
+    unsigned char *row = &pvs[cell * pvsRowBytes];
+
+    int cx = cell % gridSize[0];
+    int cy = (cell / gridSize[0]) % gridSize[1];
+    int cz = cell / (gridSize[0] * gridSize[1]);
+
+    AVector cellMin = gridOrigin + AVector(cx * gridCell, cy * gridCell, cz * gridCell);
+    AVector cellMax = cellMin + AVector(gridCell, gridCell, gridCell);
+
+    // the same regular pattern of samples is used for every cell so the
+    // result doesn't depend on the number of threads, the corners of the
+    // cell are added so the edges of the cell see what the camera there sees
+    vector<AVector> from;
+    for(int i=0; i<samples; i++)
+        for(int j=0; j<samples; j++)
+            for(int k=0; k<samples; k++)
+                from.push_back(cellMin + AVector((i + 0.5) / samples,
+                                                 (j + 0.5) / samples,
+                                                 (k + 0.5) / samples) * gridCell);
+
+    for(int i=0; i<8; i++)
+        from.push_back(AVector(i & 1 ? cellMax.x : cellMin.x,
+                               i & 2 ? cellMax.y : cellMin.y,
+                               i & 4 ? cellMax.z : cellMin.z));
+
+    for(GLuint c=0; c<clusters.size(); c++)
+    {
+        const ALevelCluster &cluster = clusters[c];
+
+        // clusters touching the cell are always visible
+        if(cluster.min.x <= cellMax.x && cluster.max.x >= cellMin.x &&
+           cluster.min.y <= cellMax.y && cluster.max.y >= cellMin.y &&
+           cluster.min.z <= cellMax.z && cluster.max.z >= cellMin.z)
+        {
+            row[c >> 3] |= 1 << (c & 7);
+            continue;
+        }
+
+        // targets are the centre and the corners of every triangle, the
+        // corners are moved a bit to the centre so the rays don't hit the
+        // edges of the neighbouring triangles; both sides of the triangles
+        // are drawn, so back faces are tested too
+        bool visible = false;
+        for(GLuint q=0; q<cluster.triangles.size() && !visible; q++)
+        {
+            const ATriangle &tri = triangles[cluster.triangles[q]];
+            AVector centre = (tri.a + tri.b + tri.c) * (1.0 / 3.0);
+
+            AVector to[4];
+            to[0] = centre;
+            to[1] = tri.a + (centre - tri.a) * 0.01;
+            to[2] = tri.b + (centre - tri.b) * 0.01;
+            to[3] = tri.c + (centre - tri.c) * 0.01;
+
+            for(GLuint f=0; f<from.size() && !visible; f++)
+                for(int t=0; t<4 && !visible; t++)
+                    if(!segmentBlocked(from[f], to[t], c))
+                        visible = true;
+        }
+
+        if(visible)
+            row[c >> 3] |= 1 << (c & 7);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// builds the potentially visible set
+//-----------------------------------------------------------------------------
+
+void ALevel::buildPVS(int threads, int samples)
+{
+    if(!this->clustersValid)
+        createClusters();
+
+    if(clusters.empty())
+        return;
+
+    if(threads < 1)
+        threads = 1;
+    if(samples < 1)
+        samples = 1;
+
+    int cells = gridSize[0] * gridSize[1] * gridSize[2];
+
+    pvsRowBytes = (clusters.size() + 7) / 8;
+    pvs.assign(cells * pvsRowBytes, 0);
+
+    APVSBuildData data;
+    data.level = this;
+    data.samples = samples;
+
+    if(threads == 1)
+    {
+        pvsJob(0, cells, &data);
+    }
+    else
+    {
+        // cells differ a lot in the cost, small parts balance the threads;
+        // without the running job system the rows are computed here
+        AJobSystem::parallelFor(0, cells, pvsJob, &data, 1);
+    }
+
+    dilatePVS();
+}
+
+//-----------------------------------------------------------------------------
+// adds the clusters seen from the neighbouring cells
+//-----------------------------------------------------------------------------
+
+void ALevel::dilatePVS()
+{
+    // rays can miss a gap seen from the cell, the rows of the 26
+    // neighbours are a cheap safety margin
+    vector<unsigned char> rows(pvs);
+    int cells = gridSize[0] * gridSize[1] * gridSize[2];
+
+    for(int cell=0; cell<cells; cell++)
+    {
+        int cx = cell % gridSize[0];
+        int cy = (cell / gridSize[0]) % gridSize[1];
+        int cz = cell / (gridSize[0] * gridSize[1]);
+
+        unsigned char *row = &pvs[cell * pvsRowBytes];
+
+        for(int z=max(cz - 1, 0); z<=min(cz + 1, gridSize[2] - 1); z++)
+            for(int y=max(cy - 1, 0); y<=min(cy + 1, gridSize[1] - 1); y++)
+                for(int x=max(cx - 1, 0); x<=min(cx + 1, gridSize[0] - 1); x++)
+                {
+                    const unsigned char *neighbour = &rows[((z * gridSize[1] + y) * gridSize[0] + x) * pvsRowBytes];
+                    for(GLuint b=0; b<pvsRowBytes; b++)
+                        row[b] |= neighbour[b];
+                }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// tests if the cluster can be seen from the point
+//-----------------------------------------------------------------------------
+
+bool ALevel::isClusterPotentiallyVisible(const AVector &point, GLuint cluster)
+{
+    if(!this->clustersValid)
+        createClusters();
+
+    if(pvs.empty() || cluster >= clusters.size())
+        return true;
+
+    int cell = getGridCell(point, false);
+    if(cell < 0)
+        return true;
+
+    return (pvs[cell * pvsRowBytes + (cluster >> 3)] & (1 << (cluster & 7))) != 0;
+}
+
+//-----------------------------------------------------------------------------
+// saves the potentially visible set
+//-----------------------------------------------------------------------------
+
+void ALevel::savePVS(ofstream &file)
+{
+    // cluster of every saved (valid) triangle
+    vector<int> clusterOfTriangle(numOfTriangles, -1);
+    for(GLuint c=0; c<clusters.size(); c++)
+        for(GLuint q=0; q<clusters[c].triangles.size(); q++)
+            clusterOfTriangle[clusters[c].triangles[q]] = c;
+
+    file << "pvs" << endl << endl;
+
+    file.precision(17);
+    file << gridOrigin.x << " " << gridOrigin.y << " " << gridOrigin.z << " " << gridCell << endl;
+    file << gridSize[0] << " " << gridSize[1] << " " << gridSize[2] << endl;
+    file << clusters.size() << endl << endl;
+
+    // cells of the clusters
+    for(GLuint i=0; i<gridClusters.size(); i++)
+    {
+        if(gridClusters[i] >= 0)
+            file << gridClusters[i] << " " << i << endl;
+    }
+
+    file << endl;
+
+    // clusters of the triangles
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        if(this->triangles[p].valid)
+            file << clusterOfTriangle[p] << endl;
+    }
+
+    file << endl;
+
+    // rows of the visibility matrix in hexadecimal numbers
+    file << hex;
+    for(GLuint i=0; i<pvs.size(); i++)
+    {
+        file << (int) (pvs[i] >> 4) << (int) (pvs[i] & 15);
+
+        if((i + 1) % pvsRowBytes == 0)
+            file << endl;
+    }
+    file << dec;
+}
+
+//-----------------------------------------------------------------------------
+// loads the potentially visible set
+//-----------------------------------------------------------------------------
+
+bool ALevel::loadPVS(ifstream &file)
+{
+    int numOfClusters = 0;
+
+    file >> gridOrigin.x >> gridOrigin.y >> gridOrigin.z >> gridCell;
+    file >> gridSize[0] >> gridSize[1] >> gridSize[2];
+    file >> numOfClusters;
+
+    int cells = gridSize[0] * gridSize[1] * gridSize[2];
+
+    if(!file || gridCell <= 0.0 || gridSize[0] <= 0 || gridSize[1] <= 0 ||
+       gridSize[2] <= 0 || cells > 64 * 64 * 64 || numOfClusters <= 0 || numOfClusters > cells)
+    {
+        clustersValid = false;
+        return false;
+    }
+
+    gridClusters.assign(cells, -1);
+    for(int c=0; c<numOfClusters; c++)
+    {
+        int cluster, cell;
+        file >> cluster >> cell;
+
+        if(!file || cluster < 0 || cluster >= numOfClusters || cell < 0 || cell >= cells)
+        {
+            gridClusters.clear();
+            clustersValid = false;
+            return false;
+        }
+
+        gridClusters[cell] = cluster;
+    }
+
+    vector<int> clusterOfTriangle(numOfTriangles, -1);
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        file >> clusterOfTriangle[p];
+
+        if(!file || clusterOfTriangle[p] >= numOfClusters ||
+           (clusterOfTriangle[p] >= 0 && triangles[p].textureID >= numOfTextures))
+        {
+            gridClusters.clear();
+            clustersValid = false;
+            return false;
+        }
+    }
+
+    // we can use the saved clusters, the triangles may be rounded a bit and
+    // new clusters could differ
+    fillClusters(clusterOfTriangle, numOfClusters);
+
+    pvsRowBytes = (numOfClusters + 7) / 8;
+    pvs.assign(cells * pvsRowBytes, 0);
+
+    for(int i=0; i<cells; i++)
+    {
+        string row;
+        file >> row;
+
+        if(!file || row.size() != pvsRowBytes * 2)
+        {
+            pvs.clear();
+            return false;
+        }
+
+        for(GLuint b=0; b<pvsRowBytes; b++)
+        {
+            pvs[i * pvsRowBytes + b] = (unsigned char) strtol(row.substr(b * 2, 2).c_str(), NULL, 16);
+        }
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// returns big triangles usable as occluders
+//-----------------------------------------------------------------------------
+
+void ALevel::getOccluders(vector<AVector> &occluders, double minArea)
+{
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        if(!triangles[p].valid)
+            continue;
+
+        AVector cross = (triangles[p].b - triangles[p].a) % (triangles[p].c - triangles[p].a);
+
+        if(cross.getLength() * 0.5 < minArea)
+            continue;
+
+        occluders.push_back(triangles[p].a);
+        occluders.push_back(triangles[p].b);
+        occluders.push_back(triangles[p].c);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// adds the textures to the atlas
+//-----------------------------------------------------------------------------
+
+ALevel *ALevel::addToAtlas(AAtlas *atlas, char *texturePath)
+{
+    if(!atlas || !texturePath)
+    {
+        throw ANullPointerException("ALevel *ALevel::addToAtlas(AAtlas *atlas, char *texturePath)");
+    }
+
+    this->atlas = atlas;
+    atlasImages.assign(numOfTextures, -1);
+    atlasMapping.clear();
+    textureOrder.clear();
+
+    // repeated textures can't be in the atlas, small errors only read the
+    // padding around the image
+    vector<bool> inRange(numOfTextures, true);
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        GLuint t = triangles[p].textureID;
+        if(!triangles[p].valid || t >= numOfTextures)
+            continue;
+
+        const double *coords[3] = { triangles[p].texCoordA, triangles[p].texCoordB, triangles[p].texCoordC };
+        for(int k = 0; k < 3; k++)
+        {
+            for(int j = 0; j < 2; j++)
+            {
+                if(coords[k][j] < -0.001 || coords[k][j] > 1.001)
+                    inRange[t] = false;
+            }
+        }
+    }
+
+    for(GLuint t=0; t<numOfTextures; t++)
+    {
+        if(!inRange[t] || textureNames[t].empty())
+            continue;
+
+        // textures the atlas can't take stay in their own textures
+        string file = string(texturePath) + textureNames[t];
+        atlasImages[t] = atlas->addImage((char *) file.c_str());
+    }
+
+    return this;
+}
+
+//-----------------------------------------------------------------------------
+// moves the textures to the atlas
+//-----------------------------------------------------------------------------
+
+ALevel *ALevel::useAtlas()
+{
+    if(!atlas || atlasImages.empty() || !atlasMapping.empty())
+        return this;
+
+    if(!atlas->isBuilt())
+    {
+        setAstral3DError("The atlas isn't built", "ALevel::useAtlas()", "AAtlas::isBuilt()");
+
+        throw ATextureException("ALevel *ALevel::useAtlas()");
+    }
+
+    // identity for the textures outside the atlas
+    atlasMapping.resize(numOfTextures * 4);
+    for(GLuint t=0; t<numOfTextures; t++)
+    {
+        double *mapping = &atlasMapping[t * 4];
+        mapping[0] = mapping[1] = 0.0;
+        mapping[2] = mapping[3] = 1.0;
+
+        if(atlasImages[t] < 0)
+            continue;
+
+        atlas->getMapping(atlasImages[t], &mapping[0], &mapping[2]);
+
+        deleteTexture(&(this->textures[t]));
+        this->textures[t] = atlas->getTexture(atlasImages[t]);
+    }
+
+    for(GLuint p=0; p<this->numOfTriangles; p++)
+    {
+        GLuint t = triangles[p].textureID;
+        if(t >= numOfTextures || atlasImages[t] < 0)
+            continue;
+
+        const double *mapping = &atlasMapping[t * 4];
+        double *coords[3] = { triangles[p].texCoordA, triangles[p].texCoordB, triangles[p].texCoordC };
+        for(int k = 0; k < 3; k++)
+        {
+            coords[k][0] = mapping[0] + coords[k][0] * mapping[2];
+            coords[k][1] = mapping[1] + coords[k][1] * mapping[3];
+        }
+    }
+
+    // textures of one page are drawn one after another
+    vector< pair<GLuint, GLuint> > order(numOfTextures);
+    for(GLuint t=0; t<numOfTextures; t++)
+        order[t] = make_pair(this->textures[t], t);
+
+    sort(order.begin(), order.end());
+
+    textureOrder.resize(numOfTextures);
+    for(GLuint t=0; t<numOfTextures; t++)
+        textureOrder[t] = order[t].second;
+
+    return this;
+}
+
+//-----------------------------------------------------------------------------
+// texture coordinates without the atlas
+//-----------------------------------------------------------------------------
+
+void ALevel::unmapTexCoord(GLuint texture, const double *texCoord, double *result)
+{
+    result[0] = texCoord[0];
+    result[1] = texCoord[1];
+
+    if(atlasMapping.empty() || texture >= numOfTextures || atlasImages[texture] < 0)
+        return;
+
+    const double *mapping = &atlasMapping[texture * 4];
+    result[0] = (texCoord[0] - mapping[0]) / mapping[2];
+    result[1] = (texCoord[1] - mapping[1]) / mapping[3];
 }
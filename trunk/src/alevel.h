@@ -25,6 +25,11 @@
 
 #ifdef WIN32
     #include <windows.h>
+    #include <SDL.h>
+    #include <SDL_thread.h>
+#else
+    #include "SDL.h"
+    #include "SDL_thread.h"
 #endif
 
 #include <iostream>
@@ -32,13 +37,21 @@
 #include <string>
 #include <cstring>
 #include <sstream>
+#include <vector>
+#include <cstdlib>
 
 #include <GL/gl.h>
 
 #include "atexture.h"
+#include "aatlas.h"
 #include "avector.h"
 #include "apolygons.h"
 #include "acollision.h"
+#include "afrustum.h"
+#include "aocclusion.h"
+#include "ajobsystem.h"
+#include "atextureloader.h"
+#include "aprofiler.h"
 #include "a3dsmodel.h"
 #include "aerror.h"
 #include "aabstract.h"
@@ -50,6 +63,21 @@ namespace astral3d {
 
 typedef GLuint* pGLuint;
 
+/**
+ * Cluster of level triangles.
+ * Triangles of the level are grouped into clusters according to their
+ * position. Each cluster has its bounding box so the whole cluster can be
+ * skipped when it isn't visible.
+ */
+struct ALevelCluster
+{
+    AVector min;                        // minimal corner of the bounding box
+    AVector max;                        // maximal corner of the bounding box
+    std::vector<GLuint> triangles;      // triangles sorted by the texture
+    std::vector<GLuint> textureStart;   // first triangle with the texture,
+                                        // numOfTextures + 1 items
+};
+
 //-----------------------------------------------------------------------------
 //  ALevel class
 //-----------------------------------------------------------------------------
@@ -68,6 +96,14 @@ class ALevel : public Level
         GLuint numOfTriangles;          // number of triangles building the level
         GLuint numOfTextures;           // number of loaded textures
 
+        // texture atlas: image of every texture in the atlas or -1, mapping
+        // of the texture coordinates (offset u, v, scale u, v per texture)
+        // and order of the textures grouping the same atlas pages
+        AAtlas *atlas;
+        std::vector<int> atlasImages;
+        std::vector<double> atlasMapping;
+        std::vector<GLuint> textureOrder;
+
         // lists of triangles, each list contains list of triangles
         // having the same texture - this is used for speed up rendering
         GLuint **listOfTriangles;
@@ -78,8 +114,76 @@ class ALevel : public Level
         // max depth of recursion when testing collision detection
         int collisionRecursionDepth;
 
+        // spatial clusters of triangles used for culling
+        std::vector<ALevelCluster> clusters;
+        bool clustersValid;
+        double clusterSize;
+
+        // uniform grid the clusters are made of, each cell holds the index
+        // of its cluster or -1
+        AVector gridOrigin;
+        double gridCell;
+        int gridSize[3];
+        std::vector<int> gridClusters;
+
+        // visibility of the clusters in the current frame
+        std::vector<char> clusterVisible;
+
+        // size of the clusters on the screen for the texture streaming,
+        // -1 for the clusters which aren't drawn
+        std::vector<int> clusterPixels;
+
+        // potentially visible set, one row of bits for every cell of the
+        // grid, one bit for every cluster
+        std::vector<unsigned char> pvs;
+        GLuint pvsRowBytes;
+        bool pvsEnabled;
+
+        // culling statistics of the last frame
+        GLuint drawnClusters;
+        GLuint culledClusters;
+        GLuint occludedClusters;
+        GLuint drawnTriangles;
+
     private:
 
+        // creates spatial clusters of the triangles
+        void createClusters();
+
+        // fills the clusters with the triangles assigned to them
+        void fillClusters(const std::vector<int> &clusterOfTriangle, GLuint numOfClusters);
+
+        // returns the grid cell containing the point or -1
+        int getGridCell(const AVector &point, bool clamp);
+
+        // estimates the size of the clusters on the screen
+        void computeClusterPixels(bool visibleOnly);
+
+        // size of the drawn triangles with the texture on the screen
+        int getTexturePixels(GLuint texture);
+
+        // computes one row of the PVS
+        void computePVSRow(int cell, int samples);
+
+        // adds the rows of the neighbouring cells to every row of the PVS
+        void dilatePVS();
+
+        // tests if the segment is blocked by triangles of other clusters
+        bool segmentBlocked(const AVector &a, const AVector &b, GLuint ignoredCluster);
+
+        // job building the rows of the PVS
+        static void pvsJob(int begin, int end, void *data);
+
+        // saves and loads the PVS section of the level file
+        void savePVS(std::ofstream &file);
+        bool loadPVS(std::ifstream &file);
+
+        // returns texture coordinates as they are in the level file
+        void unmapTexCoord(GLuint texture, const double *texCoord, double *result);
+
+        // sends one triangle to OpenGL
+        inline void renderTriangle(GLuint t);
+
         // create lists of triangles according to the textures
         bool createLists();
 
@@ -177,6 +281,13 @@ class ALevel : public Level
          *  5    1.5   -5        5   0
          *  0     -1    0
          * @endcode
+         * @n
+         * The file can end with the potentially visible set written by
+         * ALevel::save after ALevel::buildPVS (section starting with the
+         * word 'pvs'). It contains the grid of clusters, cluster of every
+         * triangle and one hexadecimal row of visible clusters for every
+         * cell of the grid. Files without it are still loaded, the level is
+         * then only frustum culled.
          *
          * @param filename Filename of the level
          * @param texturePath Path to the directory containing level textures
@@ -191,7 +302,8 @@ class ALevel : public Level
 
         /**
          * Saves the level.
-         * This method saves the level to the file.
+         * This method saves the level to the file. The potentially visible
+         * set is saved too if it is built.
          * @param filename Filename to save the level to
          * @throw AWriteFileException
          * @see load
@@ -204,6 +316,162 @@ class ALevel : public Level
          */
         void render();
 
+        /**
+         * Renderes the visible part of the level.
+         * This method renderes only the clusters of triangles whose bounding
+         * boxes are inside the view frustum. Clusters are created
+         * automatically when they are needed for the first time.
+         * If the potentially visible set is built (see ALevel::buildPVS) and
+         * enabled (see ALevel::setPVSEnabled) the clusters that can't be seen
+         * from the cell containing the camera are skipped too.
+         * Clusters inside the frustum can be tested against the software
+         * occlusion buffer too, it must be already rasterized for this frame.
+         * @param frustum View frustum (see ACamera::getFrustum)
+         * @param occlusion Occlusion buffer or NULL
+         * @see getDrawnClusters
+         * @see getCulledClusters
+         * @see getOccludedClusters
+         * @see setClusterSize
+         */
+        void render(const AFrustum &frustum, AOcclusionBuffer *occlusion = NULL);
+
+        /**
+         * Returns the occluders of the level.
+         * This method returns big triangles of the level that are good
+         * occluders for AOcclusionBuffer. Small triangles are skipped, they
+         * would cost more than they hide.
+         * @param occluders Vector the vertices are added to (three for every
+         *                  triangle)
+         * @param minArea Minimal area of the occluder triangle
+         */
+        void getOccluders(std::vector<AVector> &occluders, double minArea);
+
+        /**
+         * Sets the size of the clusters.
+         * This method sets the edge length of the cubes the level is split
+         * into for culling. By default (size 0) the size is chosen so that
+         * one cluster contains about 256 triangles.
+         * @param size Edge length of the cluster or 0 for automatic size
+         * @see render
+         */
+        void setClusterSize(double size) { clusterSize = size; clustersValid = false; }
+
+        /**
+         * Builds the potentially visible set.
+         * This method computes which clusters can be seen from every cell of
+         * the cluster grid. Rays are cast from a regular pattern of points
+         * in the cell and from its corners to the centres and corners of all
+         * triangles of the other clusters (both sides, the triangles aren't
+         * culled), then every cell gets the clusters seen from its 26
+         * neighbours. The set is still sampled, a cluster seen only through
+         * a gap smaller than the spacing of the rays from all of these cells
+         * can be culled by ALevel::render; more samples make it less likely
+         * and ALevel::setPVSEnabled turns the set off. The cells are
+         * the jobs of AJobSystem. The job system isn't started here, the
+         * application calls AJobSystem::init, otherwise the set is computed
+         * by the calling thread. Every row is computed by one job with the
+         * same samples, so the result is always the same. This takes a
+         * long time, build it once and save it with the level (ALevel::save).
+         * Any change of the triangles drops the set.
+         * @param threads More than 1 to compute the cells as the jobs of
+         *                AJobSystem, 1 computes the set in the calling thread
+         * @param samples Samples per axis of the cell (samples^3 points in
+         *                the cell and its corners)
+         * @see isPVSBuilt
+         * @see setPVSEnabled
+         */
+        void buildPVS(int threads = 4, int samples = 3);
+
+        /**
+         * Returns true if the potentially visible set is built.
+         * @return True if the PVS can be used by ALevel::render
+         */
+        bool isPVSBuilt() { return clustersValid && !pvs.empty(); }
+
+        /**
+         * Turns the use of the potentially visible set on or off.
+         * When it is turned off ALevel::render draws every cluster in the
+         * frustum, the set stays built and is still saved with the level.
+         * It is turned on by default.
+         * @param enabled True to cull the clusters with the PVS
+         * @see buildPVS
+         */
+        void setPVSEnabled(bool enabled) { pvsEnabled = enabled; }
+
+        /**
+         * Returns true if the potentially visible set is used.
+         * @return True if ALevel::render culls with the PVS when it is built
+         */
+        bool isPVSEnabled() { return pvsEnabled; }
+
+        /**
+         * Tests if the cluster is in the potentially visible set.
+         * @param point Position of the viewer
+         * @param cluster Index of the cluster
+         * @return True if the cluster may be seen from the point (always
+         *         true without the PVS or outside the grid)
+         */
+        bool isClusterPotentiallyVisible(const AVector &point, GLuint cluster);
+
+        /**
+         * Adds the level textures to the atlas.
+         * Only textures with all texture coordinates from 0 to 1 are added,
+         * repeated textures and textures too big for the page stay in their
+         * own textures. The atlas is used by ALevel::useAtlas after
+         * AAtlas::build. Images of other objects can share the atlas.
+         * @param atlas Atlas which isn't built yet
+         * @param texturePath Path to the directory containing level textures
+         * @return Pointer to this instance
+         * @see useAtlas
+         * @throw ANullPointerException
+         */
+        ALevel *addToAtlas(AAtlas *atlas, char *texturePath);
+
+        /**
+         * Uses the atlas given to ALevel::addToAtlas.
+         * Own textures of the atlas textures are freed and the texture
+         * coordinates of the triangles are moved to the atlas pages.
+         * Textures sharing a page are drawn by one draw call.
+         * ALevel::save still writes the original coordinates. The atlas
+         * must exist as long as the level uses it.
+         * @return Pointer to this instance
+         * @see addToAtlas
+         * @throw ATextureException
+         */
+        ALevel *useAtlas();
+
+        /**
+         * Returns the number of clusters.
+         * @return Number of clusters of the level
+         */
+        GLuint getNumOfClusters() { if(!clustersValid) createClusters(); return clusters.size(); }
+
+        /**
+         * Returns the number of drawn clusters.
+         * @return Number of clusters drawn by the last ALevel::render call
+         */
+        GLuint getDrawnClusters()  { return drawnClusters; }
+
+        /**
+         * Returns the number of culled clusters.
+         * @return Number of clusters skipped by the last ALevel::render call
+         */
+        GLuint getCulledClusters() { return culledClusters; }
+
+        /**
+         * Returns the number of occluded clusters.
+         * @return Number of clusters inside the frustum hidden by the
+         *         occluders in the last ALevel::render call (they are
+         *         counted in the culled clusters too)
+         */
+        GLuint getOccludedClusters() { return occludedClusters; }
+
+        /**
+         * Returns the number of drawn triangles.
+         * @return Number of triangles drawn by the last ALevel::render call
+         */
+        GLuint getDrawnTriangles() { return drawnTriangles; }
+
         /**
          * Destroys the level.
          * This method destroys the level and frees the memory.
@@ -331,6 +599,42 @@ ALevel::~ALevel()
     this->destroy();
 }
 
+//-----------------------------------------------------------------------------
+//  sends one triangle to OpenGL
+//-----------------------------------------------------------------------------
+
+void ALevel::renderTriangle(GLuint t)
+{
+    double v[3];
+
+    // nastaveni normaly
+    v[0] = this->triangles[t].normal.x;
+    v[1] = this->triangles[t].normal.y;
+    v[2] = this->triangles[t].normal.z;
+    glNormal3dv(v);
+
+    // nastaveni a vykresleni bodu A
+    glTexCoord2dv(this->triangles[t].texCoordA);
+    v[0] = this->triangles[t].a.x;
+    v[1] = this->triangles[t].a.y;
+    v[2] = this->triangles[t].a.z;
+    glVertex3dv(v);
+
+    // nastaveni a vykresleni bodu B
+    glTexCoord2dv(this->triangles[t].texCoordB);
+    v[0] = this->triangles[t].b.x;
+    v[1] = this->triangles[t].b.y;
+    v[2] = this->triangles[t].b.z;
+    glVertex3dv(v);
+
+    // nastaveni a vykresleni bodu C
+    glTexCoord2dv(this->triangles[t].texCoordC);
+    v[0] = this->triangles[t].c.x;
+    v[1] = this->triangles[t].c.y;
+    v[2] = this->triangles[t].c.z;
+    glVertex3dv(v);
+}
+
 } // namespace astral3d
 
 #endif // #ifndef ALEVEL_H
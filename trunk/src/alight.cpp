@@ -52,27 +52,25 @@ void ALight::render(double radius)
     gluQuadricNormals(quadratic, GLU_SMOOTH);
     gluQuadricTexture(quadratic, GL_FALSE);
 
-    GLboolean blending;
-    GLboolean textures;
-    GLboolean lights;
+    // the cache knows the states so we don't have to ask OpenGL
+    bool blending = ARenderState::isEnabled(GL_BLEND);
+    bool textures = ARenderState::isEnabled(GL_TEXTURE_2D);
+    bool lights = ARenderState::isEnabled(GL_LIGHTING);
 
-    glGetBooleanv(GL_BLEND, &blending);
-    glGetBooleanv(GL_LIGHTING, &lights);
-    glGetBooleanv(GL_TEXTURE_2D, &textures);
-
-    glDisable(GL_BLEND);
-    glDisable(GL_LIGHTING);
-    glDisable(GL_TEXTURE_2D);
+    ARenderState::disable(GL_BLEND);
+    ARenderState::disable(GL_LIGHTING);
+    ARenderState::disable(GL_TEXTURE_2D);
 
     glColor3f(diffuse[0], diffuse[1], diffuse[2]);
 
     glTranslatef(position[0], position[1], position[2]);
+    ARenderState::countDrawCall();
     gluSphere(quadratic, (float) radius, 32, 32);
     glTranslatef(-position[0], -position[1], -position[2]);
 
-    if (blending) glEnable(GL_BLEND);
-    if (textures) glEnable(GL_TEXTURE_2D);
-    if (lights) glEnable(GL_LIGHTING);
+    ARenderState::setEnabled(GL_BLEND, blending);
+    ARenderState::setEnabled(GL_TEXTURE_2D, textures);
+    ARenderState::setEnabled(GL_LIGHTING, lights);
 
     glColor3f(1.0f, 1.0f, 1.0f);
 
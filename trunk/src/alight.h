@@ -33,6 +33,7 @@
 #include <sstream>
 
 #include "avector.h"
+#include "arenderstate.h"
 
 /**
  * @namespace astral3d Astral3D namespace.
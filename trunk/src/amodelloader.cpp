@@ -0,0 +1,207 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+
+#include "amodelloader.h"
+
+using namespace std;
+namespace astral3d {
+
+vector<AModelLoader::Request *> AModelLoader::requests;
+
+//-----------------------------------------------------------------------------
+// job parsing the file
+//-----------------------------------------------------------------------------
+
+void AModelLoader::parseJob(void *data)
+{
+    Request *request = (Request *) data;
+
+    vector<char> filename(request->filename.begin(), request->filename.end());
+    filename.push_back('\0');
+
+    A3DSLoader loader;
+    request->parsed = loader.load3DSModel(request->data, &filename[0]);
+    if(!request->parsed)
+        request->error = loader.getError();
+}
+
+//-----------------------------------------------------------------------------
+// finds the request of the model
+//-----------------------------------------------------------------------------
+
+int AModelLoader::find(A3DSModel *model)
+{
+    for(unsigned int i = 0; i < requests.size(); i++)
+    {
+        if(requests[i]->model == model)
+            return i;
+    }
+
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+// frees the request
+//-----------------------------------------------------------------------------
+
+void AModelLoader::destroy(Request *request)
+{
+    // the jobs use the geometry and the texture identifiers of the model
+    AJobSystem::wait(&request->group);
+    request->textures.clear();
+
+    if(request->data)
+    {
+        A3DSModel::destroyModel(request->data);
+        request->data = NULL;
+    }
+
+    delete request;
+}
+
+//-----------------------------------------------------------------------------
+// moves the request on
+//-----------------------------------------------------------------------------
+
+bool AModelLoader::process(Request *request, bool wait)
+{
+    A3DSModel *model = request->model;
+
+    // textures are known when the file is parsed
+    if(!request->decoding)
+    {
+        if(!wait && !request->group.isDone())
+            return false;
+
+        AJobSystem::wait(&request->group);
+
+        if(!request->parsed)
+        {
+            setAstral3DError(request->error.errorDescription, request->error.senderFunction,
+                             request->error.failedFunction);
+            return true;
+        }
+
+        model->addTextures(request->data, request->texturePath.c_str(), &request->textures);
+        request->textures.start();
+        request->decoding = true;
+    }
+
+    if(!wait && !request->textures.isDecoded())
+        return false;
+
+    if(!request->textures.finish())
+    {
+        model->destroyTextures();
+        return true;
+    }
+
+    // the model owns the geometry from now on
+    model->create(request->data, request->texturePath.c_str());
+    request->data = NULL;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// starts loading of the model
+//-----------------------------------------------------------------------------
+
+bool AModelLoader::load(A3DSModel *model, const char *filename, const char *texturePath)
+{
+    if(!model || !filename)
+    {
+        stringstream foo;
+        foo << "AModelLoader::load("<<model<<", "<<(filename ? filename : "NULL")<<", "
+            <<(texturePath ? texturePath : "NULL")<<")";
+        setAstral3DError("The model or the filename is NULL", foo.str(), "");
+        return false;
+    }
+
+    // cancels the previous loading too
+    model->destroy();
+
+    Request *request = new Request;
+    request->model = model;
+    request->filename = filename;
+    request->texturePath = texturePath ? texturePath : "";
+    request->data = new A3DModel;
+    request->parsed = false;
+    request->decoding = false;
+    requests.push_back(request);
+
+    AJobSystem::submit(parseJob, request, &request->group);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// creates the parsed models
+//-----------------------------------------------------------------------------
+
+void AModelLoader::update()
+{
+    for(unsigned int i = 0; i < requests.size(); )
+    {
+        if(!process(requests[i], false))
+        {
+            i++;
+            continue;
+        }
+
+        destroy(requests[i]);
+        requests.erase(requests.begin() + i);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// finishes loading of the model
+//-----------------------------------------------------------------------------
+
+bool AModelLoader::wait(A3DSModel *model)
+{
+    int index = find(model);
+    if(index < 0)
+        return model && model->isLoaded();
+
+    Request *request = requests[index];
+    requests.erase(requests.begin() + index);
+
+    process(request, true);
+    destroy(request);
+
+    return model->isLoaded();
+}
+
+//-----------------------------------------------------------------------------
+// cancels loading of the model
+//-----------------------------------------------------------------------------
+
+void AModelLoader::cancel(A3DSModel *model)
+{
+    int index = find(model);
+    if(index < 0)
+        return;
+
+    Request *request = requests[index];
+    requests.erase(requests.begin() + index);
+
+    destroy(request);
+}
+
+} // namespace astral3d
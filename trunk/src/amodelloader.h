@@ -0,0 +1,160 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+
+/**
+ * @file amodelloader.h AModelLoader class.
+ */
+#ifndef AMODELLOADER_H
+#define AMODELLOADER_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <string>
+#include <vector>
+
+#include "a3ds.h"
+#include "a3dsmodel.h"
+#include "atextureloader.h"
+#include "ajobsystem.h"
+#include "aerror.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Asynchronous loader of 3DS models.
+ * AModelLoader::load returns at once, the model is the handle of the
+ * loading. The file is parsed and the normals computed by a job of
+ * AJobSystem, then the textures of the model are decoded by the jobs of
+ * ATextureLoader. AModelLoader::update, called once per frame by AWindow,
+ * creates the textures and the buffers of the finished models on the
+ * OpenGL thread. Any number of models can be loading at once. Without the
+ * job system the file is parsed by AModelLoader::load and the textures
+ * are decoded by AModelLoader::update.
+ * @n
+ * @n
+ * The model can be rendered before it is loaded, it draws nothing.
+ * A model which isn't loaded and isn't pending has failed, the error is
+ * set by AModelLoader::update (see getAstral3DError).
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * A3DSModel ship, station;
+ * AModelLoader::load(&ship, "ship.3ds", "textures/");
+ * AModelLoader::load(&station, "station.3ds", "textures/");
+ * ...
+ * // in the frame, AWindow calls AModelLoader::update after the swap
+ * if(ship.isLoaded())
+ *     ship.render();
+ * ...
+ * // or the model is needed right now
+ * if(!AModelLoader::wait(&station))
+ *     cerr << getAstral3DError();
+ * @endcode
+ */
+class AModelLoader
+{
+    private:
+        struct Request
+        {
+            A3DSModel *model;
+            std::string filename;
+            std::string texturePath;
+            A3DModel *data;             // geometry parsed by the job
+            AError error;               // failure of the parsing
+            bool parsed;
+            AJobGroup group;
+            ATextureLoader textures;
+            bool decoding;              // textures of the model are started
+        };
+
+        static std::vector<Request *> requests;
+
+        // parses the file (job of AJobSystem)
+        static void parseJob(void *data);
+
+        // returns the index of the request of the model or -1
+        static int find(A3DSModel *model);
+
+        // moves the request on, true if it is finished (loaded or failed),
+        // if wait is true the jobs are waited for
+        static bool process(Request *request, bool wait);
+
+        // frees the request and its geometry
+        static void destroy(Request *request);
+
+    public:
+        /**
+         * Starts loading of the model.
+         * The loaded model is destroyed first. Must be called from the
+         * OpenGL thread.
+         * @param model Model to load, it mustn't be deleted before it is
+         *              loaded (A3DSModel::destroy cancels the loading)
+         * @param filename Filename of the 3DS model
+         * @param texturePath Path to the directory containing model textures
+         * @return False if the model is NULL
+         */
+        static bool load(A3DSModel *model, const char *filename, const char *texturePath);
+
+        /**
+         * Creates the textures and the buffers of the parsed models.
+         * AWindow calls this method once per frame.
+         */
+        static void update();
+
+        /**
+         * Finishes loading of the model.
+         * The calling thread helps with the jobs while it waits.
+         * @param model Model
+         * @return True if the model is loaded, otherwise the error is set
+         *         (see getAstral3DError)
+         */
+        static bool wait(A3DSModel *model);
+
+        /**
+         * Cancels loading of the model.
+         * Waits for the running jobs of the model, nothing is created.
+         * @param model Model
+         */
+        static void cancel(A3DSModel *model);
+
+        /**
+         * Tests if the model is loading.
+         * @param model Model
+         * @return True if the model is waiting for AModelLoader::update
+         */
+        static bool isPending(A3DSModel *model) { return find(model) >= 0; }
+
+        /**
+         * Returns the number of loading models.
+         * @return Number of models
+         */
+        static int getPendingCount() { return requests.size(); }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef AMODELLOADER_H
@@ -0,0 +1,440 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "aocclusion.h"
+
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+AOcclusionBuffer::AOcclusionBuffer(int width, int height, int threads)
+{
+    testedBoxes = 0;
+    occludedBoxes = 0;
+
+    for(int i = 0; i < 16; i++)
+        matrix[i] = (i % 5 == 0) ? 1.0 : 0.0;
+
+    setSize(width, height);
+    setThreads(threads);
+}
+
+//-----------------------------------------------------------------------------
+// sets the size of the buffer
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::setSize(int width, int height)
+{
+    if(width < 4)
+        width = 4;
+    if(height < 1)
+        height = 1;
+
+    // four pixels are processed at once
+    this->width = (width + 3) & ~3;
+    this->height = height;
+
+    tilesX = (this->width + TILE_WIDTH - 1) / TILE_WIDTH;
+    tilesY = (this->height + TILE_HEIGHT - 1) / TILE_HEIGHT;
+
+    depth.assign(this->width * this->height, 1.0f);
+    bins.assign(tilesX * tilesY, vector<int>());
+}
+
+//-----------------------------------------------------------------------------
+// sets the number of threads
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::setThreads(int threads)
+{
+    // the application starts the job system, without it the tiles are
+    // rasterized by the calling thread
+    this->threads = threads > 1 ? threads : 1;
+}
+
+//-----------------------------------------------------------------------------
+// clears the buffer
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::begin(const double viewProjection[16])
+{
+    for(int i = 0; i < 16; i++)
+        matrix[i] = viewProjection[i];
+
+    occluders.clear();
+    depth.assign(width * height, 1.0f);
+
+    testedBoxes = 0;
+    occludedBoxes = 0;
+}
+
+//-----------------------------------------------------------------------------
+// adds the occluder
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::addOccluder(const AVector &a, const AVector &b, const AVector &c)
+{
+    const AVector *v[3] = { &a, &b, &c };
+    double clip[4][4];
+    int count = 0;
+
+    double in[3][4];
+    for(int i = 0; i < 3; i++)
+    {
+        in[i][0] = matrix[0] * v[i]->x + matrix[4] * v[i]->y + matrix[8]  * v[i]->z + matrix[12];
+        in[i][1] = matrix[1] * v[i]->x + matrix[5] * v[i]->y + matrix[9]  * v[i]->z + matrix[13];
+        in[i][2] = matrix[2] * v[i]->x + matrix[6] * v[i]->y + matrix[10] * v[i]->z + matrix[14];
+        in[i][3] = matrix[3] * v[i]->x + matrix[7] * v[i]->y + matrix[11] * v[i]->z + matrix[15];
+    }
+
+    // clipping by the near plane (z + w >= 0), one triangle can become a quad
+    for(int i = 0; i < 3; i++)
+    {
+        const double *p = in[i];
+        const double *q = in[(i + 1) % 3];
+
+        double dp = p[2] + p[3];
+        double dq = q[2] + q[3];
+
+        if(dp >= 0.0)
+        {
+            for(int k = 0; k < 4; k++)
+                clip[count][k] = p[k];
+            count++;
+        }
+
+        if((dp >= 0.0) != (dq >= 0.0))
+        {
+            double t = dp / (dp - dq);
+            for(int k = 0; k < 4; k++)
+                clip[count][k] = p[k] + (q[k] - p[k]) * t;
+            count++;
+        }
+    }
+
+    if(count >= 3)
+        addClipTriangle(clip[0], clip[1], clip[2]);
+    if(count == 4)
+        addClipTriangle(clip[0], clip[2], clip[3]);
+}
+
+//-----------------------------------------------------------------------------
+// projects the clipped triangle to the screen
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::addClipTriangle(const double *a, const double *b, const double *c)
+{
+    const double *v[3] = { a, b, c };
+    AOccluderTriangle tri;
+
+    for(int i = 0; i < 3; i++)
+    {
+        double w = v[i][3];
+        if(w < 1e-9)
+            return;
+
+        tri.x[i] = (float) ((v[i][0] / w * 0.5 + 0.5) * width);
+        tri.y[i] = (float) ((v[i][1] / w * 0.5 + 0.5) * height);
+        tri.z[i] = (float) (v[i][2] / w * 0.5 + 0.5);
+    }
+
+    occluders.push_back(tri);
+}
+
+//-----------------------------------------------------------------------------
+// adds the occluders
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::addOccluders(const vector<AVector> &triangles)
+{
+    for(unsigned int i = 0; i + 2 < triangles.size(); i += 3)
+        addOccluder(triangles[i], triangles[i + 1], triangles[i + 2]);
+}
+
+//-----------------------------------------------------------------------------
+// sorts the triangles into the tiles and rasterizes them
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::rasterize()
+{
+    APROFILE("occlusion");
+
+    for(unsigned int i = 0; i < bins.size(); i++)
+        bins[i].clear();
+
+    for(unsigned int t = 0; t < occluders.size(); t++)
+    {
+        const AOccluderTriangle &tri = occluders[t];
+
+        float minX = min(tri.x[0], min(tri.x[1], tri.x[2]));
+        float maxX = max(tri.x[0], max(tri.x[1], tri.x[2]));
+        float minY = min(tri.y[0], min(tri.y[1], tri.y[2]));
+        float maxY = max(tri.y[0], max(tri.y[1], tri.y[2]));
+
+        if(maxX < 0.0f || maxY < 0.0f || minX >= width || minY >= height)
+            continue;
+
+        int x0 = max(0, (int) minX / TILE_WIDTH);
+        int x1 = min(tilesX - 1, (int) maxX / TILE_WIDTH);
+        int y0 = max(0, (int) minY / TILE_HEIGHT);
+        int y1 = min(tilesY - 1, (int) maxY / TILE_HEIGHT);
+
+        for(int y = y0; y <= y1; y++)
+            for(int x = x0; x <= x1; x++)
+                bins[y * tilesX + x].push_back(t);
+    }
+
+    // tiles don't overlap so the threads never write the same pixel
+    if(threads <= 1)
+    {
+        for(unsigned int i = 0; i < bins.size(); i++)
+            rasterizeTile(i);
+        return;
+    }
+
+    AJobSystem::parallelFor(0, bins.size(), rasterizeTiles, this, 1);
+}
+
+//-----------------------------------------------------------------------------
+// rasterizes the range of tiles
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::rasterizeTiles(int begin, int end, void *data)
+{
+    AOcclusionBuffer *buffer = (AOcclusionBuffer *) data;
+
+    for(int tile = begin; tile < end; tile++)
+        buffer->rasterizeTile(tile);
+}
+
+//-----------------------------------------------------------------------------
+// rasterizes the triangles of the tile
+//-----------------------------------------------------------------------------
+
+void AOcclusionBuffer::rasterizeTile(int tile)
+{
+    int tileX0 = (tile % tilesX) * TILE_WIDTH;
+    int tileY0 = (tile / tilesX) * TILE_HEIGHT;
+    int tileX1 = min(tileX0 + TILE_WIDTH, width);
+    int tileY1 = min(tileY0 + TILE_HEIGHT, height);
+
+    const vector<int> &bin = bins[tile];
+
+    for(unsigned int t = 0; t < bin.size(); t++)
+    {
+        const AOccluderTriangle &tri = occluders[bin[t]];
+
+        int i1 = 1, i2 = 2;
+
+        float area = (tri.x[1] - tri.x[0]) * (tri.y[2] - tri.y[0]) -
+                     (tri.x[2] - tri.x[0]) * (tri.y[1] - tri.y[0]);
+
+        if(fabs(area) < 1e-6f)
+            continue;
+
+        // both sides occlude, we only need the counter-clockwise order
+        if(area < 0.0f)
+        {
+            i1 = 2;
+            i2 = 1;
+            area = -area;
+        }
+
+        float x[3] = { tri.x[0], tri.x[i1], tri.x[i2] };
+        float y[3] = { tri.y[0], tri.y[i1], tri.y[i2] };
+        float z[3] = { tri.z[0], tri.z[i1], tri.z[i2] };
+
+        // edge functions e = A*x + B*y + C, edge i is opposite to vertex i
+        float A[3], B[3], C[3];
+        for(int i = 0; i < 3; i++)
+        {
+            int a = (i + 1) % 3;
+            int b = (i + 2) % 3;
+
+            A[i] = -(y[b] - y[a]);
+            B[i] = x[b] - x[a];
+            C[i] = -A[i] * x[a] - B[i] * y[a];
+        }
+
+        // depth is linear in the screen space
+        float zA = (A[0] * z[0] + A[1] * z[1] + A[2] * z[2]) / area;
+        float zB = (B[0] * z[0] + B[1] * z[1] + B[2] * z[2]) / area;
+        float zC = (C[0] * z[0] + C[1] * z[1] + C[2] * z[2]) / area;
+
+        int minX = max(tileX0, (int) floor(min(x[0], min(x[1], x[2]))));
+        int maxX = min(tileX1, (int) ceil(max(x[0], max(x[1], x[2]))));
+        int minY = max(tileY0, (int) floor(min(y[0], min(y[1], y[2]))));
+        int maxY = min(tileY1, (int) ceil(max(y[0], max(y[1], y[2]))));
+
+        // groups of four pixels never cross the tile
+        minX &= ~3;
+
+        for(int py = minY; py < maxY; py++)
+        {
+            float cy = py + 0.5f;
+            float *row = &depth[py * width];
+
+#ifdef __SSE2__
+            __m128 offset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+            __m128 e0step = _mm_set1_ps(A[0] * 4.0f);
+            __m128 e1step = _mm_set1_ps(A[1] * 4.0f);
+            __m128 e2step = _mm_set1_ps(A[2] * 4.0f);
+            __m128 zstep  = _mm_set1_ps(zA * 4.0f);
+
+            __m128 px = _mm_add_ps(_mm_set1_ps((float) minX), offset);
+            __m128 e0 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[0]), px), _mm_set1_ps(B[0] * cy + C[0]));
+            __m128 e1 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[1]), px), _mm_set1_ps(B[1] * cy + C[1]));
+            __m128 e2 = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(A[2]), px), _mm_set1_ps(B[2] * cy + C[2]));
+            __m128 pz = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(zA), px), _mm_set1_ps(zB * cy + zC));
+            __m128 zero = _mm_setzero_ps();
+
+            for(int px4 = minX; px4 < maxX; px4 += 4)
+            {
+                __m128 inside = _mm_and_ps(_mm_cmpge_ps(e0, zero),
+                                _mm_and_ps(_mm_cmpge_ps(e1, zero), _mm_cmpge_ps(e2, zero)));
+
+                if(_mm_movemask_ps(inside))
+                {
+                    __m128 old = _mm_loadu_ps(&row[px4]);
+                    __m128 nearer = _mm_min_ps(old, pz);
+                    _mm_storeu_ps(&row[px4], _mm_or_ps(_mm_and_ps(inside, nearer),
+                                                       _mm_andnot_ps(inside, old)));
+                }
+
+                e0 = _mm_add_ps(e0, e0step);
+                e1 = _mm_add_ps(e1, e1step);
+                e2 = _mm_add_ps(e2, e2step);
+                pz = _mm_add_ps(pz, zstep);
+            }
+#else
+            for(int px = minX; px < maxX; px++)
+            {
+                float cx = px + 0.5f;
+
+                if(A[0] * cx + B[0] * cy + C[0] < 0.0f ||
+                   A[1] * cx + B[1] * cy + C[1] < 0.0f ||
+                   A[2] * cx + B[2] * cy + C[2] < 0.0f)
+                    continue;
+
+                float pz = zA * cx + zB * cy + zC;
+                if(pz < row[px])
+                    row[px] = pz;
+            }
+#endif
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// tests the box
+//-----------------------------------------------------------------------------
+
+bool AOcclusionBuffer::testBox(const AVector &min, const AVector &max)
+{
+    testedBoxes++;
+
+    float minX = 1e30f, maxX = -1e30f;
+    float minY = 1e30f, maxY = -1e30f;
+    float minZ = 1e30f;
+
+    for(int i = 0; i < 8; i++)
+    {
+        double x = (i & 1) ? max.x : min.x;
+        double y = (i & 2) ? max.y : min.y;
+        double z = (i & 4) ? max.z : min.z;
+
+        double cx = matrix[0] * x + matrix[4] * y + matrix[8]  * z + matrix[12];
+        double cy = matrix[1] * x + matrix[5] * y + matrix[9]  * z + matrix[13];
+        double cz = matrix[2] * x + matrix[6] * y + matrix[10] * z + matrix[14];
+        double cw = matrix[3] * x + matrix[7] * y + matrix[11] * z + matrix[15];
+
+        // the box crosses the near plane, we can't say anything
+        if(cz + cw < 0.0 || cw < 1e-9)
+            return true;
+
+        float sx = (float) ((cx / cw * 0.5 + 0.5) * width);
+        float sy = (float) ((cy / cw * 0.5 + 0.5) * height);
+        float sz = (float) (cz / cw * 0.5 + 0.5);
+
+        if(sx < minX) minX = sx;
+        if(sx > maxX) maxX = sx;
+        if(sy < minY) minY = sy;
+        if(sy > maxY) maxY = sy;
+        if(sz < minZ) minZ = sz;
+    }
+
+    int x0 = std::max(0, (int) floor(minX));
+    int x1 = std::min(width, (int) ceil(maxX));
+    int y0 = std::max(0, (int) floor(minY));
+    int y1 = std::min(height, (int) ceil(maxY));
+
+    // out of the screen
+    if(x0 >= x1 || y0 >= y1)
+    {
+        occludedBoxes++;
+        return false;
+    }
+
+    if(minZ > 1.0f)
+        minZ = 1.0f;
+
+    // visible if any pixel has no occluder in front of the box
+    for(int y = y0; y < y1; y++)
+    {
+        const float *row = &depth[y * width];
+        int x = x0;
+
+#ifdef __SSE2__
+        __m128 boxDepth = _mm_set1_ps(minZ);
+        for(; x + 4 <= x1; x += 4)
+        {
+            if(_mm_movemask_ps(_mm_cmpge_ps(_mm_loadu_ps(&row[x]), boxDepth)))
+                return true;
+        }
+#endif
+
+        for(; x < x1; x++)
+        {
+            if(row[x] >= minZ)
+                return true;
+        }
+    }
+
+    occludedBoxes++;
+    return false;
+}
+
+//-----------------------------------------------------------------------------
+// tests the sphere
+//-----------------------------------------------------------------------------
+
+bool AOcclusionBuffer::testSphere(const AVector &center, double radius)
+{
+    AVector r(radius, radius, radius);
+    return testBox(center - r, center + r);
+}
+
+} // namespace astral3d
@@ -0,0 +1,244 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file aocclusion.h AOcclusionBuffer class.
+ */
+#ifndef AOCCLUSION_H
+#define AOCCLUSION_H
+
+#ifdef WIN32
+    #include <windows.h>
+    #include <SDL.h>
+    #include <SDL_thread.h>
+#else
+    #include "SDL.h"
+    #include "SDL_thread.h"
+#endif
+
+#include <vector>
+#include <cmath>
+
+#include "avector.h"
+#include "afrustum.h"
+#include "aprofiler.h"
+#include "ajobsystem.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Occluder triangle projected to the screen of the occlusion buffer.
+ */
+struct AOccluderTriangle
+{
+    float x[3];     // screen coordinates in pixels
+    float y[3];
+    float z[3];     // depth in <0, 1>
+};
+
+/**
+ * Software occlusion buffer.
+ * This class rasterizes big occluder triangles into a small depth buffer
+ * on the CPU and tests bounding boxes against it, so objects hidden behind
+ * walls or terrain don't have to be sent to OpenGL at all. It doesn't use
+ * OpenGL so it can be used without a window.
+ * @n
+ * @n
+ * The buffer is split into tiles that are rasterized in parallel as the
+ * jobs of AJobSystem. Inner loops work on four pixels at once with SSE2 when the
+ * compiler supports it.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * AJobSystem::init();
+ * AOcclusionBuffer occlusion(256, 128, 2);
+ * std::vector<AVector> occluders;
+ * level.getOccluders(occluders, 20.0);
+ * ...
+ * AFrustum frustum = camera.getFrustum();
+ * occlusion.begin(frustum);
+ * occlusion.addOccluders(occluders);
+ * occlusion.rasterize();
+ * level.render(frustum, &occlusion);
+ * @endcode
+ */
+class AOcclusionBuffer
+{
+    private:
+        int width;                      // size of the buffer (multiple of 4)
+        int height;
+        std::vector<float> depth;       // nearest occluder depth of pixels
+
+        double matrix[16];              // view-projection matrix
+
+        std::vector<AOccluderTriangle> occluders;
+
+        // triangles overlapping the tiles
+        int tilesX, tilesY;
+        std::vector< std::vector<int> > bins;
+
+        int threads;                    // tiles are rasterized in parallel if > 1
+
+        // statistics
+        unsigned int testedBoxes;
+        unsigned int occludedBoxes;
+
+        // adds the triangle in the clip space
+        void addClipTriangle(const double *a, const double *b, const double *c);
+
+        // rasterizes all triangles of one tile
+        void rasterizeTile(int tile);
+
+        // rasterizes the range of tiles (job of AJobSystem::parallelFor)
+        static void rasterizeTiles(int begin, int end, void *data);
+
+    public:
+        /**
+         * Width and height of one tile in pixels.
+         */
+        static const int TILE_WIDTH = 32;
+        static const int TILE_HEIGHT = 16;
+
+        /**
+         * Constructor.
+         * @param width Width of the buffer (rounded up to a multiple of 4)
+         * @param height Height of the buffer
+         * @param threads Number of threads rasterizing the tiles (see
+         *                AOcclusionBuffer::setThreads)
+         */
+        AOcclusionBuffer(int width = 256, int height = 128, int threads = 1);
+
+        /**
+         * Sets the size of the buffer.
+         * @param width Width of the buffer (rounded up to a multiple of 4)
+         * @param height Height of the buffer
+         */
+        void setSize(int width, int height);
+
+        /**
+         * Sets the number of threads.
+         * With more than one thread the tiles are the jobs of AJobSystem.
+         * The job system isn't started here, the application calls
+         * AJobSystem::init, otherwise the tiles are rasterized by the
+         * calling thread.
+         * @param threads More than 1 to rasterize the tiles in parallel
+         */
+        void setThreads(int threads);
+
+        /**
+         * Starts a new frame.
+         * Clears the buffer and removes all occluders.
+         * @param viewProjection Projection matrix multiplied by the view
+         *                       matrix (OpenGL column-major order)
+         */
+        void begin(const double viewProjection[16]);
+
+        /**
+         * Starts a new frame.
+         * @param frustum Frustum of the camera
+         */
+        void begin(const AFrustum &frustum) { begin(frustum.getMatrix()); }
+
+        /**
+         * Adds the occluder triangle.
+         * The triangle is clipped by the near plane and projected. Both sides
+         * of the triangle occlude.
+         * @param a First vertex in the world space
+         * @param b Second vertex in the world space
+         * @param c Third vertex in the world space
+         */
+        void addOccluder(const AVector &a, const AVector &b, const AVector &c);
+
+        /**
+         * Adds the occluder triangles.
+         * @param triangles Three vertices for every triangle
+         * @see ALevel::getOccluders
+         */
+        void addOccluders(const std::vector<AVector> &triangles);
+
+        /**
+         * Rasterizes the occluders.
+         * This method must be called after the occluders are added and
+         * before the tests.
+         */
+        void rasterize();
+
+        /**
+         * Tests the axis aligned box.
+         * @param min Minimal corner of the box in the world space
+         * @param max Maximal corner of the box in the world space
+         * @return False if the box is hidden behind the occluders or is out
+         *         of the screen
+         */
+        bool testBox(const AVector &min, const AVector &max);
+
+        /**
+         * Tests the sphere.
+         * @param center Center of the sphere in the world space
+         * @param radius Radius of the sphere
+         * @return False if the sphere is hidden behind the occluders
+         */
+        bool testSphere(const AVector &center, double radius);
+
+        /**
+         * Returns the depth buffer.
+         * @return Depth of the nearest occluder for every pixel (1.0 is the
+         *         far plane), rows go from the bottom of the screen
+         */
+        const float *getDepth() { return &depth[0]; }
+
+        /**
+         * Returns the width of the buffer.
+         * @return Width in pixels
+         */
+        int getWidth() { return width; }
+
+        /**
+         * Returns the height of the buffer.
+         * @return Height in pixels
+         */
+        int getHeight() { return height; }
+
+        /**
+         * Returns the number of occluder triangles.
+         * @return Number of triangles after the near plane clipping
+         */
+        unsigned int getNumOfOccluders() { return occluders.size(); }
+
+        /**
+         * Returns the number of tests.
+         * @return Number of boxes tested since AOcclusionBuffer::begin
+         */
+        unsigned int getTestedBoxes() { return testedBoxes; }
+
+        /**
+         * Returns the number of occluded boxes.
+         * @return Number of boxes found hidden since AOcclusionBuffer::begin
+         */
+        unsigned int getOccludedBoxes() { return occludedBoxes; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef AOCCLUSION_H
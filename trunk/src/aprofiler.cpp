@@ -0,0 +1,555 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "aprofiler.h"
+#include "atext.h"
+#include "aconsole.h"
+#include "arenderstate.h"
+
+#include <fstream>
+
+#ifndef WIN32
+    #include <sys/time.h>
+#endif
+
+using namespace std;
+namespace astral3d {
+
+bool AProfiler::enabled = false;
+Uint32 AProfiler::thread = 0;
+double AProfiler::epoch = 0.0;
+vector<AProfiler::Frame> AProfiler::frames;
+unsigned int AProfiler::frameNumber = 0;
+bool AProfiler::inFrame = false;
+vector<int> AProfiler::stack;
+GLuint AProfiler::queries[NUM_QUERIES];
+unsigned int AProfiler::queryFrames[NUM_QUERIES];
+bool AProfiler::queryPending[NUM_QUERIES];
+bool AProfiler::queriesCreated = false;
+int AProfiler::runningQuery = -1;
+
+//-----------------------------------------------------------------------------
+// current time
+//-----------------------------------------------------------------------------
+
+double AProfiler::getTime()
+{
+#ifdef WIN32
+    LARGE_INTEGER frequency, counter;
+    QueryPerformanceFrequency(&frequency);
+    QueryPerformanceCounter(&counter);
+    return (double) counter.QuadPart * 1000.0 / (double) frequency.QuadPart;
+#else
+    struct timeval tv;
+    gettimeofday(&tv, NULL);
+    return tv.tv_sec * 1000.0 + tv.tv_usec / 1000.0;
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// setEnabled
+//-----------------------------------------------------------------------------
+
+void AProfiler::setEnabled(bool enabled, int history)
+{
+    if(enabled && !AProfiler::enabled)
+    {
+        frames.clear();
+        frames.resize(history > 0 ? history : 1);
+        for(unsigned int i = 0; i < frames.size(); i++)
+        {
+            frames[i].number = (unsigned int) -1;
+            frames[i].cpuTime = -1.0;
+            frames[i].gpuTime = -1.0;
+        }
+
+        frameNumber = 0;
+        inFrame = false;
+        stack.clear();
+        thread = SDL_ThreadID();
+        epoch = getTime();
+    }
+
+    if(!enabled && AProfiler::enabled)
+    {
+        if(runningQuery >= 0)
+        {
+            aglEndQueryARB(GL_TIME_ELAPSED_EXT);
+            runningQuery = -1;
+        }
+
+        if(queriesCreated)
+        {
+            aglDeleteQueriesARB(NUM_QUERIES, queries);
+            queriesCreated = false;
+        }
+
+        inFrame = false;
+    }
+
+    AProfiler::enabled = enabled;
+}
+
+//-----------------------------------------------------------------------------
+// the OpenGL context was recreated
+//-----------------------------------------------------------------------------
+
+void AProfiler::invalidate()
+{
+    // the queries died with the old context
+    queriesCreated = false;
+    runningQuery = -1;
+}
+
+//-----------------------------------------------------------------------------
+// frame with the given number
+//-----------------------------------------------------------------------------
+
+AProfiler::Frame *AProfiler::getFrame(unsigned int number)
+{
+    if(frames.empty())
+        return NULL;
+
+    Frame *frame = &frames[number % frames.size()];
+    return frame->number == number ? frame : NULL;
+}
+
+//-----------------------------------------------------------------------------
+// finished frame
+//-----------------------------------------------------------------------------
+
+AProfiler::Frame *AProfiler::getFinishedFrame(int age)
+{
+    if(age < 0 || (unsigned int) age >= frameNumber)
+        return NULL;
+
+    return getFrame(frameNumber - 1 - age);
+}
+
+//-----------------------------------------------------------------------------
+// reads the timer query
+//-----------------------------------------------------------------------------
+
+void AProfiler::readQuery(int slot, bool wait)
+{
+    if(!queryPending[slot])
+        return;
+
+    if(!wait)
+    {
+        GLint available = 0;
+        aglGetQueryObjectivARB(queries[slot], GL_QUERY_RESULT_AVAILABLE_ARB, &available);
+        if(!available)
+            return;
+    }
+
+    GLuint64EXT time = 0;
+    aglGetQueryObjectui64vEXT(queries[slot], GL_QUERY_RESULT_ARB, &time);
+    queryPending[slot] = false;
+
+    Frame *frame = getFrame(queryFrames[slot]);
+    if(frame)
+        frame->gpuTime = time / 1000000.0;
+}
+
+//-----------------------------------------------------------------------------
+// beginFrame
+//-----------------------------------------------------------------------------
+
+void AProfiler::beginFrame()
+{
+    if(!enabled)
+        return;
+
+    if(inFrame)
+        endFrame();
+
+    Frame &frame = frames[frameNumber % frames.size()];
+    frame.number = frameNumber;
+    frame.cpuTime = -1.0;
+    frame.gpuTime = -1.0;
+    frame.events.clear();
+    stack.clear();
+    inFrame = true;
+
+    if(isTimerQuerySupported())
+    {
+        if(!queriesCreated)
+        {
+            aglGenQueriesARB(NUM_QUERIES, queries);
+            for(int i = 0; i < NUM_QUERIES; i++)
+                queryPending[i] = false;
+            queriesCreated = true;
+        }
+
+        // results of the older frames which are ready
+        for(int i = 0; i < NUM_QUERIES; i++)
+            readQuery(i, false);
+
+        // the query of this slot is NUM_QUERIES frames old, it is done
+        // almost surely
+        int slot = frameNumber % NUM_QUERIES;
+        readQuery(slot, true);
+
+        aglBeginQueryARB(GL_TIME_ELAPSED_EXT, queries[slot]);
+        queryFrames[slot] = frameNumber;
+        runningQuery = slot;
+    }
+
+    frame.start = getTime();
+}
+
+//-----------------------------------------------------------------------------
+// endFrame
+//-----------------------------------------------------------------------------
+
+void AProfiler::endFrame()
+{
+    if(!enabled || !inFrame)
+        return;
+
+    Frame &frame = frames[frameNumber % frames.size()];
+    double now = getTime() - frame.start;
+
+    // zones left open end with the frame
+    for(unsigned int i = 0; i < stack.size(); i++)
+        frame.events[stack[i]].end = now;
+    stack.clear();
+
+    if(runningQuery >= 0)
+    {
+        aglEndQueryARB(GL_TIME_ELAPSED_EXT);
+        queryPending[runningQuery] = true;
+        runningQuery = -1;
+    }
+
+    frame.cpuTime = now;
+    inFrame = false;
+    frameNumber++;
+}
+
+//-----------------------------------------------------------------------------
+// beginZone of the enabled profiler
+//-----------------------------------------------------------------------------
+
+bool AProfiler::beginZoneRecorded(const char *name)
+{
+    if(!inFrame || SDL_ThreadID() != thread)
+        return false;
+
+    Frame &frame = frames[frameNumber % frames.size()];
+
+    AProfileEvent event;
+    event.name = name;
+    event.depth = stack.size();
+    event.start = getTime() - frame.start;
+    event.end = event.start;
+
+    stack.push_back(frame.events.size());
+    frame.events.push_back(event);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// endZone
+//-----------------------------------------------------------------------------
+
+void AProfiler::endZone()
+{
+    // the frame could end while the zone was open
+    if(!inFrame || stack.empty())
+        return;
+
+    Frame &frame = frames[frameNumber % frames.size()];
+    frame.events[stack.back()].end = getTime() - frame.start;
+    stack.pop_back();
+}
+
+//-----------------------------------------------------------------------------
+// statistics
+//-----------------------------------------------------------------------------
+
+unsigned int AProfiler::getFrameCount()
+{
+    if(frames.empty())
+        return 0;
+
+    // the running frame reuses the slot of the oldest one
+    return min((unsigned int) frames.size() - (inFrame ? 1 : 0), frameNumber);
+}
+
+double AProfiler::getFrameTime(int age)
+{
+    Frame *frame = getFinishedFrame(age);
+    return frame ? frame->cpuTime : -1.0;
+}
+
+double AProfiler::getGPUTime(int age)
+{
+    Frame *frame = getFinishedFrame(age);
+    return frame ? frame->gpuTime : -1.0;
+}
+
+const vector<AProfileEvent> *AProfiler::getEvents(int age)
+{
+    Frame *frame = getFinishedFrame(age);
+    return frame ? &frame->events : NULL;
+}
+
+double AProfiler::getZoneTime(const char *name)
+{
+    unsigned int count = getFrameCount();
+    if(count == 0)
+        return 0.0;
+
+    double total = 0.0;
+    for(unsigned int age = 0; age < count; age++)
+    {
+        Frame *frame = getFinishedFrame(age);
+        if(!frame)
+            continue;
+
+        const vector<AProfileEvent> &events = frame->events;
+        for(unsigned int i = 0; i < events.size(); i++)
+        {
+            if(events[i].name == name || strcmp(events[i].name, name) == 0)
+                total += events[i].end - events[i].start;
+        }
+    }
+
+    return total / count;
+}
+
+//-----------------------------------------------------------------------------
+// drawGraph
+//-----------------------------------------------------------------------------
+
+void AProfiler::drawGraph(AText2D *text, int x, int y, int width, int height, double maxTime)
+{
+    unsigned int count = getFrameCount();
+    if(count == 0 || maxTime <= 0.0)
+        return;
+
+    GLint viewport[4];
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    ARenderState::disable(GL_TEXTURE_2D);
+    ARenderState::disable(GL_LIGHTING);
+    ARenderState::disable(GL_BLEND);
+    ARenderState::polygonMode(GL_FILL);
+    ARenderState::begin2D(viewport[2], viewport[3]);
+
+    ARenderState::countDrawCall();
+    glBegin(GL_QUADS);
+
+    // background
+    glColor3f(0.1f, 0.1f, 0.1f);
+    glVertex2i(x, y);
+    glVertex2i(x + width, y);
+    glVertex2i(x + width, y + height);
+    glVertex2i(x, y + height);
+
+    // the newest frame is on the right
+    double barWidth = (double) width / frames.size();
+    for(unsigned int age = 0; age < count; age++)
+    {
+        Frame *frame = getFinishedFrame(age);
+        if(!frame)
+            continue;
+
+        double right = x + width - age * barWidth;
+        double left = right - barWidth;
+
+        double cpu = min(frame->cpuTime / maxTime, 1.0) * height;
+        glColor3f(0.2f, 0.8f, 0.2f);
+        glVertex2d(left, y);
+        glVertex2d(right, y);
+        glVertex2d(right, y + cpu);
+        glVertex2d(left, y + cpu);
+
+        if(frame->gpuTime >= 0.0)
+        {
+            double gpu = min(frame->gpuTime / maxTime, 1.0) * height;
+            glColor3f(0.9f, 0.3f, 0.2f);
+            glVertex2d(left + barWidth * 0.5, y);
+            glVertex2d(right, y);
+            glVertex2d(right, y + gpu);
+            glVertex2d(left + barWidth * 0.5, y + gpu);
+        }
+    }
+
+    // 60 fps
+    double line = y + min(1000.0 / 60.0 / maxTime, 1.0) * height;
+    glColor3f(1.0f, 1.0f, 0.0f);
+    glVertex2d(x, line);
+    glVertex2d(x + width, line);
+    glVertex2d(x + width, line + 1.0);
+    glVertex2d(x, line + 1.0);
+
+    glEnd();
+
+    ARenderState::end2D();
+
+    if(!text)
+        return;
+
+    glColor3f(1.0f, 1.0f, 1.0f);
+    text->beginBatch();
+
+    // the GPU time is known a few frames later
+    double gpu = -1.0;
+    for(unsigned int age = 0; age < count && gpu < 0.0; age++)
+        gpu = getGPUTime(age);
+
+    int lineY = y - 16;
+    if(gpu >= 0.0)
+        text->print(x, lineY, "cpu %.2f ms  gpu %.2f ms", getFrameTime(0), gpu);
+    else
+        text->print(x, lineY, "cpu %.2f ms", getFrameTime(0));
+
+    // outermost zones of the last frame with their average times
+    Frame *last = getFinishedFrame(0);
+    for(unsigned int i = 0; last && i < last->events.size(); i++)
+    {
+        const AProfileEvent &event = last->events[i];
+        if(event.depth != 0)
+            continue;
+
+        lineY -= 16;
+        text->print(x, lineY, "%-10s %.2f ms", event.name, getZoneTime(event.name));
+    }
+
+    text->endBatch();
+}
+
+//-----------------------------------------------------------------------------
+// print
+//-----------------------------------------------------------------------------
+
+void AProfiler::print(AConsole *console)
+{
+    Frame *last = getFinishedFrame(0);
+    if(!console || !last)
+        return;
+
+    double average = 0.0;
+    unsigned int count = 0;
+    for(unsigned int age = 0; age < getFrameCount(); age++)
+    {
+        Frame *frame = getFinishedFrame(age);
+        if(frame)
+        {
+            average += frame->cpuTime;
+            count++;
+        }
+    }
+    average /= count;
+
+    console->print("frame %.2f ms (%u frames)", average, count);
+
+    for(unsigned int i = 0; i < last->events.size(); i++)
+    {
+        const AProfileEvent &event = last->events[i];
+        if(event.depth == 0)
+            console->print("  %s %.2f ms", event.name, getZoneTime(event.name));
+    }
+}
+
+//-----------------------------------------------------------------------------
+// exportTrace
+//-----------------------------------------------------------------------------
+
+// writes the string as a JSON string
+static void writeName(ofstream &file, const char *name)
+{
+    file << '"';
+    for(const char *c = name; *c; c++)
+    {
+        if(*c == '"' || *c == '\\')
+            file << '\\';
+        if((unsigned char) *c >= 32)
+            file << *c;
+    }
+    file << '"';
+}
+
+// writes one complete event of the trace
+static void writeEvent(ofstream &file, bool &first, const char *name, int tid, double start, double duration)
+{
+    if(!first)
+        file << "," << endl;
+    first = false;
+
+    file << "{\"name\":";
+    writeName(file, name);
+    file << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+         << ",\"ts\":" << start * 1000.0 << ",\"dur\":" << duration * 1000.0 << "}";
+}
+
+bool AProfiler::exportTrace(char *filename)
+{
+    ofstream file;
+    file.open(filename);
+
+    if(!file.is_open())
+    {
+        stringstream foo;
+        stringstream bar;
+        foo << "AProfiler::exportTrace(\""<<filename<<"\")";
+        bar << "ofstream.open(\"" << filename << "\")";
+        setAstral3DError("Can't open file", foo.str(), bar.str());
+        return false;
+    }
+
+    file.setf(ios::fixed);
+    file.precision(3);
+
+    file << "{\"traceEvents\":[" << endl;
+
+    // the oldest frame first, times in microseconds from enabling
+    bool first = true;
+    for(int age = getFrameCount() - 1; age >= 0; age--)
+    {
+        Frame *frame = getFinishedFrame(age);
+        if(!frame)
+            continue;
+
+        double start = frame->start - epoch;
+
+        writeEvent(file, first, "frame", 1, start, frame->cpuTime);
+
+        for(unsigned int i = 0; i < frame->events.size(); i++)
+        {
+            const AProfileEvent &event = frame->events[i];
+            writeEvent(file, first, event.name, 1, start + event.start, event.end - event.start);
+        }
+
+        // only the length of the GPU work is known, not its start
+        if(frame->gpuTime >= 0.0)
+            writeEvent(file, first, "gpu", 2, start, frame->gpuTime);
+    }
+
+    file << endl << "],\"displayTimeUnit\":\"ms\"}" << endl;
+    file.close();
+
+    return true;
+}
+
+} // namespace astral3d
@@ -0,0 +1,304 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file aprofiler.h AProfiler class.
+ */
+#ifndef APROFILER_H
+#define APROFILER_H
+
+#ifdef WIN32
+    #include <windows.h>
+    #include <SDL.h>
+    #include <SDL_thread.h>
+#else
+    #include "SDL.h"
+    #include "SDL_thread.h"
+#endif
+
+#include <vector>
+#include <cstring>
+#include <GL/gl.h>
+
+#include "aextensions.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+class AText2D;
+class AConsole;
+
+/**
+ * Measured zone of the frame.
+ */
+struct AProfileEvent
+{
+    const char *name;       // name of the zone
+    int depth;              // nesting of the zone (0 for the outermost zones)
+    double start;           // start and end in milliseconds from the start
+    double end;             // of the frame
+};
+
+/**
+ * Frame profiler.
+ * AWindow::run measures every frame with the zones "events", "loop",
+ * "render" and "swap", engine classes add their own zones ("level",
+ * "collision", "model", "text", "occlusion"). Zones can be nested. The
+ * last frames are kept in a ring buffer, the time of the OpenGL commands of
+ * the frame is measured by a timer query where GL_EXT_timer_query is
+ * supported (read a few frames later, so it doesn't stall). The results
+ * can be drawn as a graph, printed to the console or exported as a
+ * Chrome trace (chrome://tracing).
+ * @n
+ * @n
+ * The profiler is disabled by default, a disabled zone costs one test.
+ * Zones are recorded only from the thread which enabled the profiler and
+ * only between AProfiler::beginFrame and AProfiler::endFrame. Names of the
+ * zones must be string constants, only the pointers are stored.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * AProfiler::setEnabled(true);
+ * ...
+ * void MyWindow::loop()
+ * {
+ *     APROFILE("ai");
+ *     updateEnemies();
+ * }
+ * ...
+ * AProfiler::drawGraph(&text, 10, 10, 256, 64);
+ * AProfiler::exportTrace("frames.json");
+ * @endcode
+ */
+class AProfiler
+{
+    private:
+        struct Frame
+        {
+            unsigned int number;            // number of the frame
+            double start;                   // time of the start (ms)
+            double cpuTime;                 // time from beginFrame to endFrame
+            double gpuTime;                 // time of OpenGL commands or -1
+            std::vector<AProfileEvent> events;
+        };
+
+        enum { NUM_QUERIES = 4 };           // frames waiting for the timer
+
+        static bool enabled;
+        static Uint32 thread;               // thread recording the zones
+        static double epoch;                // time of enabling
+
+        static std::vector<Frame> frames;   // ring buffer of the frames
+        static unsigned int frameNumber;    // number of the current frame
+        static bool inFrame;
+        static std::vector<int> stack;      // open zones of the frame
+
+        static GLuint queries[NUM_QUERIES];
+        static unsigned int queryFrames[NUM_QUERIES];
+        static bool queryPending[NUM_QUERIES];
+        static bool queriesCreated;
+        static int runningQuery;            // slot of the running query or -1
+
+        // returns the frame if it is still in the ring buffer
+        static Frame *getFrame(unsigned int number);
+
+        // returns the frame 'age' frames before the last finished one
+        static Frame *getFinishedFrame(int age);
+
+        // reads the result of the timer query
+        static void readQuery(int slot, bool wait);
+
+    public:
+        /**
+         * Returns the current time.
+         * The time has better resolution than SDL_GetTicks.
+         * @return Time in milliseconds
+         */
+        static double getTime();
+
+        /**
+         * Enables or disables the profiler.
+         * Enabling clears the recorded frames.
+         * @param enabled True to enable the profiler
+         * @param history Number of frames kept in the ring buffer
+         */
+        static void setEnabled(bool enabled, int history = 128);
+
+        /**
+         * Returns true if the profiler is enabled.
+         * @return True if the profiler records the frames
+         */
+        static bool isEnabled() { return enabled; }
+
+        /**
+         * Tells the profiler that the OpenGL context was recreated.
+         * The timer queries are created again.
+         */
+        static void invalidate();
+
+        /**
+         * Starts the frame.
+         * It is called by AWindow::run.
+         */
+        static void beginFrame();
+
+        /**
+         * Ends the frame.
+         * Zones which are still open are closed.
+         */
+        static void endFrame();
+
+        /**
+         * Starts the zone.
+         * @param name Name of the zone (string constant)
+         * @return True if the zone is recorded (AProfiler::endZone must be
+         *         called then)
+         */
+        static bool beginZone(const char *name)
+        {
+            if(!enabled)
+                return false;
+
+            return beginZoneRecorded(name);
+        }
+
+        /**
+         * Starts the recorded zone.
+         * Use AProfiler::beginZone, this is its part for the enabled
+         * profiler.
+         * @param name Name of the zone
+         * @return True if the zone is recorded
+         */
+        static bool beginZoneRecorded(const char *name);
+
+        /**
+         * Ends the innermost zone.
+         */
+        static void endZone();
+
+        /**
+         * Returns the number of recorded frames.
+         * @return Number of finished frames in the ring buffer
+         */
+        static unsigned int getFrameCount();
+
+        /**
+         * Returns the time of the frame.
+         * @param age 0 for the last finished frame, 1 for the frame before...
+         * @return Time in milliseconds or -1 if the frame isn't recorded
+         */
+        static double getFrameTime(int age = 0);
+
+        /**
+         * Returns the time of OpenGL commands of the frame.
+         * The time is known a few frames later.
+         * @param age 0 for the last finished frame, 1 for the frame before...
+         * @return Time in milliseconds or -1 if it isn't known
+         */
+        static double getGPUTime(int age = 0);
+
+        /**
+         * Returns the average time of the zone.
+         * @param name Name of the zone
+         * @return Average time of all zones of this name per frame
+         *         (milliseconds)
+         */
+        static double getZoneTime(const char *name);
+
+        /**
+         * Returns the zones of the frame.
+         * @param age 0 for the last finished frame, 1 for the frame before...
+         * @return Zones in the order of their start or NULL
+         */
+        static const std::vector<AProfileEvent> *getEvents(int age = 0);
+
+        /**
+         * Draws the graph of the frame times.
+         * Every recorded frame is one bar (CPU time, GPU time in the front),
+         * the line marks 60 fps. The times of the outermost zones are
+         * printed below the graph.
+         * @param text Font for the numbers
+         * @param x x-position of the graph from the left
+         * @param y y-position of the graph from the bottom
+         * @param width Width of the graph
+         * @param height Height of the graph
+         * @param maxTime Time of the full height (ms)
+         */
+        static void drawGraph(AText2D *text, int x, int y, int width, int height, double maxTime = 33.3);
+
+        /**
+         * Prints the average times of the outermost zones to the console.
+         * @param console Console to print to
+         */
+        static void print(AConsole *console);
+
+        /**
+         * Exports the recorded frames.
+         * The file is in the Chrome trace format (JSON) and can be opened
+         * in chrome://tracing.
+         * @param filename Output file
+         * @return True if the file was written
+         */
+        static bool exportTrace(char *filename);
+};
+
+/**
+ * Zone of the profiler measured until the end of the scope.
+ * Use the APROFILE macro.
+ */
+class AProfileZone
+{
+    private:
+        bool active;
+
+    public:
+        /**
+         * Constructor.
+         * Starts the zone.
+         * @param name Name of the zone (string constant)
+         */
+        AProfileZone(const char *name) { active = AProfiler::beginZone(name); }
+
+        /**
+         * Destructor.
+         * Ends the zone.
+         */
+        ~AProfileZone() { end(); }
+
+        /**
+         * Ends the zone before the end of the scope.
+         */
+        void end() { if(active) { AProfiler::endZone(); active = false; } }
+};
+
+#define APROFILE_JOIN2(a, b) a##b
+#define APROFILE_JOIN(a, b) APROFILE_JOIN2(a, b)
+
+/**
+ * Measures the rest of the scope as the zone of the profiler.
+ */
+#define APROFILE(name) astral3d::AProfileZone APROFILE_JOIN(aprofileZone, __LINE__)(name)
+
+} // namespace astral3d
+
+#endif    // #ifndef APROFILER_H
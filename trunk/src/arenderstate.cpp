@@ -0,0 +1,238 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "arenderstate.h"
+
+using namespace std;
+namespace astral3d {
+
+int ARenderState::caps[NUM_CAPS] = { -1, -1, -1, -1, -1 };
+GLuint ARenderState::texture = 0;
+bool ARenderState::textureKnown = false;
+GLenum ARenderState::blendSrc = GL_ONE;
+GLenum ARenderState::blendDst = GL_ZERO;
+bool ARenderState::blendKnown = false;
+GLenum ARenderState::polygonModeValue = GL_FILL;
+bool ARenderState::polygonModeKnown = false;
+int ARenderState::depth2D = 0;
+bool ARenderState::depthTest2D = true;
+unsigned int ARenderState::stateChanges = 0;
+unsigned int ARenderState::redundantChanges = 0;
+unsigned int ARenderState::drawCalls = 0;
+
+//-----------------------------------------------------------------------------
+// index of the capability in the cache
+//-----------------------------------------------------------------------------
+
+int ARenderState::capIndex(GLenum cap)
+{
+    switch(cap)
+    {
+        case GL_TEXTURE_2D: return TEXTURE_2D;
+        case GL_BLEND:      return BLEND;
+        case GL_DEPTH_TEST: return DEPTH_TEST;
+        case GL_LIGHTING:   return LIGHTING;
+        case GL_CULL_FACE:  return CULL_FACE;
+    }
+
+    return -1;
+}
+
+//-----------------------------------------------------------------------------
+// enables or disables the capability
+//-----------------------------------------------------------------------------
+
+void ARenderState::setEnabled(GLenum cap, bool enabled)
+{
+    int i = capIndex(cap);
+
+    if(i >= 0)
+    {
+        if(caps[i] == (enabled ? 1 : 0))
+        {
+            redundantChanges++;
+            return;
+        }
+
+        caps[i] = enabled ? 1 : 0;
+    }
+
+    if(enabled)
+        glEnable(cap);
+    else
+        glDisable(cap);
+
+    stateChanges++;
+}
+
+//-----------------------------------------------------------------------------
+// returns the state of the capability
+//-----------------------------------------------------------------------------
+
+bool ARenderState::isEnabled(GLenum cap)
+{
+    int i = capIndex(cap);
+
+    if(i >= 0 && caps[i] >= 0)
+        return caps[i] == 1;
+
+    bool enabled = glIsEnabled(cap) == GL_TRUE;
+
+    if(i >= 0)
+        caps[i] = enabled ? 1 : 0;
+
+    return enabled;
+}
+
+//-----------------------------------------------------------------------------
+// binds the texture
+//-----------------------------------------------------------------------------
+
+void ARenderState::bindTexture(GLuint texture)
+{
+    if(textureKnown && ARenderState::texture == texture)
+    {
+        redundantChanges++;
+        return;
+    }
+
+    glBindTexture(GL_TEXTURE_2D, texture);
+    ARenderState::texture = texture;
+    textureKnown = true;
+    stateChanges++;
+}
+
+//-----------------------------------------------------------------------------
+// the texture was deleted
+//-----------------------------------------------------------------------------
+
+void ARenderState::textureDeleted(GLuint texture)
+{
+    if(textureKnown && ARenderState::texture == texture)
+        ARenderState::texture = 0;
+}
+
+//-----------------------------------------------------------------------------
+// sets the blend function
+//-----------------------------------------------------------------------------
+
+void ARenderState::blendFunc(GLenum src, GLenum dst)
+{
+    if(blendKnown && blendSrc == src && blendDst == dst)
+    {
+        redundantChanges++;
+        return;
+    }
+
+    glBlendFunc(src, dst);
+    blendSrc = src;
+    blendDst = dst;
+    blendKnown = true;
+    stateChanges++;
+}
+
+//-----------------------------------------------------------------------------
+// sets the polygon mode
+//-----------------------------------------------------------------------------
+
+void ARenderState::polygonMode(GLenum mode)
+{
+    if(polygonModeKnown && polygonModeValue == mode)
+    {
+        redundantChanges++;
+        return;
+    }
+
+    glPolygonMode(GL_FRONT_AND_BACK, mode);
+    polygonModeValue = mode;
+    polygonModeKnown = true;
+    stateChanges++;
+}
+
+//-----------------------------------------------------------------------------
+// starts 2D drawing
+//-----------------------------------------------------------------------------
+
+void ARenderState::begin2D(int width, int height)
+{
+    if(depth2D++ > 0)
+    {
+        redundantChanges++;
+        return;
+    }
+
+    depthTest2D = isEnabled(GL_DEPTH_TEST);
+    disable(GL_DEPTH_TEST);
+
+    glMatrixMode(GL_PROJECTION);
+    glPushMatrix();
+    glLoadIdentity();
+    glOrtho(0, width, 0, height, -100, 100);
+    glMatrixMode(GL_MODELVIEW);
+    glPushMatrix();
+    glLoadIdentity();
+
+    stateChanges++;
+}
+
+//-----------------------------------------------------------------------------
+// ends 2D drawing
+//-----------------------------------------------------------------------------
+
+void ARenderState::end2D()
+{
+    if(depth2D == 0 || --depth2D > 0)
+        return;
+
+    glMatrixMode(GL_PROJECTION);
+    glPopMatrix();
+    glMatrixMode(GL_MODELVIEW);
+    glPopMatrix();
+
+    setEnabled(GL_DEPTH_TEST, depthTest2D);
+
+    stateChanges++;
+}
+
+//-----------------------------------------------------------------------------
+// forgets everything
+//-----------------------------------------------------------------------------
+
+void ARenderState::invalidate()
+{
+    for(int i = 0; i < NUM_CAPS; i++)
+        caps[i] = -1;
+
+    textureKnown = false;
+    blendKnown = false;
+    polygonModeKnown = false;
+}
+
+//-----------------------------------------------------------------------------
+// starts the new frame
+//-----------------------------------------------------------------------------
+
+void ARenderState::beginFrame()
+{
+    stateChanges = 0;
+    redundantChanges = 0;
+    drawCalls = 0;
+}
+
+} // namespace astral3d
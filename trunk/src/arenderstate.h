@@ -0,0 +1,194 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file arenderstate.h ARenderState class.
+ */
+#ifndef ARENDERSTATE_H
+#define ARENDERSTATE_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <GL/gl.h>
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Cache of the OpenGL state.
+ * All engine classes change the OpenGL state through this class. It
+ * remembers the last value of every state it knows and drops calls that
+ * wouldn't change anything. It also counts the state changes and the draw
+ * calls of the frame (AWindow::render starts a new frame).
+ * @n
+ * @n
+ * Cached states are GL_TEXTURE_2D, GL_BLEND, GL_DEPTH_TEST, GL_LIGHTING and
+ * GL_CULL_FACE switches, bound 2D texture, blend function and polygon mode.
+ * Other capabilities are passed to OpenGL every time. If you change the
+ * cached states directly with OpenGL calls, call ARenderState::invalidate
+ * afterwards.
+ */
+class ARenderState
+{
+    private:
+        // cached switches
+        enum { TEXTURE_2D, BLEND, DEPTH_TEST, LIGHTING, CULL_FACE, NUM_CAPS };
+
+        static int caps[NUM_CAPS];          // 1 enabled, 0 disabled, -1 unknown
+        static GLuint texture;              // bound texture
+        static bool textureKnown;
+        static GLenum blendSrc;             // blend function
+        static GLenum blendDst;
+        static bool blendKnown;
+        static GLenum polygonModeValue;     // polygon mode of both faces
+        static bool polygonModeKnown;
+
+        // 2D mode
+        static int depth2D;                 // nesting of begin2D calls
+        static bool depthTest2D;            // depth test before begin2D
+
+        // statistics of the frame
+        static unsigned int stateChanges;
+        static unsigned int redundantChanges;
+        static unsigned int drawCalls;
+
+        // index of the cached capability or -1
+        static int capIndex(GLenum cap);
+
+    public:
+        /**
+         * Enables the capability.
+         * @param cap OpenGL capability (GL_BLEND, GL_TEXTURE_2D, ...)
+         */
+        static void enable(GLenum cap) { setEnabled(cap, true); }
+
+        /**
+         * Disables the capability.
+         * @param cap OpenGL capability (GL_BLEND, GL_TEXTURE_2D, ...)
+         */
+        static void disable(GLenum cap) { setEnabled(cap, false); }
+
+        /**
+         * Enables or disables the capability.
+         * @param cap OpenGL capability
+         * @param enabled True to enable the capability
+         */
+        static void setEnabled(GLenum cap, bool enabled);
+
+        /**
+         * Returns true if the capability is enabled.
+         * OpenGL is asked only if the state isn't known.
+         * @param cap OpenGL capability
+         * @return True if the capability is enabled
+         */
+        static bool isEnabled(GLenum cap);
+
+        /**
+         * Binds the 2D texture.
+         * @param texture OpenGL texture name
+         */
+        static void bindTexture(GLuint texture);
+
+        /**
+         * Tells the cache that the texture was deleted.
+         * OpenGL binds the texture 0 when the bound texture is deleted.
+         * @param texture Deleted texture
+         */
+        static void textureDeleted(GLuint texture);
+
+        /**
+         * Sets the blend function.
+         * @param src Source factor
+         * @param dst Destination factor
+         */
+        static void blendFunc(GLenum src, GLenum dst);
+
+        /**
+         * Sets the polygon mode of both faces.
+         * @param mode GL_FILL, GL_LINE or GL_POINT
+         */
+        static void polygonMode(GLenum mode);
+
+        /**
+         * Starts 2D drawing.
+         * This method sets the orthographic projection with the origin in
+         * the bottom left corner, the identity modelview matrix and disables
+         * the depth test. Nested calls (e.g. AText2D::print inside
+         * AConsole::render) only increase the counter, so the matrices are
+         * pushed only once. Nested calls must use the same size.
+         * @param width Width of the screen
+         * @param height Height of the screen
+         * @see end2D
+         */
+        static void begin2D(int width, int height);
+
+        /**
+         * Ends 2D drawing.
+         * The last of the nested calls restores the matrices and the depth
+         * test.
+         * @see begin2D
+         */
+        static void end2D();
+
+        /**
+         * Forgets all cached states.
+         * Call this method after changing the cached states directly.
+         */
+        static void invalidate();
+
+        /**
+         * Counts the draw calls.
+         * Engine classes call this for every glBegin/glDrawElements.
+         * @param count Number of draw calls
+         */
+        static void countDrawCall(unsigned int count = 1) { drawCalls += count; }
+
+        /**
+         * Starts the new frame.
+         * This method resets the statistics. It is called from
+         * AWindow::render.
+         */
+        static void beginFrame();
+
+        /**
+         * Returns the number of state changes.
+         * @return Number of OpenGL state calls made in this frame
+         */
+        static unsigned int getStateChanges() { return stateChanges; }
+
+        /**
+         * Returns the number of redundant state changes.
+         * @return Number of state calls dropped by the cache in this frame
+         */
+        static unsigned int getRedundantChanges() { return redundantChanges; }
+
+        /**
+         * Returns the number of draw calls.
+         * @return Number of draw calls made in this frame
+         */
+        static unsigned int getDrawCalls() { return drawCalls; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ARENDERSTATE_H
@@ -0,0 +1,161 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "ascenebuffer.h"
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// interpolated camera
+//-----------------------------------------------------------------------------
+
+void ASceneState::setCamera(double interpolation) const
+{
+    AVector e = lastEye + (eye - lastEye) * interpolation;
+    AVector f = lastFront + (front - lastFront) * interpolation;
+
+    gluLookAt(e.x, e.y, e.z, f.x, f.y, f.z, 0.0, 1.0, 0.0);
+}
+
+//-----------------------------------------------------------------------------
+// setTransform
+//-----------------------------------------------------------------------------
+
+void ASceneState::setTransform(int index, const double *matrix)
+{
+    if(index < 0)
+        return;
+
+    if(transforms.size() < (unsigned int) (index + 1) * 16)
+        transforms.resize((index + 1) * 16);
+
+    for(int i = 0; i < 16; i++)
+        transforms[index * 16 + i] = matrix[i];
+}
+
+//-----------------------------------------------------------------------------
+// getTransform
+//-----------------------------------------------------------------------------
+
+void ASceneState::getTransform(int index, double interpolation, double *matrix) const
+{
+    const double *current = &transforms[index * 16];
+
+    // the model is new in this step
+    if(lastTransforms.size() < (unsigned int) (index + 1) * 16)
+    {
+        for(int i = 0; i < 16; i++)
+            matrix[i] = current[i];
+        return;
+    }
+
+    const double *last = &lastTransforms[index * 16];
+    for(int i = 0; i < 16; i++)
+        matrix[i] = last[i] + (current[i] - last[i]) * interpolation;
+}
+
+//-----------------------------------------------------------------------------
+// setLight
+//-----------------------------------------------------------------------------
+
+void ASceneState::setLight(int index, const GLfloat *position)
+{
+    if(index < 0)
+        return;
+
+    if(lights.size() < (unsigned int) (index + 1) * 4)
+        lights.resize((index + 1) * 4);
+
+    for(int i = 0; i < 4; i++)
+        lights[index * 4 + i] = position[i];
+}
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+ASceneBuffer::ASceneBuffer()
+{
+    back = 0;
+    middle = 1;
+    front = 2;
+    published = 2;
+}
+
+//-----------------------------------------------------------------------------
+// atomic exchange
+//-----------------------------------------------------------------------------
+
+int ASceneBuffer::exchange(volatile int *target, int value)
+{
+#ifdef WIN32
+    return InterlockedExchange((volatile LONG *) target, value);
+#else
+    // __sync_lock_test_and_set is only an acquire barrier, the written
+    // state must be visible before the exchange
+    __sync_synchronize();
+    return __sync_lock_test_and_set(target, value);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// beginWrite
+//-----------------------------------------------------------------------------
+
+ASceneState *ASceneBuffer::beginWrite()
+{
+    ASceneState &state = states[back];
+
+    // the published state is only read by the reader now, it can be copied
+    if(published != back)
+        state = states[published];
+
+    state.lastEye = state.eye;
+    state.lastFront = state.front;
+    state.lastTransforms = state.transforms;
+    state.step++;
+
+    return &state;
+}
+
+//-----------------------------------------------------------------------------
+// publish
+//-----------------------------------------------------------------------------
+
+void ASceneBuffer::publish()
+{
+    published = back;
+    back = exchange(&middle, back | FRESH) & ~FRESH;
+}
+
+//-----------------------------------------------------------------------------
+// acquire
+//-----------------------------------------------------------------------------
+
+bool ASceneBuffer::acquire()
+{
+    if(!(middle & FRESH))
+        return false;
+
+    front = exchange(&middle, front) & ~FRESH;
+    return true;
+}
+
+} // namespace astral3d
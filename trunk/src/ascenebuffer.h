@@ -0,0 +1,192 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file ascenebuffer.h ASceneBuffer class.
+ */
+#ifndef ASCENEBUFFER_H
+#define ASCENEBUFFER_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <vector>
+#include <GL/gl.h>
+#include <GL/glu.h>
+
+#include "avector.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * State of the scene needed for rendering.
+ * The simulation writes it every step, the renderer reads it. Every value
+ * is kept for the last two steps, so the renderer can interpolate between
+ * them (see AWindow::getInterpolation).
+ */
+struct ASceneState
+{
+    AVector eye;                        // position of the camera
+    AVector front;                      // point the camera looks at
+    AVector lastEye;                    // camera of the previous step
+    AVector lastFront;
+
+    std::vector<double> transforms;     // matrices of the models (16 each)
+    std::vector<double> lastTransforms; // matrices of the previous step
+
+    std::vector<GLfloat> lights;        // positions of the lights (4 each)
+
+    unsigned int step;                  // number of the simulation step
+    double time;                        // time of the step (ms, AProfiler::getTime)
+
+    /**
+     * Constructor.
+     */
+    ASceneState() { step = 0; time = 0.0; }
+
+    /**
+     * Sets the camera of the step.
+     * @param eye Position of the camera
+     * @param front Point the camera looks at
+     */
+    void setCamera(const AVector &eye, const AVector &front) { this->eye = eye; this->front = front; }
+
+    /**
+     * Sets the scene according to the interpolated camera.
+     * @param interpolation 0 for the previous step to 1 for this step
+     */
+    void setCamera(double interpolation) const;
+
+    /**
+     * Sets the matrix of the model.
+     * @param index Index of the model
+     * @param matrix Column-major matrix (16 values)
+     */
+    void setTransform(int index, const double *matrix);
+
+    /**
+     * Returns the interpolated matrix of the model.
+     * The matrices are interpolated by elements, it is good for small
+     * moves of one step.
+     * @param index Index of the model
+     * @param interpolation 0 for the previous step to 1 for this step
+     * @param matrix Column-major matrix (16 values)
+     */
+    void getTransform(int index, double interpolation, double *matrix) const;
+
+    /**
+     * Returns the number of the model matrices.
+     * @return Number of models
+     */
+    int getTransformCount() const { return transforms.size() / 16; }
+
+    /**
+     * Sets the position of the light.
+     * @param index Index of the light
+     * @param position Position for GL_POSITION (4 values)
+     */
+    void setLight(int index, const GLfloat *position);
+};
+
+/**
+ * Lock-free triple buffer of the scene states.
+ * One thread (the simulation) writes the states, another one (the
+ * renderer) reads the last complete state. Neither of them waits for the
+ * other: the writer always has its own state to write, the reader keeps
+ * its state until it takes the newer one, the third state is exchanged
+ * between them by an atomic operation. A slow frame only skips the states
+ * published meanwhile, the simulation runs on.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * // simulation thread
+ * ASceneState *state = buffer.beginWrite();
+ * state->setCamera(camera.getEye(), camera.getFront());
+ * state->setTransform(0, crateMatrix);
+ * buffer.publish();
+ *
+ * // render thread
+ * buffer.acquire();
+ * const ASceneState *state = buffer.getState();
+ * state->setCamera(interpolation);
+ * @endcode
+ */
+class ASceneBuffer
+{
+    private:
+        enum { FRESH = 4 };                 // the middle state wasn't read
+
+        ASceneState states[3];
+
+        volatile int middle;                // exchanged state (index | FRESH)
+        int back;                           // state of the writer
+        int front;                          // state of the reader
+        int published;                      // state published last
+
+        // atomic exchange of the middle state with the full barrier
+        static int exchange(volatile int *target, int value);
+
+        ASceneBuffer(const ASceneBuffer &);
+        ASceneBuffer &operator=(const ASceneBuffer &);
+
+    public:
+        /**
+         * Constructor.
+         */
+        ASceneBuffer();
+
+        /**
+         * Returns the state to write.
+         * Only the writing thread can call it. The state is a copy of the
+         * state published last, its values are moved to the values of the
+         * previous step and the number of the step is increased.
+         * @return State of the writer
+         */
+        ASceneState *beginWrite();
+
+        /**
+         * Publishes the written state.
+         * Only the writing thread can call it.
+         */
+        void publish();
+
+        /**
+         * Takes the last published state.
+         * Only the reading thread can call it.
+         * @return True if there was a new state
+         */
+        bool acquire();
+
+        /**
+         * Returns the state of the reader.
+         * It doesn't change until the next ASceneBuffer::acquire.
+         * @return Last acquired state
+         */
+        const ASceneState *getState() { return &states[front]; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ASCENEBUFFER_H
@@ -0,0 +1,181 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "aspritebatch.h"
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+ASpriteBatch::ASpriteBatch(AWindow *window)
+{
+    this->window = window;
+    drawCalls = 0;
+    spriteCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// setWindow
+//-----------------------------------------------------------------------------
+
+void ASpriteBatch::setWindow(AWindow *window)
+{
+    if(!window)
+    {
+        throw ANullPointerException("void ASpriteBatch::setWindow(AWindow *window)");
+    }
+
+    this->window = window;
+}
+
+//-----------------------------------------------------------------------------
+// order of the sprites
+//-----------------------------------------------------------------------------
+
+bool ASpriteBatch::compare(const Sprite &a, const Sprite &b)
+{
+    if(a.layer != b.layer)
+        return a.layer < b.layer;
+
+    if(a.blendSrc != b.blendSrc)
+        return a.blendSrc < b.blendSrc;
+
+    if(a.blendDst != b.blendDst)
+        return a.blendDst < b.blendDst;
+
+    if(a.texture != b.texture)
+        return a.texture < b.texture;
+
+    return a.order < b.order;
+}
+
+//-----------------------------------------------------------------------------
+// draw
+//-----------------------------------------------------------------------------
+
+void ASpriteBatch::draw(ASurface *surface, ARectangle target, ARectangle source, int layer)
+{
+    if(!surface)
+    {
+        throw ANullPointerException("void ASpriteBatch::draw(ASurface *surface, ARectangle target, ARectangle source, int layer)");
+    }
+
+    Sprite sprite;
+    sprite.layer = layer;
+    sprite.blendSrc = surface->getSourceBlendFactor();
+    sprite.blendDst = surface->getDestinationBlendFactor();
+    sprite.texture = surface->getTextureID();
+    sprite.order = vertices.size();
+    sprites.push_back(sprite);
+
+    float x1, y1, x2, y2;
+    surface->getTexCoords(source, &x1, &y1, &x2, &y2);
+
+    ASpriteVertex v;
+    v.r = v.g = v.b = 255;
+    v.a = surface->getAlpha();
+    v.z = 0.0f;
+
+    v.u = x1; v.v = y2;
+    v.x = target.x; v.y = target.y + target.height;
+    vertices.push_back(v);
+
+    v.u = x2; v.v = y2;
+    v.x = target.x + target.width; v.y = target.y + target.height;
+    vertices.push_back(v);
+
+    v.u = x2; v.v = y1;
+    v.x = target.x + target.width; v.y = target.y;
+    vertices.push_back(v);
+
+    v.u = x1; v.v = y1;
+    v.x = target.x; v.y = target.y;
+    vertices.push_back(v);
+}
+
+//-----------------------------------------------------------------------------
+// flush
+//-----------------------------------------------------------------------------
+
+void ASpriteBatch::flush()
+{
+    drawCalls = 0;
+    spriteCount = sprites.size();
+
+    if(sprites.empty())
+        return;
+
+    if(!window)
+    {
+        clear();
+        throw ANullPointerException("void ASpriteBatch::flush()");
+    }
+
+    sort(sprites.begin(), sprites.end(), compare);
+
+    // vertices are copied in the sorted order so every run of the same
+    // state is one range of the array
+    sorted.resize(vertices.size());
+    for(unsigned int i = 0; i < sprites.size(); i++)
+    {
+        for(int k = 0; k < 4; k++)
+            sorted[i * 4 + k] = vertices[sprites[i].order + k];
+    }
+
+    ARenderState::enable(GL_BLEND);
+    ARenderState::enable(GL_TEXTURE_2D);
+    ARenderState::disable(GL_LIGHTING);
+    ARenderState::begin2D(window->getWidth(), window->getHeight());
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glInterleavedArrays(GL_T2F_C4UB_V3F, 0, &sorted[0]);
+
+    unsigned int first = 0;
+    for(unsigned int i = 1; i <= sprites.size(); i++)
+    {
+        if(i < sprites.size() &&
+           sprites[i].texture == sprites[first].texture &&
+           sprites[i].blendSrc == sprites[first].blendSrc &&
+           sprites[i].blendDst == sprites[first].blendDst)
+            continue;
+
+        ARenderState::blendFunc(sprites[first].blendSrc, sprites[first].blendDst);
+        ARenderState::bindTexture(sprites[first].texture);
+
+        ARenderState::countDrawCall();
+        glDrawArrays(GL_QUADS, first * 4, (i - first) * 4);
+        drawCalls++;
+
+        first = i;
+    }
+
+    glPopClientAttrib();
+
+    // the color array leaves the current color undefined
+    glColor4ub(255, 255, 255, 255);
+
+    ARenderState::end2D();
+
+    clear();
+}
+
+} // namespace astral3d
@@ -0,0 +1,170 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file aspritebatch.h ASpriteBatch class.
+ */
+#ifndef ASPRITEBATCH_H
+#define ASPRITEBATCH_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <vector>
+#include <algorithm>
+#include <GL/gl.h>
+
+#include "asurface.h"
+#include "arenderstate.h"
+#include "aexceptions.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Vertex of the sprite batch (GL_T2F_C4UB_V3F format).
+ */
+struct ASpriteVertex
+{
+    GLfloat u, v;           // texture coordinates
+    GLubyte r, g, b, a;     // color
+    GLfloat x, y, z;        // position
+};
+
+/**
+ * Class for drawing many images of many surfaces at once.
+ * Images drawn by ASpriteBatch::draw are only stored. ASpriteBatch::flush
+ * sorts them by the layer, the blend function and the texture and draws
+ * every run of images with the same state with one glDrawArrays call from
+ * one vertex array. The 2D projection is set once per flush.
+ * @n
+ * @n
+ * Sorting changes the order of overlapping images with different textures.
+ * Use layers when the order matters: images of the lower layer are always
+ * drawn first, inside the layer images of one texture keep their order.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * ASpriteBatch sprites(&window);
+ * ...
+ * sprites.draw(&icons, ARectangle(10, 10, 32, 32), ARectangle(0, 0, 32, 32));
+ * sprites.draw(&panel, 0, 0, ARectangle(0, 0, 640, 64), 0);
+ * sprites.draw(&cursor, mouseX, mouseY, ARectangle(0, 0, 16, 16), 1);
+ * ...
+ * sprites.flush();
+ * @endcode
+ */
+class ASpriteBatch
+{
+    private:
+        struct Sprite
+        {
+            int layer;
+            GLenum blendSrc;
+            GLenum blendDst;
+            GLuint texture;
+            unsigned int order;     // index of the first vertex in vertices
+        };
+
+        // order of the sprites in the flush
+        static bool compare(const Sprite &a, const Sprite &b);
+
+        AWindow *window;
+
+        std::vector<Sprite> sprites;
+        std::vector<ASpriteVertex> vertices;    // vertices in the order of draw calls
+        std::vector<ASpriteVertex> sorted;      // vertices sorted for flush
+
+        unsigned int drawCalls;                 // draw calls of the last flush
+        unsigned int spriteCount;               // sprites of the last flush
+
+    public:
+        /**
+         * Constructor.
+         * @param window Window the images are drawn to
+         */
+        ASpriteBatch(AWindow *window = NULL);
+
+        /**
+         * Sets the window.
+         * @param window Window the images are drawn to
+         * @throw ANullPointerException
+         */
+        void setWindow(AWindow *window);
+
+        /**
+         * Adds the image to the batch.
+         * The texture, blend function and transparency of the surface are
+         * used.
+         * @param surface Surface with the image
+         * @param target Rectangle in the window to be drawn to (in pixels)
+         * @param source Rectangle to be drawn from the image (in pixels)
+         * @param layer Layer of the image, lower layers are drawn first
+         * @throw ANullPointerException
+         */
+        void draw(ASurface *surface, ARectangle target, ARectangle source, int layer = 0);
+
+        /**
+         * Adds the image to the batch.
+         * @param surface Surface with the image
+         * @param x x-position of the image in the window from the left
+         * @param y y-position of the image in the window from the bottom
+         * @param source Rectangle to be drawn from the image (in pixels)
+         * @param layer Layer of the image, lower layers are drawn first
+         * @throw ANullPointerException
+         */
+        void draw(ASurface *surface, int x, int y, ARectangle source, int layer = 0)
+        {
+            draw(surface, ARectangle(x, y, source.width, source.height), source, layer);
+        }
+
+        /**
+         * Draws all images.
+         * This method should be called once per frame after all images are
+         * added. The batch is empty afterwards.
+         * @throw ANullPointerException
+         */
+        void flush();
+
+        /**
+         * Removes all images without drawing them.
+         */
+        void clear() { sprites.clear(); vertices.clear(); }
+
+        /**
+         * Returns the number of draw calls.
+         * @return Number of draw calls made by the last flush
+         */
+        unsigned int getDrawCalls() { return drawCalls; }
+
+        /**
+         * Returns the number of images.
+         * @return Number of images drawn by the last flush
+         */
+        unsigned int getSpriteCount() { return spriteCount; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ASPRITEBATCH_H
@@ -39,5 +39,24 @@
 #include "asurface.h"
 #include "aexceptions.h"
 #include "aabstract.h"
+#include "aextensions.h"
+#include "ainstancebatch.h"
+#include "afrustum.h"
+#include "aocclusion.h"
+#include "arenderstate.h"
+#include "adrawqueue.h"
+#include "aspritebatch.h"
+#include "aatlas.h"
+#include "abenchmark.h"
+#include "aprofiler.h"
+#include "ascenebuffer.h"
+#include "ajobsystem.h"
+#include "atextureloader.h"
+#include "atexturemanager.h"
+#include "atexturecache.h"
+#include "atexturestreamer.h"
+#include "atextureuploader.h"
+#include "atexturecompressor.h"
+#include "amodelloader.h"
 
 #endif // #ifndef ASTRAL3D_H
@@ -33,6 +33,11 @@ ASurface::ASurface()
     textureID = 0;
     textureWidth = 0;
     textureHeight = 0;
+    originX = 0;
+    originY = 0;
+    pageWidth = 0;
+    pageHeight = 0;
+    ownTexture = true;
 
     sourceBlendFactor = GL_SRC_ALPHA;
     destinationBlendFactor = GL_ONE_MINUS_SRC_ALPHA;
@@ -51,6 +56,19 @@ ASurface::ASurface(char *imageFileName, AWindow *window, unsigned int alpha)
     setAlpha(alpha);
 }
 
+//-----------------------------------------------------------------------------
+// Constructor
+//-----------------------------------------------------------------------------
+
+ASurface::ASurface(AAtlas *atlas, int image, AWindow *window, unsigned int alpha)
+{
+    *this = ASurface();
+
+    loadImage(atlas, image);
+    setWindow(window);
+    setAlpha(alpha);
+}
+
 //-----------------------------------------------------------------------------
 // Destructor
 //-----------------------------------------------------------------------------
@@ -66,7 +84,11 @@ ASurface::~ASurface()
 
 void ASurface::destroy()
 {
-    deleteTexture(&textureID);
+    // the atlas deletes its pages itself
+    if(ownTexture)
+        deleteTexture(&textureID);
+    else
+        textureID = 0;
 }
 
 //-----------------------------------------------------------------------------
@@ -75,21 +97,49 @@ void ASurface::destroy()
 
 void ASurface::loadImage(char *imageFileName)
 {
-    if(!loadTexture(imageFileName, &textureID))
+    // the size is read from the texture, the image isn't decoded twice
+    if(!(textureID = ATextureManager::load(imageFileName, false)))
     {
         throw ATextureException("void ASurface::loadImage(char *imageFileName)");
     }
 
-    SDL_Surface *image = NULL;
-    if(!(image = IMG_Load(imageFileName)))
+    ATextureManager::getSize(textureID, &textureWidth, &textureHeight);
+
+    originX = 0;
+    originY = 0;
+    pageWidth = textureWidth;
+    pageHeight = textureHeight;
+    ownTexture = true;
+}
+
+//-----------------------------------------------------------------------------
+// loadImage
+//-----------------------------------------------------------------------------
+
+void ASurface::loadImage(AAtlas *atlas, int image)
+{
+    if(!atlas)
     {
-        throw ATextureException("void ASurface::loadImage(char *imageFileName)");
+        throw ANullPointerException("void ASurface::loadImage(AAtlas *atlas, int image)");
+    }
+
+    if(!atlas->getTexture(image))
+    {
+        stringstream foo;
+        foo << "ASurface::loadImage("<<atlas<<", "<<image<<")";
+        setAstral3DError("The atlas isn't built or doesn't contain the image", foo.str(), "AAtlas::getTexture");
+
+        throw ATextureException("void ASurface::loadImage(AAtlas *atlas, int image)");
     }
 
-    textureWidth = image->w;
-    textureHeight = image->h;
+    textureID = atlas->getTexture(image);
+    textureWidth = atlas->getImageWidth(image);
+    textureHeight = atlas->getImageHeight(image);
 
-    SDL_FreeSurface(image);
+    atlas->getPosition(image, &originX, &originY);
+    pageWidth = atlas->getPageWidth();
+    pageHeight = atlas->getPageHeight();
+    ownTexture = false;
 }
 
 //-----------------------------------------------------------------------------
@@ -126,21 +176,15 @@ void ASurface::setAlpha(unsigned int alpha)
 void ASurface::begin()
 {
     glColor4ub(255, 255, 255, alpha);
-    glEnable(GL_BLEND);
-    glBlendFunc(sourceBlendFactor, destinationBlendFactor);
-    glEnable(GL_TEXTURE_2D);
-    glDisable(GL_LIGHTING);
-
-    glBindTexture(GL_TEXTURE_2D, textureID);
-    glDisable(GL_DEPTH_TEST);
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glOrtho(0,window->getWidth(),0,window->getHeight(),-100,100);
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
+    ARenderState::enable(GL_BLEND);
+    ARenderState::blendFunc(sourceBlendFactor, destinationBlendFactor);
+    ARenderState::enable(GL_TEXTURE_2D);
+    ARenderState::disable(GL_LIGHTING);
+    ARenderState::bindTexture(textureID);
 
+    ARenderState::begin2D(window->getWidth(), window->getHeight());
+
+    ARenderState::countDrawCall();
     glBegin(GL_QUADS);
 }
 
@@ -152,11 +196,7 @@ void ASurface::end()
 {
     glEnd();
 
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
-    glEnable(GL_DEPTH_TEST);
+    ARenderState::end2D();
 }
 
 //-----------------------------------------------------------------------------
@@ -174,10 +214,8 @@ void ASurface::draw(int x, int y, ARectangle source)
 
 void ASurface::draw(ARectangle target, ARectangle source)
 {
-    float x1 = (float) source.x / (float) textureWidth;
-    float y1 = (float) source.y / (float) textureHeight;
-    float x2 = (float) (source.x + source.width) / (float) textureWidth;
-    float y2 = (float) (source.y + source.height) / (float) textureHeight;
+    float x1, y1, x2, y2;
+    getTexCoords(source, &x1, &y1, &x2, &y2);
 
     glTexCoord2f(x1, y2);
     glVertex2d(target.x, target.y + target.height);
@@ -192,6 +230,18 @@ void ASurface::draw(ARectangle target, ARectangle source)
     glVertex2d(target.x, target.y);
 }
 
+//-----------------------------------------------------------------------------
+// texture coordinates of the rectangle
+//-----------------------------------------------------------------------------
+
+void ASurface::getTexCoords(ARectangle source, float *x1, float *y1, float *x2, float *y2)
+{
+    *x1 = (float) (originX + source.x) / (float) pageWidth;
+    *y1 = (float) (originY + source.y) / (float) pageHeight;
+    *x2 = (float) (originX + source.x + source.width) / (float) pageWidth;
+    *y2 = (float) (originY + source.y + source.height) / (float) pageHeight;
+}
+
 //-----------------------------------------------------------------------------
 // blend function
 //-----------------------------------------------------------------------------
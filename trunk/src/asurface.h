@@ -34,6 +34,8 @@
 
 #include <GL/gl.h>
 #include "awindow.h"
+#include "aatlas.h"
+#include "atexturemanager.h"
 
 /**
  * @namespace astral3d Astral3D namespace.
@@ -72,6 +74,12 @@ class ASurface
         int     textureWidth;
         int     textureHeight;
 
+        int     originX;        // position of the image in the texture
+        int     originY;
+        int     pageWidth;      // size of the whole texture (atlas page)
+        int     pageHeight;
+        bool    ownTexture;     // false if the texture belongs to an atlas
+
         GLenum sourceBlendFactor;
         GLenum destinationBlendFactor;
 
@@ -95,6 +103,17 @@ class ASurface
          */
         ASurface(char *imageFileName, AWindow *window, unsigned int alpha = 0);
 
+        /**
+         * Constructor.
+         * @param atlas Built atlas with the image
+         * @param image Index of the image in the atlas
+         * @param window Window the surface is associated to
+         * @param alpha Transparency of the console (0 to 255 where 255 is full transparent)
+         * @throw ATextureException
+         * @throw ANullPointerException
+         */
+        ASurface(AAtlas *atlas, int image, AWindow *window, unsigned int alpha = 0);
+
         /**
          * Destructor.
          * Calls ASurface::destroy method.
@@ -115,6 +134,17 @@ class ASurface
          */
         void loadImage(char *imageFileName);
 
+        /**
+         * Uses the image from the atlas.
+         * Source rectangles are still given in pixels of the image, the
+         * texture belongs to the atlas.
+         * @param atlas Built atlas with the image
+         * @param image Index of the image in the atlas
+         * @throw ATextureException
+         * @throw ANullPointerException
+         */
+        void loadImage(AAtlas *atlas, int image);
+
         /**
          * Sets the window.
          * Sets the window for the surface.
@@ -196,6 +226,16 @@ class ASurface
          */
         void draw(ARectangle target, ARectangle source);
 
+        /**
+         * Returns texture coordinates of the rectangle.
+         * @param source Rectangle of the image (in pixels)
+         * @param x1 Left texture coordinate
+         * @param y1 Bottom texture coordinate
+         * @param x2 Right texture coordinate
+         * @param y2 Top texture coordinate
+         */
+        void getTexCoords(ARectangle source, float *x1, float *y1, float *x2, float *y2);
+
 
         /**
          * Returns texture ID.
@@ -204,12 +244,12 @@ class ASurface
         GLuint        getTextureID()      { return textureID; }
         /**
          * Returns texture width.
-         * @return Texture width
+         * @return Texture width (width of the image for images of an atlas)
          */
         int           getTextureWidth()   { return textureWidth; }
         /**
          * Returns texture height.
-         * @return Texture height
+         * @return Texture height (height of the image for images of an atlas)
          */
         int           getTextureHeight()  { return textureHeight; }
         /**
@@ -217,6 +257,16 @@ class ASurface
          * @return Alpha value
          */
         unsigned char getAlpha()          { return alpha;}
+        /**
+         * Returns source blend factor.
+         * @return Source factor of the blend function
+         */
+        GLenum        getSourceBlendFactor()      { return sourceBlendFactor; }
+        /**
+         * Returns destination blend factor.
+         * @return Destination factor of the blend function
+         */
+        GLenum        getDestinationBlendFactor() { return destinationBlendFactor; }
         /**
          * Returns associated window.
          * @return Window the surface is associated to
@@ -28,6 +28,13 @@ namespace astral3d {
 
 AText2D::AText2D(char *filename, int translate, int windowW, int windowH, int fontW, int fontH, int charW, int charH)
 {
+    texture = 0;
+    ownTexture = true;
+    batching = 0;
+    colorSet = colorRead = false;
+    buildGlyphs();
+    setMapping(0.0f, 0.0f, 1.0f, 1.0f);
+
     build(filename, translate, windowW, windowH, fontW, fontH, charW, charH);
 }
 
@@ -49,14 +56,71 @@ AText2D *AText2D::build(char *filename, int translate,
     this->sizeWidth = charW;
     this->sizeHeight = charH;
 
-    if(!loadTexture(filename, &(this->texture)))
+    if(!(this->texture = ATextureManager::load(filename, false)))
     {
         throw ATextureException("AText2D *AText2D::build(char *filename, int translate, int windowW, int windowH, int fontW, int fontH, int charW, int charH)");
     }
 
+    this->ownTexture = true;
+    setMapping(0.0f, 0.0f, 1.0f, 1.0f);
+
+    return this;
+}
+
+//-----------------------------------------------------------------------------
+//  builds the font from the atlas
+//-----------------------------------------------------------------------------
+
+AText2D *AText2D::build(AAtlas *atlas, int image, int translate,
+                                        int windowW, int windowH,
+                                        int fontW, int fontH,
+                                        int charW, int charH)
+{
+    if(!atlas)
+    {
+        throw ANullPointerException("AText2D *AText2D::build(AAtlas *atlas, int image, int translate, int windowW, int windowH, int fontW, int fontH, int charW, int charH)");
+    }
+
+    if(!atlas->getTexture(image))
+    {
+        stringstream foo;
+        foo << "AText2D::build("<<atlas<<", "<<image<<", "<<translate<<", "<<windowW<<", "<<windowH<<", "<<fontW<<", "<<fontH<<", "<<charW<<", "<<charH<<")";
+        setAstral3DError("The atlas isn't built or doesn't contain the image", foo.str(), "AAtlas::getTexture");
+
+        throw ATextureException("AText2D *AText2D::build(AAtlas *atlas, int image, int translate, int windowW, int windowH, int fontW, int fontH, int charW, int charH)");
+    }
+
+    this->windowWidth = windowW;
+    this->windowHeight = windowH;
+    this->translate = translate;
+    this->width = (float)1.0 / (fontW/charW);
+    this->height = (float)1.0 / (fontH/charH);
+    this->charsInLine = (int) fontW / charW;
+    this->sizeWidth = charW;
+    this->sizeHeight = charH;
+
+    this->texture = atlas->getTexture(image);
+    this->ownTexture = false;
+
+    double offset[2], scale[2];
+    atlas->getMapping(image, offset, scale);
+    setMapping((float) offset[0], (float) offset[1], (float) scale[0], (float) scale[1]);
+
     return this;
 }
 
+//-----------------------------------------------------------------------------
+//  sets the position of the font in the texture
+//-----------------------------------------------------------------------------
+
+void AText2D::setMapping(float offsetU, float offsetV, float scaleU, float scaleV)
+{
+    texOffset[0] = offsetU;
+    texOffset[1] = offsetV;
+    texScale[0] = scaleU;
+    texScale[1] = scaleV;
+}
+
 //-----------------------------------------------------------------------------
 //  nacteni retezce popisujici font ze souboru
 //-----------------------------------------------------------------------------
@@ -99,82 +163,163 @@ string AText2D::loadString(char *filename)
 
 void AText2D::print(GLint x, GLint y, const char *str, ...)
 {
-    char buf[256];
-
     va_list list;
 
     if(str == NULL)
         return;
 
-    va_start(list, str);
-    vsprintf(buf, str, list);
-    va_end(list);
+    if(formatBuffer.size() < 256)
+        formatBuffer.resize(256);
+
+    // the buffer grows until the whole text fits in it
+    while(true)
+    {
+        va_start(list, str);
+        int length = vsnprintf(&formatBuffer[0], formatBuffer.size(), str, list);
+        va_end(list);
 
-    this->print(x, y, this->sizeWidth, this->sizeHeight, buf);
+        if(length >= 0 && (unsigned int) length < formatBuffer.size())
+            break;
+
+        // older C libraries return -1 instead of the needed length
+        formatBuffer.resize(length >= 0 ? length + 1 : formatBuffer.size() * 2);
+    }
+
+    printText(x, y, &formatBuffer[0]);
 }
 
 //-----------------------------------------------------------------------------
-//  obdoba funkce printf pro vypis textu
+//  vypis textu bez formatovani
 //-----------------------------------------------------------------------------
 
-void AText2D::print(GLint x, GLint y, int sizeW, int sizeH, const char *str, ...)
+void AText2D::printText(GLint x, GLint y, const char *text)
 {
-    char buf[256];
+    if(text == NULL)
+        return;
 
-    va_list list;
+    addText(x, y, this->sizeWidth, this->sizeHeight, text);
 
-    if(str == NULL)
-        return;
+    if(batching == 0)
+        flush();
+}
 
-    va_start(list, str);
-    vsprintf(buf, str, list);
-    va_end(list);
-
-    glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
-    glBlendFunc(GL_SRC_ALPHA, GL_ONE);
-    glEnable(GL_BLEND);
-    glEnable(GL_TEXTURE_2D);
-    glDisable(GL_LIGHTING);
-
-    glBindTexture(GL_TEXTURE_2D, this->texture);
-    glDisable(GL_DEPTH_TEST);
-    glMatrixMode(GL_PROJECTION);
-    glPushMatrix();
-    glLoadIdentity();
-    glOrtho(0,this->windowWidth,0,this->windowHeight,-100,100);
-    glMatrixMode(GL_MODELVIEW);
-    glPushMatrix();
-    glLoadIdentity();
-    glTranslated(x,y,0);
-
-    for(unsigned int i = 0; i < strlen(buf); i++)
+//-----------------------------------------------------------------------------
+//  lookup table of the characters
+//-----------------------------------------------------------------------------
+
+void AText2D::buildGlyphs()
+{
+    for(int i = 0; i < 256; i++)
+        glyphs[i] = -1;
+
+    // the first occurrence is used as find() did
+    for(int i = (int) strFont.size() - 1; i >= 0; i--)
+        glyphs[(unsigned char) strFont[i]] = i;
+}
+
+//-----------------------------------------------------------------------------
+//  adds the quads of the characters
+//-----------------------------------------------------------------------------
+
+void AText2D::addText(GLint x, GLint y, int sizeW, int sizeH, const char *text)
+{
+    AGlyphVertex vertex;
+    vertex.z = 0.0f;
+
+    // the text used the current color before, it is read once per batch
+    if(!colorSet && !colorRead)
     {
-        int znak = this->strFont.find(buf[i], 0);
+        GLfloat current[4];
+        glGetFloatv(GL_CURRENT_COLOR, current);
+
+        for(int i = 0; i < 4; i++)
+            color[i] = (GLubyte) (current[i] * 255.0f + 0.5f);
+
+        colorRead = true;
+    }
+
+    vertex.r = color[0];
+    vertex.g = color[1];
+    vertex.b = color[2];
+    vertex.a = color[3];
+
+    for(int i = 0; text[i] != '\0'; i++, x += translate)
+    {
+        int znak = glyphs[(unsigned char) text[i]];
+
+        // characters missing in the font are skipped
+        if(znak < 0)
+            continue;
 
         float cx = this->width*(znak % this->charsInLine);
         float cy = this->height*(znak / this->charsInLine);
 
-        glBegin(GL_QUADS);
-            glTexCoord2f(cx, 1.0-(cy+height));
-            glVertex2f(0.0, 0.0);
+        // coordinates in the font image mapped to the texture (the identity
+        // for the font's own texture)
+        float u1 = texOffset[0] + texScale[0] * cx;
+        float u2 = texOffset[0] + texScale[0] * (cx+width);
+        float v1 = texOffset[1] + texScale[1] * (float) (1.0-(cy+height));
+        float v2 = texOffset[1] + texScale[1] * (float) (1.0-cy);
+
+        vertex.u = u1;
+        vertex.v = v1;
+        vertex.x = x;
+        vertex.y = y;
+        vertices.push_back(vertex);
+
+        vertex.u = u2;
+        vertex.x = x + sizeW;
+        vertices.push_back(vertex);
+
+        vertex.v = v2;
+        vertex.y = y + sizeH;
+        vertices.push_back(vertex);
+
+        vertex.u = u1;
+        vertex.x = x;
+        vertices.push_back(vertex);
+    }
+}
+
+//-----------------------------------------------------------------------------
+//  draws all collected quads
+//-----------------------------------------------------------------------------
+
+void AText2D::flush()
+{
+    // the next batch reads the current color again
+    colorRead = false;
 
-            glTexCoord2f(cx+width, 1.0-(cy+height));
-            glVertex2f(sizeW, 0.0);
+    if(vertices.empty())
+        return;
 
-            glTexCoord2f(cx+width, 1.0-cy);
-            glVertex2f(sizeW, sizeH);
+    APROFILE("text");
 
-            glTexCoord2f(cx, 1.0-cy);
-            glVertex2f(0.0, sizeH);
-        glEnd();
-        glTranslated(translate, 0, 0);
-    }
+    ARenderState::polygonMode(GL_FILL);
+    ARenderState::blendFunc(GL_SRC_ALPHA, GL_ONE);
+    ARenderState::enable(GL_BLEND);
+    ARenderState::enable(GL_TEXTURE_2D);
+    ARenderState::disable(GL_LIGHTING);
+    ARenderState::bindTexture(this->texture);
+
+    ARenderState::begin2D(this->windowWidth, this->windowHeight);
+
+    glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+    glInterleavedArrays(GL_T2F_C4UB_V3F, 0, &vertices[0]);
+
+    ARenderState::countDrawCall();
+    glDrawArrays(GL_QUADS, 0, vertices.size());
+
+    glPopClientAttrib();
+
+    // current color is undefined after the color array, we leave there
+    // the color of the last character
+    const AGlyphVertex &last = vertices.back();
+    glColor4ub(last.r, last.g, last.b, last.a);
+
+    ARenderState::end2D();
 
-    glMatrixMode(GL_PROJECTION);
-    glPopMatrix();
-    glMatrixMode(GL_MODELVIEW);
-    glPopMatrix();
-    glEnable(GL_DEPTH_TEST);
+    vertices.clear();
 }
 
 } // namespace astral3d
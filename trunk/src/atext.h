@@ -34,20 +34,36 @@
 #include <string>
 #include <iostream>
 #include <cstdarg>
+#include <cstdio>
 #include <fstream>
 #include <cstring>
 #include <cctype>
 #include <sstream>
+#include <vector>
 
 #include "atexture.h"
+#include "atexturemanager.h"
+#include "aatlas.h"
 #include "aerror.h"
+#include "aprofiler.h"
 #include "aexceptions.h"
+#include "arenderstate.h"
 
 /**
  * @namespace astral3d Astral3D namespace.
  */
 namespace astral3d {
 
+/**
+ * Vertex of the text batch (GL_T2F_C4UB_V3F format).
+ */
+struct AGlyphVertex
+{
+    GLfloat u, v;           // texture coordinates
+    GLubyte r, g, b, a;     // color
+    GLfloat x, y, z;        // position
+};
+
 //-----------------------------------------------------------------------------
 //  trida AText2D
 //-----------------------------------------------------------------------------
@@ -60,6 +76,9 @@ class AText2D
 {
     private:
         GLuint texture;         // font texture
+        bool ownTexture;        // false if the texture belongs to an atlas
+        float texOffset[2];     // position of the font in the texture
+        float texScale[2];      // size of the font in the texture
         int windowWidth;        // window width
         int windowHeight;       // window height
         int sizeWidth;          // character width when drawing
@@ -70,14 +89,31 @@ class AText2D
         int charsInLine;        // number of characters in o row
         std::string strFont;    // string describing a bitmap font
 
-        void print(GLint x, GLint y, int sizeW, int sizeH, const char *str, ...);
+        int glyphs[256];        // position of the characters in the font (-1 if missing)
+
+        std::vector<AGlyphVertex> vertices;     // quads waiting for drawing
+        std::vector<char> formatBuffer;         // buffer for formatting the text
+        int batching;                           // nesting of beginBatch calls
+
+        GLubyte color[4];       // color of the text
+        bool colorSet;          // false if the current OpenGL color is used
+        bool colorRead;         // current OpenGL color is read for this batch
+
+        // adds the quads of the text
+        void addText(GLint x, GLint y, int sizeW, int sizeH, const char *text);
+
+        // creates the lookup table of the characters
+        void buildGlyphs();
+
+        // sets the position of the font in the texture
+        void setMapping(float offsetU, float offsetV, float scaleU, float scaleV);
 
     public:
 
         /**
          * Constructor.
          */
-        AText2D() {}
+        AText2D() { texture = 0; ownTexture = true; batching = 0; colorSet = colorRead = false; buildGlyphs(); setMapping(0.0f, 0.0f, 1.0f, 1.0f); }
 
         /**
          * Destructor.
@@ -115,6 +151,24 @@ class AText2D
          * @throw ATextureException
          */
         AText2D *build(char *filename, int translate, int windowW, int windowH, int fontW, int fontH, int charW, int charH);
+        /**
+         * Builds the font from the atlas.
+         * The font image is taken from the built atlas, the texture belongs
+         * to the atlas.
+         * @param atlas Built atlas with the font image
+         * @param image Index of the font image in the atlas
+         * @param translate Text translation
+         * @param windowW Width of the main window
+         * @param WindowH Height of the main window
+         * @param fontW Width of the image with the font
+         * @param fontH Height of the image with the font
+         * @param charW Width of the character in the image
+         * @param charH Height of the character in the image
+         * @return Pointer to this instance
+         * @throw ATextureException
+         * @throw ANullPointerException
+         */
+        AText2D *build(AAtlas *atlas, int image, int translate, int windowW, int windowH, int fontW, int fontH, int charW, int charH);
         /**
          * Sets the string describing the font.
          * This method sets the text description of the font. The text is read
@@ -122,7 +176,7 @@ class AText2D
          * @param str Text description of the font
          * @see loadString
          */
-        void setString(const std::string &str) { this->strFont = str; }
+        void setString(const std::string &str) { this->strFont = str; buildGlyphs(); }
         /**
          * Loads font description from the file.
          * This method sets the text description of the font. String describing
@@ -152,6 +206,61 @@ class AText2D
          */
         void print(GLint x, GLint y, const char *str, ...);
 
+        /**
+         * Prints the text without formatting.
+         * This method works as AText2D::print but the text isn't formatted
+         * and it can be of any length.
+         * @param x x-position of the text from the left (in pixels)
+         * @param y y-position of the text from the bottom (in pixels)
+         * @param text Text to be printed
+         */
+        void printText(GLint x, GLint y, const char *text);
+
+        /**
+         * Starts collecting the text.
+         * Text printed after this call is only stored and it is drawn with
+         * one draw call by AText2D::endBatch. Calls can be nested, the text
+         * is drawn by the last AText2D::endBatch. Without AText2D::setColor
+         * the current OpenGL color is read once for the whole batch.
+         * @see endBatch
+         */
+        void beginBatch() { batching++; }
+
+        /**
+         * Draws the collected text.
+         * @see beginBatch
+         */
+        void endBatch() { if(batching > 0 && --batching == 0) flush(); }
+
+        /**
+         * Draws the collected text now.
+         * This method draws all quads collected since the last draw.
+         */
+        void flush();
+
+        /**
+         * Sets the color of the text.
+         * Without this call the current OpenGL color is used. The color is
+         * stored in the vertices, so the text of different colors can be
+         * drawn in one batch.
+         * @param r Red
+         * @param g Green
+         * @param b Blue
+         * @param a Alpha
+         */
+        void setColor(GLubyte r, GLubyte g, GLubyte b, GLubyte a = 255)
+        {
+            color[0] = r; color[1] = g; color[2] = b; color[3] = a;
+            colorSet = true;
+        }
+
+        /**
+         * Uses the current OpenGL color for the text.
+         * The color is read again by the next printed text.
+         * @see setColor
+         */
+        void resetColor() { colorSet = colorRead = false; }
+
         /**
          * Returns translation.
          * @return Translation
@@ -200,7 +309,11 @@ void AText2D::setSize(int sizeW, int sizeH, int translate)
 
 void AText2D::destroy()
 {
-    deleteTexture(&(this->texture));
+    // the atlas deletes its pages itself
+    if(this->ownTexture)
+        deleteTexture(&(this->texture));
+    else
+        this->texture = 0;
 }
 
 } // namespace astral3d
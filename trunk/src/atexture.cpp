@@ -17,7 +17,19 @@
  * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
  *****************************************************************************/
 
+#ifdef __SSE2__
+    #include <emmintrin.h>
+#endif
+
 #include "atexture.h"
+#include "atexturemanager.h"
+#include "atexturecache.h"
+#include "atexturestreamer.h"
+#include "atextureuploader.h"
+#include "atexturecompressor.h"
+#include "aextensions.h"
+#include "ajobsystem.h"
+#include "aprofiler.h"
 
 using namespace std;
 namespace astral3d {
@@ -52,33 +64,122 @@ int fileType(char *filename)
 }
 
 //-----------------------------------------------------------------------------
-// pomocna funkce pro transformaci pixelu pro formaty BMP a TGA
+// number of channels of the surface, 32-bit surfaces have alpha
 //-----------------------------------------------------------------------------
 
-unsigned char *transform(SDL_Surface *surface)
+static int getChannels(SDL_Surface *surface)
 {
-    unsigned int len = surface->w * surface->h * 3;
-    int i, j, k, l = 0;
+    return (surface->format && surface->format->BytesPerPixel == 4) ? 4 : 3;
+}
 
-    unsigned char *tmp = new unsigned char[len];
-    if(tmp == NULL)
-        return NULL;
+//-----------------------------------------------------------------------------
+// copies the BGRA rows in the reverse order as RGBA
+//-----------------------------------------------------------------------------
+
+static void swizzleRowsAlpha(const unsigned char *src, int pitch, int width, int height, unsigned char *dst)
+{
+    int bytes = width * 4;
+
+#ifdef __SSE2__
+    const __m128i keep = _mm_set1_epi32(0xFF00FF00);
+    const __m128i low = _mm_set1_epi32(0x000000FF);
+#endif
+
+    for(int y = 0; y < height; y++)
+    {
+        const unsigned char *s = src + (height - 1 - y) * pitch;
+        unsigned char *d = dst + y * bytes;
+        int x = 0;
+
+#ifdef __SSE2__
+        // red and blue of 4 pixels are exchanged by shifts
+        for(; x + 16 <= bytes; x += 16)
+        {
+            __m128i v = _mm_loadu_si128((const __m128i *) (s + x));
+            __m128i r = _mm_and_si128(_mm_srli_epi32(v, 16), low);
+            __m128i b = _mm_slli_epi32(_mm_and_si128(v, low), 16);
+
+            v = _mm_or_si128(_mm_and_si128(v, keep), _mm_or_si128(r, b));
+            _mm_storeu_si128((__m128i *) (d + x), v);
+        }
+#endif
+
+        for(; x < bytes; x += 4)
+        {
+            d[x] = s[x + 2];
+            d[x + 1] = s[x + 1];
+            d[x + 2] = s[x];
+            d[x + 3] = s[x + 3];
+        }
+    }
+}
 
-    unsigned char *foo = (unsigned char*)surface->pixels;
+//-----------------------------------------------------------------------------
+// copies the BGR rows in the reverse order as RGB
+//-----------------------------------------------------------------------------
 
-    memcpy(tmp, surface->pixels, len);
+static void swizzleRows(const unsigned char *src, int pitch, int width, int height, unsigned char *dst)
+{
+    int bytes = width * 3;
 
+#ifdef __SSE2__
+    // byte i of the result is src[i + 2], src[i] or src[i - 2] by i % 3
+    const __m128i next = _mm_setr_epi8(-1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1);
+    const __m128i same = _mm_setr_epi8(0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0);
+    const __m128i prev = _mm_setr_epi8(0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0, 0, -1, 0);
+#endif
 
-    for (i = surface->w-1; i >=0; i--)
+    for(int y = 0; y < height; y++)
     {
-        for(j = 0; j < surface->h; j++)
+        const unsigned char *s = src + (height - 1 - y) * pitch;
+        unsigned char *d = dst + y * bytes;
+        int x = 0;
+
+#ifdef __SSE2__
+        // the first pixel is swapped below, then 5 pixels per step
+        if(bytes >= 21)
         {
-            for (k = 2; k >= 0; k-- )
+            d[0] = s[2]; d[1] = s[1]; d[2] = s[0];
+
+            for(x = 3; x + 18 <= bytes; x += 15)
             {
-                tmp[l++] = foo[i * surface->h * 3 + j * 3 + k];
+                __m128i a = _mm_loadu_si128((const __m128i *) (s + x + 2));
+                __m128i b = _mm_loadu_si128((const __m128i *) (s + x));
+                __m128i c = _mm_loadu_si128((const __m128i *) (s + x - 2));
+
+                __m128i v = _mm_or_si128(_mm_and_si128(a, next),
+                            _mm_or_si128(_mm_and_si128(b, same), _mm_and_si128(c, prev)));
+
+                _mm_storeu_si128((__m128i *) (d + x), v);
             }
         }
+#endif
+
+        for(; x < bytes; x += 3)
+        {
+            d[x] = s[x + 2];
+            d[x + 1] = s[x + 1];
+            d[x + 2] = s[x];
+        }
     }
+}
+
+//-----------------------------------------------------------------------------
+// pomocna funkce pro transformaci pixelu pro formaty BMP a TGA
+//-----------------------------------------------------------------------------
+
+unsigned char *transform(SDL_Surface *surface)
+{
+    int channels = getChannels(surface);
+
+    unsigned char *tmp = new unsigned char[surface->w * surface->h * channels];
+    if(tmp == NULL)
+        return NULL;
+
+    if(channels == 4)
+        swizzleRowsAlpha((unsigned char*)surface->pixels, surface->pitch, surface->w, surface->h, tmp);
+    else
+        swizzleRows((unsigned char*)surface->pixels, surface->pitch, surface->w, surface->h, tmp);
 
     return tmp;
 }
@@ -127,7 +228,7 @@ bool createTexture(SDL_Surface *Image, GLuint *texture, GLint min, GLint mag, in
 
 
     glGenTextures(1, texture);
-    glBindTexture(GL_TEXTURE_2D, *texture);
+    ARenderState::bindTexture(*texture);
 
     unsigned char *data;
 
@@ -158,12 +259,17 @@ bool createTexture(SDL_Surface *Image, GLuint *texture, GLint min, GLint mag, in
         return false;
     }
 
-    glTexImage2D(GL_TEXTURE_2D, 0, 3, Image->w,Image->h, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
+    // 32-bit images keep their alpha
+    int channels = getChannels(Image);
+    glTexImage2D(GL_TEXTURE_2D, 0, channels, Image->w,Image->h, 0,
+                 channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, data);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag);
 
-    delete data;
+    // the pixels of JPG and PNG belong to the surface
+    if(type == BMP || type == TGA)
+        delete [] data;
 
     return true;
 }
@@ -174,12 +280,30 @@ bool createTexture(SDL_Surface *Image, GLuint *texture, GLint min, GLint mag, in
 
 bool loadTextureMipMap(char *filename, GLuint *texture)
 {
+    // the cached mipmaps are uploaded without decoding the image
+    if(ATextureCache::isEnabled())
+    {
+        GLint maxSize = 0;
+        glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+        ATextureData data;
+        if(decodeTextureMipMap(filename, &data, maxSize))
+            return uploadTextureMipMap(data, texture);
+
+        stringstream foo;
+        foo << "loadTextureMipMap(\""<<filename<<"\", "<<texture<<")";
+        setAstral3DError(data.error, foo.str(), "decodeTextureMipMap");
+        return false;
+    }
+
     SDL_Surface *Image = NULL;
 
     if((Image = IMG_Load(filename)))
     {
         int type = fileType(filename);
-        return createTextureMipMap(Image, texture, type);
+        bool created = createTextureMipMap(Image, texture, type);
+        SDL_FreeSurface(Image);
+        return created;
     }
 
     if (Image)
@@ -194,6 +318,9 @@ bool loadTextureMipMap(char *filename, GLuint *texture)
     return false;
 }
 
+// builds the levels from the RGB or RGBA image
+static void buildTextureMipMap(const unsigned char *pixels, int w, int h, int channels, ATextureData *data, int maxSize);
+
 //-----------------------------------------------------------------------------
 // vytvoreni textury z SDL povrchu
 //-----------------------------------------------------------------------------
@@ -211,9 +338,6 @@ bool createTextureMipMap(SDL_Surface *Image, GLuint *texture, int type)
         return false;
     }
 
-    glGenTextures(1, texture);
-    glBindTexture(GL_TEXTURE_2D, *texture);
-
     unsigned char *data;
 
     if(type == BMP || type == TGA)
@@ -244,25 +368,535 @@ bool createTextureMipMap(SDL_Surface *Image, GLuint *texture, int type)
         return false;
     }
 
-    gluBuild2DMipmaps(GL_TEXTURE_2D, 3, Image->w, Image->h, GL_RGB,
-                      GL_UNSIGNED_BYTE, data);
+    // the levels are built on the CPU as decodeTextureMipMap builds them
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+    ATextureData levels;
+    buildTextureMipMap(data, Image->w, Image->h, getChannels(Image), &levels, maxSize);
+
+    if(type == BMP || type == TGA)
+        delete [] data;
+
+    if(ATextureCompressor::isEnabled())
+        ATextureCompressor::compress(&levels);
+
+    return uploadTextureMipMap(levels, texture);
+}
+
+//-----------------------------------------------------------------------------
+// largest power of two not bigger than the value (as gluBuild2DMipmaps)
+//-----------------------------------------------------------------------------
+
+static int nearestPower(int value)
+{
+    int power = 1;
+    while(power * 2 <= value)
+        power *= 2;
+
+    return power;
+}
+
+//-----------------------------------------------------------------------------
+// scales the RGB or RGBA image, every pixel is the average of the pixels
+// it covers
+//-----------------------------------------------------------------------------
+
+static void scaleImage(const unsigned char *src, int w, int h, unsigned char *dst, int nw, int nh, int channels = 3)
+{
+    for(int y = 0; y < nh; y++)
+    {
+        int y0 = y * h / nh;
+        int y1 = max(y0 + 1, (y + 1) * h / nh);
+
+        for(int x = 0; x < nw; x++)
+        {
+            int x0 = x * w / nw;
+            int x1 = max(x0 + 1, (x + 1) * w / nw);
+
+            unsigned int sum[4] = { 0, 0, 0, 0 };
+            for(int sy = y0; sy < y1; sy++)
+            {
+                const unsigned char *p = src + (sy * w + x0) * channels;
+                for(int sx = x0; sx < x1; sx++, p += channels)
+                {
+                    for(int c = 0; c < channels; c++)
+                        sum[c] += p[c];
+                }
+            }
+
+            unsigned int count = (x1 - x0) * (y1 - y0);
+            unsigned char *d = dst + (y * nw + x) * channels;
+            for(int c = 0; c < channels; c++)
+                d[c] = (unsigned char) ((sum[c] + count / 2) / count);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// sums two rows of bytes into 16-bit values
+//-----------------------------------------------------------------------------
+
+static void sumRows(const unsigned char *a, const unsigned char *b, int bytes, unsigned short *sum)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    const __m128i zero = _mm_setzero_si128();
+    for(; i + 16 <= bytes; i += 16)
+    {
+        __m128i va = _mm_loadu_si128((const __m128i *) (a + i));
+        __m128i vb = _mm_loadu_si128((const __m128i *) (b + i));
+
+        __m128i low = _mm_add_epi16(_mm_unpacklo_epi8(va, zero), _mm_unpacklo_epi8(vb, zero));
+        __m128i high = _mm_add_epi16(_mm_unpackhi_epi8(va, zero), _mm_unpackhi_epi8(vb, zero));
+
+        _mm_storeu_si128((__m128i *) (sum + i), low);
+        _mm_storeu_si128((__m128i *) (sum + i + 8), high);
+    }
+#endif
+
+    for(; i < bytes; i++)
+        sum[i] = a[i] + b[i];
+}
+
+//-----------------------------------------------------------------------------
+// level of the mipmap built by halveRows
+//-----------------------------------------------------------------------------
+
+struct AMipLevel
+{
+    const unsigned char *source;    // previous level
+    int width;                      // size of the previous level (even)
+    int height;
+    int channels;                   // 3 or 4
+    unsigned char *destination;     // half width and half height
+};
+
+//-----------------------------------------------------------------------------
+// averages 2x2 pixels of the previous level for the range of rows, the
+// result is the same as scaleImage gives
+//-----------------------------------------------------------------------------
+
+static void halveRows(int begin, int end, void *data)
+{
+    AMipLevel *level = (AMipLevel *) data;
+
+    int bytes = level->width * level->channels;
+    int half = bytes / 2;
+    vector<unsigned short> sum(bytes);
+
+    for(int y = begin; y < end; y++)
+    {
+        const unsigned char *a = level->source + 2 * y * bytes;
+        sumRows(a, a + bytes, bytes, &sum[0]);
+
+        unsigned char *d = level->destination + y * half;
+        if(level->channels == 4)
+        {
+            for(int x = 0; x < half; x += 4)
+            {
+                const unsigned short *p = &sum[2 * x];
+                d[x]     = (unsigned char) ((p[0] + p[4] + 2) >> 2);
+                d[x + 1] = (unsigned char) ((p[1] + p[5] + 2) >> 2);
+                d[x + 2] = (unsigned char) ((p[2] + p[6] + 2) >> 2);
+                d[x + 3] = (unsigned char) ((p[3] + p[7] + 2) >> 2);
+            }
+        }
+        else
+        {
+            for(int x = 0; x < half; x += 3)
+            {
+                const unsigned short *p = &sum[2 * x];
+                d[x]     = (unsigned char) ((p[0] + p[3] + 2) >> 2);
+                d[x + 1] = (unsigned char) ((p[1] + p[4] + 2) >> 2);
+                d[x + 2] = (unsigned char) ((p[2] + p[5] + 2) >> 2);
+            }
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// builds the levels from the RGB or RGBA image, no OpenGL calls
+//-----------------------------------------------------------------------------
+
+static void buildTextureMipMap(const unsigned char *pixels, int w, int h, int channels, ATextureData *data, int maxSize)
+{
+    int width = nearestPower(w);
+    int height = nearestPower(h);
+    while(maxSize > 0 && (width > maxSize || height > maxSize))
+    {
+        width = max(1, width / 2);
+        height = max(1, height / 2);
+    }
+
+    // size of all levels
+    unsigned int size = 0;
+    int levels = 0;
+    for(int lw = width, lh = height; ; lw = max(1, lw / 2), lh = max(1, lh / 2))
+    {
+        size += lw * lh * channels;
+        levels++;
+        if(lw == 1 && lh == 1)
+            break;
+    }
+
+    data->pixels.resize(size);
+    data->width = width;
+    data->height = height;
+    data->levels = levels;
+    data->channels = channels;
+    data->format = 0;
+
+    unsigned char *level = &data->pixels[0];
+    if(width == w && height == h)
+        memcpy(level, pixels, w * h * channels);
+    else
+        scaleImage(pixels, w, h, level, width, height, channels);
+
+    // every level is the average of 2x2 pixels of the previous one, rows
+    // of big levels are split among the threads of AJobSystem
+    int lw = width, lh = height;
+    while(lw > 1 || lh > 1)
+    {
+        int nw = max(1, lw / 2);
+        int nh = max(1, lh / 2);
+        unsigned char *next = level + lw * lh * channels;
+
+        if(lw > 1 && lh > 1)
+        {
+            AMipLevel mip;
+            mip.source = level;
+            mip.width = lw;
+            mip.height = lh;
+            mip.channels = channels;
+            mip.destination = next;
+
+            if(nh >= 128)
+                AJobSystem::parallelFor(0, nh, halveRows, &mip, 32);
+            else
+                halveRows(0, nh, &mip);
+        }
+        else
+        {
+            scaleImage(level, lw, lh, next, nw, nh, channels);
+        }
+
+        level = next;
+        lw = nw;
+        lh = nh;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// decodes the texture with mipmaps, no OpenGL calls
+//-----------------------------------------------------------------------------
+
+bool decodeTextureMipMap(char *filename, ATextureData *data, int maxSize)
+{
+    data->pixels.clear();
+    data->width = data->height = data->levels = 0;
+
+    // mipmaps built by an earlier run
+    if(ATextureCache::read(filename, data, maxSize))
+        return true;
+
+    SDL_Surface *Image = IMG_Load(filename);
+    if(!Image)
+    {
+        data->error = "Can't open file with the texture";
+        return false;
+    }
+
+    int type = fileType(filename);
+    int channels = getChannels(Image);
+    unsigned char *pixels = NULL;
+
+    if(type == BMP || type == TGA)
+    {
+        pixels = transform(Image);
+    }
+    else if(type == JPG || type == PNG)
+    {
+        pixels = new unsigned char[Image->w * Image->h * channels];
+        memcpy(pixels, Image->pixels, Image->w * Image->h * channels);
+    }
+
+    int w = Image->w;
+    int h = Image->h;
+    SDL_FreeSurface(Image);
+
+    if(!pixels)
+    {
+        data->error = "Unknown texture type (BMP, TGA, JPG and PNG are allowed)";
+        return false;
+    }
+
+    buildTextureMipMap(pixels, w, h, channels, data, maxSize);
+
+    delete [] pixels;
+
+    // the compressed levels are stored in the cache
+    if(ATextureCompressor::isEnabled())
+        ATextureCompressor::compress(data);
+
+    ATextureCache::write(filename, *data, maxSize);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// size of one level
+//-----------------------------------------------------------------------------
+
+unsigned int getTextureLevelSize(GLenum format, int channels, int width, int height)
+{
+    // 4x4 blocks of 8 or 16 bytes
+    if(format == GL_COMPRESSED_RGB_S3TC_DXT1_EXT)
+        return ((width + 3) / 4) * ((height + 3) / 4) * 8;
+    if(format == GL_COMPRESSED_RGBA_S3TC_DXT5_EXT)
+        return ((width + 3) / 4) * ((height + 3) / 4) * 16;
+
+    return width * height * channels;
+}
+
+//-----------------------------------------------------------------------------
+// uploads one level
+//-----------------------------------------------------------------------------
+
+void uploadTextureLevel(const ATextureData &data, int level, const void *pixels)
+{
+    int w = max(1, data.width >> level);
+    int h = max(1, data.height >> level);
+
+    // the storage of compressed levels is allocated as the uncompressed one
+    if(data.format && pixels)
+        aglCompressedTexImage2DARB(GL_TEXTURE_2D, level, data.format, w, h, 0, data.getLevelSize(level), pixels);
+    else
+        glTexImage2D(GL_TEXTURE_2D, level, data.format ? data.format : data.channels, w, h, 0,
+                     data.channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, pixels);
+}
+
+//-----------------------------------------------------------------------------
+// creates the texture from the decoded levels
+//-----------------------------------------------------------------------------
+
+bool uploadTextureMipMap(const ATextureData &data, GLuint *texture)
+{
+    if(data.levels <= 0 || data.pixels.empty())
+    {
+        stringstream foo;
+        foo << "uploadTextureMipMap("<<&data<<", "<<texture<<")";
+        setAstral3DError("The texture isn't decoded", foo.str(), "decodeTextureMipMap");
+        return false;
+    }
+
+    glGenTextures(1, texture);
+    ARenderState::bindTexture(*texture);
+
+    // rows of small levels aren't aligned to four bytes
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    const unsigned char *level = &data.pixels[0];
+    for(int i = 0; i < data.levels; i++)
+    {
+        uploadTextureLevel(data, i, level);
+        level += data.getLevelSize(i);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
                     GL_LINEAR_MIPMAP_NEAREST);
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
 
-    delete data;
-
     return true;
 }
 
+//-----------------------------------------------------------------------------
+// RGB copy of the RGBA pixels
+//-----------------------------------------------------------------------------
+
+static unsigned char *removeAlpha(const unsigned char *rgba, int count)
+{
+    unsigned char *rgb = new unsigned char[count * 3];
+    for(int i = 0; i < count; i++)
+    {
+        rgb[i * 3] = rgba[i * 4];
+        rgb[i * 3 + 1] = rgba[i * 4 + 1];
+        rgb[i * 3 + 2] = rgba[i * 4 + 2];
+    }
+
+    return rgb;
+}
+
+//-----------------------------------------------------------------------------
+// pixels of the texture as createTexture uploads them
+//-----------------------------------------------------------------------------
+
+unsigned char *getTextureData(SDL_Surface *Image, int type)
+{
+    if(Image == NULL)
+    {
+        stringstream foo;
+        stringstream bar;
+        foo << "getTextureData("<<Image<<", "<<type<<")";
+        bar << "SDL_Surface is NULL";
+        setAstral3DError("Can't read SDL_Surface structure", foo.str(), bar.str());
+        return NULL;
+    }
+
+    if(type == BMP || type == TGA)
+    {
+        unsigned char *data = transform(Image);
+        if(data == NULL)
+        {
+            stringstream foo;
+            stringstream bar;
+            foo << "getTextureData("<<Image<<", "<<type<<")";
+            bar << "transform("<<Image<<")";
+            setAstral3DError("Can't transform pixel data for BMP/TGA texture", foo.str(), bar.str());
+        }
+        else if(getChannels(Image) == 4)
+        {
+            unsigned char *rgb = removeAlpha(data, Image->w * Image->h);
+            delete [] data;
+            data = rgb;
+        }
+        return data;
+    }
+
+    if(type == JPG || type == PNG)
+    {
+        if(getChannels(Image) == 4)
+            return removeAlpha((unsigned char *) Image->pixels, Image->w * Image->h);
+
+        unsigned int len = Image->w * Image->h * 3;
+        unsigned char *data = new unsigned char[len];
+        memcpy(data, Image->pixels, len);
+        return data;
+    }
+
+    stringstream foo;
+    stringstream bar;
+    foo << "getTextureData("<<Image<<", "<<type<<")";
+    bar << "N/A";
+    setAstral3DError("Unknown texture type (BMP, TGA, JPG and PNG are allowed)", foo.str(), bar.str());
+    return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// conversion of the pixels as it was done before swizzleRows (square
+// images only), for the benchmark
+//-----------------------------------------------------------------------------
+
+static void swizzleColumns(const unsigned char *src, int size, unsigned char *dst)
+{
+    int l = 0;
+    for(int i = size - 1; i >= 0; i--)
+        for(int j = 0; j < size; j++)
+            for(int k = 2; k >= 0; k--)
+                dst[l++] = src[i * size * 3 + j * 3 + k];
+}
+
+//-----------------------------------------------------------------------------
+// benchmark of the conversion and the mipmaps
+//-----------------------------------------------------------------------------
+
+void benchmarkTextureMipMap(ostream &out, int size)
+{
+    size = nearestPower(max(size, 2));
+
+    vector<unsigned char> image(size * size * 3);
+    unsigned int seed = 1;
+    for(unsigned int i = 0; i < image.size(); i++)
+    {
+        seed = seed * 1103515245 + 12345;
+        image[i] = (unsigned char) (seed >> 16);
+    }
+
+    vector<unsigned char> columns(image.size());
+    vector<unsigned char> rows(image.size());
+
+    double start = AProfiler::getTime();
+    swizzleColumns(&image[0], size, &columns[0]);
+    double oldSwizzle = AProfiler::getTime() - start;
+
+    start = AProfiler::getTime();
+    swizzleRows(&image[0], size * 3, size, size, &rows[0]);
+    double newSwizzle = AProfiler::getTime() - start;
+
+    out << "swizzle " << size << "x" << size << ": " << oldSwizzle << " ms by columns, "
+        << newSwizzle << " ms by rows" << (columns == rows ? "" : " (DIFFERENT)") << endl;
+
+    // size of all levels
+    unsigned int bytes = 0;
+    for(int lw = size; lw >= 1; lw /= 2)
+        bytes += lw * lw * 3;
+
+    // levels built by scaleImage
+    ATextureData reference;
+    start = AProfiler::getTime();
+    {
+        reference.pixels.resize(bytes);
+        unsigned char *level = &reference.pixels[0];
+        memcpy(level, &rows[0], rows.size());
+        for(int lw = size; lw > 1; lw /= 2)
+        {
+            scaleImage(level, lw, lw, level + lw * lw * 3, lw / 2, lw / 2);
+            level += lw * lw * 3;
+        }
+    }
+    double oldMipMap = AProfiler::getTime() - start;
+
+    // halveRows in one thread
+    ATextureData serial;
+    start = AProfiler::getTime();
+    {
+        serial.pixels.resize(bytes);
+        unsigned char *level = &serial.pixels[0];
+        memcpy(level, &rows[0], rows.size());
+        for(int lw = size; lw > 1; lw /= 2)
+        {
+            AMipLevel mip;
+            mip.source = level;
+            mip.width = lw;
+            mip.height = lw;
+            mip.channels = 3;
+            mip.destination = level + lw * lw * 3;
+            halveRows(0, lw / 2, &mip);
+            level += lw * lw * 3;
+        }
+    }
+    double serialMipMap = AProfiler::getTime() - start;
+
+    // buildTextureMipMap with the threads of AJobSystem
+    ATextureData parallel;
+    start = AProfiler::getTime();
+    buildTextureMipMap(&rows[0], size, size, 3, &parallel, 0);
+    double parallelMipMap = AProfiler::getTime() - start;
+
+    bool same = reference.pixels == serial.pixels && reference.pixels == parallel.pixels;
+
+    out << "mipmaps " << size << "x" << size << ": " << oldMipMap << " ms by scaleImage, "
+        << serialMipMap << " ms in one thread, " << parallelMipMap << " ms in "
+        << AJobSystem::getThreadCount() << " threads" << (same ? "" : " (DIFFERENT)") << endl;
+}
+
 //-----------------------------------------------------------------------------
 // uvolni texturu z pameti
 //-----------------------------------------------------------------------------
 
 void deleteTexture(GLuint *texture)
 {
+    // shared textures are deleted with the last reference
+    if(ATextureManager::release(*texture))
+        return;
+
+    ATextureStreamer::remove(*texture);
+    ATextureUploader::cancel(*texture);
+    ARenderState::textureDeleted(*texture);
     glDeleteTextures(1, texture);
 }
 
@@ -34,11 +34,16 @@
 
 #include <cstring>
 #include <cctype>
+#include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
+#include <algorithm>
 #include <GL/gl.h>
 #include <GL/glu.h>
 
 #include "aerror.h"
+#include "arenderstate.h"
 
 /**
  * @namespace astral3d Astral3D namespace.
@@ -75,7 +80,9 @@ bool loadTexture(char *filename, GLuint *texture, GLint min=GL_LINEAR, GLint mag
 bool createTexture(SDL_Surface *Image, GLuint *texture, GLint min=GL_LINEAR, GLint mag=GL_LINEAR, int type=BMP);
 /**
  * Loads the texture with MipMapping.
- * This function loads and creates the texture with MipMapping.
+ * This function loads and creates the texture with MipMapping. With
+ * ATextureCache enabled the texture is built by decodeTextureMipMap, so
+ * the stored levels are uploaded without decoding the image.
  * @param filename Image filename (BMP, TGA, PNG, JPEG)
  * @param texture Pointer to the texture identifier
  * @return True if the texture is loaded and created successfuly
@@ -91,9 +98,127 @@ bool loadTextureMipMap(char *filename, GLuint *texture);
  */
 bool createTextureMipMap(SDL_Surface *Image, GLuint *texture, int type=BMP);
 
+/**
+ * Returns the size of one level of the texture.
+ * @param format Compressed internal format (S3TC), 0 for RGB and RGBA
+ * @param channels Number of channels of the uncompressed pixels (3 or 4)
+ * @param width Width of the level
+ * @param height Height of the level
+ * @return Bytes of the level
+ */
+unsigned int getTextureLevelSize(GLenum format, int channels, int width, int height);
+
+/**
+ * Decoded texture with mipmaps.
+ */
+struct ATextureData
+{
+    int width;                          // size of the first level
+    int height;
+    int levels;                         // number of the levels
+    int channels;                       // 3 (RGB) or 4 (RGBA)
+    GLenum format;                      // compressed format or 0
+    std::vector<unsigned char> pixels;  // levels one after another
+    std::string error;                  // description of the failure
+
+    /**
+     * Constructor.
+     */
+    ATextureData() { width = height = levels = 0; channels = 3; format = 0; }
+
+    /**
+     * Returns the size of the level.
+     * @param level Level index
+     * @return Bytes of the level
+     */
+    unsigned int getLevelSize(int level) const
+    {
+        return getTextureLevelSize(format, channels, std::max(1, width >> level), std::max(1, height >> level));
+    }
+
+    /**
+     * Returns the first byte of the level in the pixels.
+     * @param level Level index
+     * @return Offset of the level
+     */
+    unsigned int getLevelOffset(int level) const
+    {
+        unsigned int offset = 0;
+        for(int i = 0; i < level; i++)
+            offset += getLevelSize(i);
+        return offset;
+    }
+};
+
+/**
+ * Decodes the texture with mipmaps.
+ * This function loads the image (as loadTextureMipMap does), scales it to
+ * the power of two size (at most maxSize) and builds all mipmap levels
+ * by averaging 2x2 pixels. It doesn't call OpenGL nor setAstral3DError, so
+ * it can run on any thread; the texture is created by
+ * uploadTextureMipMap on the OpenGL thread.
+ * The levels are read from ATextureCache if it is enabled and
+ * the entry is up to date, new textures are stored in it.
+ * @param filename Image filename (BMP, TGA, PNG, JPEG)
+ * @param data Decoded texture
+ * @param maxSize Maximum width and height (GL_MAX_TEXTURE_SIZE, 0 for
+ *                no limit)
+ * @return True if the texture is decoded, otherwise data->error describes
+ *         the failure
+ * @see ATextureLoader
+ */
+bool decodeTextureMipMap(char *filename, ATextureData *data, int maxSize = 0);
+/**
+ * Creates the texture with mipmaps from the decoded data.
+ * @param data Texture decoded by decodeTextureMipMap
+ * @param texture Pointer to the texture identifier
+ * @return True if the texture is created successfuly
+ */
+bool uploadTextureMipMap(const ATextureData &data, GLuint *texture);
+
+/**
+ * Measures the building of the textures.
+ * Writes the time of the conversion of BMP/TGA pixels (the old column
+ * order against the rows used by transform) and of the mipmaps built by
+ * the general scaling filter, by the SSE2 box filter in one thread and in
+ * the threads of AJobSystem, and checks that the results are the same.
+ * @param out Output stream
+ * @param size Width and height of the test image (power of two)
+ */
+void benchmarkTextureMipMap(std::ostream &out, int size = 2048);
+
+/**
+ * Uploads one level of the texture.
+ * The texture must be bound.
+ * @param data Decoded texture (RGB, RGBA or compressed)
+ * @param level Level index
+ * @param pixels Pixels of the level, NULL allocates the level only
+ */
+void uploadTextureLevel(const ATextureData &data, int level, const void *pixels);
+
+/**
+ * Returns the pixels of the texture.
+ * This function returns the RGB pixels of the image in the same order as
+ * createTexture uploads them, the alpha of 32-bit images is dropped. The
+ * array must be freed with delete[].
+ * @param Image Pointer to the SDL_Surface structure
+ * @param type Type of the image in the surface (BMP, TGA, PNG, JPG)
+ * @return Array of Image->w * Image->h * 3 bytes or NULL on error
+ */
+unsigned char *getTextureData(SDL_Surface *Image, int type=BMP);
+
+/**
+ * Returns the type of the image file.
+ * The type is given by the extension of the file name.
+ * @param filename Image filename
+ * @return BMP, TGA, JPG, PNG or NA
+ */
+int fileType(char *filename);
+
 /**
  * Frees the texture from the memory.
- * This function frees the texture from the memory.
+ * This function frees the texture from the memory. Textures of
+ * ATextureManager lose one reference and are freed with the last one.
  * @param texture Texture ID
  */
 void deleteTexture(GLuint *texture);
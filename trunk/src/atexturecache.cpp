@@ -0,0 +1,305 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+
+#include <cstdio>
+#include <sstream>
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifdef WIN32
+    #include <direct.h>
+    #include <process.h>
+#else
+    #include <unistd.h>
+#endif
+
+#include "atexturecache.h"
+#include "atexturemanager.h"
+#include "atexturecompressor.h"
+
+using namespace std;
+namespace astral3d {
+
+string ATextureCache::directory;
+
+volatile int ATextureCache::hits = 0;
+volatile int ATextureCache::misses = 0;
+volatile int ATextureCache::writes = 0;
+
+// header of the entry ("A3TC" and the version)
+static const unsigned int CACHE_MAGIC = 0x43543341;
+static const unsigned int CACHE_VERSION = 3;
+
+struct ACacheHeader
+{
+    unsigned int magic;
+    unsigned int version;
+    unsigned int sourceTime[2];     // modification time of the image
+    unsigned int sourceSize[2];     // size of the image file
+    int maxSize;
+    int width;
+    int height;
+    int levels;
+    int channels;                   // 3 or 4
+    unsigned int format;            // compressed format or 0
+    unsigned int pixelBytes;
+    unsigned int pathLength;        // canonical path follows the header
+};
+
+//-----------------------------------------------------------------------------
+// atomic increment, returns the new value (entries are read by the jobs
+// of ATextureLoader)
+//-----------------------------------------------------------------------------
+
+static int atomicIncrement(volatile int *value)
+{
+#ifdef WIN32
+    return InterlockedIncrement((volatile LONG *) value);
+#else
+    return __sync_add_and_fetch(value, 1);
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// time and size of the image file
+//-----------------------------------------------------------------------------
+
+static bool getSource(const string &path, ACacheHeader *header)
+{
+    struct stat info;
+    if(stat(path.c_str(), &info) != 0)
+        return false;
+
+    unsigned long long time = (unsigned long long) info.st_mtime;
+    unsigned long long size = (unsigned long long) info.st_size;
+
+    header->sourceTime[0] = (unsigned int) time;
+    header->sourceTime[1] = (unsigned int) (time >> 32);
+    header->sourceSize[0] = (unsigned int) size;
+    header->sourceSize[1] = (unsigned int) (size >> 32);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// sets the directory
+//-----------------------------------------------------------------------------
+
+bool ATextureCache::setDirectory(const char *path)
+{
+    directory = path ? path : "";
+    if(directory.empty())
+        return true;
+
+    struct stat info;
+    if(stat(directory.c_str(), &info) != 0)
+    {
+#ifdef WIN32
+        _mkdir(directory.c_str());
+#else
+        mkdir(directory.c_str(), 0755);
+#endif
+    }
+
+    if(stat(directory.c_str(), &info) != 0 || !(info.st_mode & S_IFDIR))
+    {
+        stringstream foo;
+        foo << "ATextureCache::setDirectory(\""<<path<<"\")";
+        setAstral3DError("Can't create the texture cache directory", foo.str(), "mkdir");
+
+        directory.clear();
+        return false;
+    }
+
+    char last = directory[directory.size() - 1];
+    if(last != '/' && last != '\\')
+        directory += '/';
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// path of the entry, FNV-1a hash of the canonical path
+//-----------------------------------------------------------------------------
+
+string ATextureCache::getEntryPath(const string &path)
+{
+    unsigned int hash = 2166136261u;
+    for(unsigned int i = 0; i < path.size(); i++)
+    {
+        hash ^= (unsigned char) path[i];
+        hash *= 16777619u;
+    }
+
+    char name[16];
+    sprintf(name, "%08x.atc", hash);
+    return directory + name;
+}
+
+//-----------------------------------------------------------------------------
+// reads the texture from the cache
+//-----------------------------------------------------------------------------
+
+bool ATextureCache::read(const char *filename, ATextureData *data, int maxSize)
+{
+    if(!isEnabled())
+        return false;
+
+    string path = ATextureManager::getCanonicalPath(filename);
+
+    ACacheHeader source;
+    if(!getSource(path, &source))
+    {
+        atomicIncrement(&misses);
+        return false;
+    }
+
+    FILE *file = fopen(getEntryPath(path).c_str(), "rb");
+    if(!file)
+    {
+        atomicIncrement(&misses);
+        return false;
+    }
+
+    // the entry must belong to the same file in the same state
+    ACacheHeader header;
+    bool valid = fread(&header, sizeof(header), 1, file) == 1
+              && header.magic == CACHE_MAGIC
+              && header.version == CACHE_VERSION
+              && header.sourceTime[0] == source.sourceTime[0]
+              && header.sourceTime[1] == source.sourceTime[1]
+              && header.sourceSize[0] == source.sourceSize[0]
+              && header.sourceSize[1] == source.sourceSize[1]
+              && header.maxSize == maxSize
+              && (header.format != 0) == ATextureCompressor::isEnabled()
+              && (header.channels == 3 || header.channels == 4)
+              && header.levels > 0
+              && header.pathLength == path.size();
+
+    if(valid)
+    {
+        vector<char> stored(path.size());
+        valid = fread(&stored[0], 1, path.size(), file) == path.size()
+             && equal(stored.begin(), stored.end(), path.begin());
+    }
+
+    // the levels must fill the pixels exactly
+    if(valid)
+    {
+        unsigned int size = 0;
+        int w = header.width, h = header.height;
+        for(int i = 0; i < header.levels; i++)
+        {
+            size += getTextureLevelSize(header.format, header.channels, w, h);
+            w = max(1, w / 2);
+            h = max(1, h / 2);
+        }
+        valid = header.width > 0 && header.height > 0 && size == header.pixelBytes;
+    }
+
+    if(valid)
+    {
+        data->pixels.resize(header.pixelBytes);
+        valid = fread(&data->pixels[0], 1, header.pixelBytes, file) == header.pixelBytes;
+    }
+
+    fclose(file);
+
+    if(!valid)
+    {
+        data->pixels.clear();
+        atomicIncrement(&misses);
+        return false;
+    }
+
+    data->width = header.width;
+    data->height = header.height;
+    data->levels = header.levels;
+    data->channels = header.channels;
+    data->format = header.format;
+
+    atomicIncrement(&hits);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// writes the texture to the cache
+//-----------------------------------------------------------------------------
+
+bool ATextureCache::write(const char *filename, const ATextureData &data, int maxSize)
+{
+    if(!isEnabled() || data.levels <= 0 || data.pixels.empty())
+        return false;
+
+    string path = ATextureManager::getCanonicalPath(filename);
+
+    ACacheHeader header;
+    if(!getSource(path, &header))
+        return false;
+
+    header.magic = CACHE_MAGIC;
+    header.version = CACHE_VERSION;
+    header.maxSize = maxSize;
+    header.width = data.width;
+    header.height = data.height;
+    header.levels = data.levels;
+    header.channels = data.channels;
+    header.format = data.format;
+    header.pixelBytes = data.pixels.size();
+    header.pathLength = path.size();
+
+    // unique temporary file of the process and the job
+    static volatile int counter = 0;
+    int number = atomicIncrement(&counter);
+
+    string entry = getEntryPath(path);
+    stringstream temporary;
+#ifdef WIN32
+    temporary << entry << "." << _getpid() << "." << number;
+#else
+    temporary << entry << "." << getpid() << "." << number;
+#endif
+
+    FILE *file = fopen(temporary.str().c_str(), "wb");
+    if(!file)
+        return false;
+
+    bool ok = fwrite(&header, sizeof(header), 1, file) == 1
+           && fwrite(path.data(), 1, path.size(), file) == path.size()
+           && fwrite(&data.pixels[0], 1, data.pixels.size(), file) == data.pixels.size();
+
+    ok = (fclose(file) == 0) && ok;
+
+#ifdef WIN32
+    // rename doesn't replace existing files on Windows
+    if(ok)
+        remove(entry.c_str());
+#endif
+
+    if(!ok || rename(temporary.str().c_str(), entry.c_str()) != 0)
+    {
+        remove(temporary.str().c_str());
+        return false;
+    }
+
+    atomicIncrement(&writes);
+    return true;
+}
+
+} // namespace astral3d
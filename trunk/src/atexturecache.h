@@ -0,0 +1,145 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file atexturecache.h ATextureCache class.
+ */
+#ifndef ATEXTURECACHE_H
+#define ATEXTURECACHE_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <string>
+
+#include "atexture.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Cache of decoded textures on the disk.
+ * decodeTextureMipMap stores the finished mipmaps of every texture in the
+ * cache directory and the next run reads them instead of decoding the
+ * image and building the mipmaps again. An entry is used only if the
+ * source file has the same modification time and size and the texture
+ * was built with the same maximum size and the same compression
+ * (ATextureCompressor), otherwise it is rebuilt. Any
+ * error of the cache only means the texture is decoded from the image.
+ * @n
+ * @n
+ * The cache is disabled until the directory is set. Entries are written
+ * to a temporary file and renamed, so the decoding jobs of
+ * ATextureLoader and other processes never read a half-written entry.
+ * The files are in the byte order of the machine which wrote them.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * ATextureCache::setDirectory("cache");
+ * level.load("level.map", "textures/");     // decodes and stores the textures
+ * ...
+ * level.load("level.map", "textures/");     // reads the stored mipmaps
+ * @endcode
+ */
+class ATextureCache
+{
+    private:
+        static std::string directory;
+
+        static volatile int hits;
+        static volatile int misses;
+        static volatile int writes;
+
+        // path of the entry of the texture
+        static std::string getEntryPath(const std::string &path);
+
+    public:
+        /**
+         * Sets the cache directory.
+         * The directory is created if it doesn't exist. This method
+         * must not be called while textures are loaded.
+         * @param path Directory of the cache, empty or NULL disables the
+         *             cache
+         * @return False if the directory can't be created (the cache is
+         *         disabled)
+         */
+        static bool setDirectory(const char *path);
+
+        /**
+         * Returns the cache directory.
+         * @return Directory of the cache or empty string
+         */
+        static const std::string &getDirectory() { return directory; }
+
+        /**
+         * Returns true if the cache is enabled.
+         * @return True if the directory is set
+         */
+        static bool isEnabled() { return !directory.empty(); }
+
+        /**
+         * Reads the texture from the cache.
+         * @param filename Image filename
+         * @param data Decoded texture
+         * @param maxSize Maximum size the texture was built with
+         * @return False if the entry is missing or stale
+         */
+        static bool read(const char *filename, ATextureData *data, int maxSize);
+
+        /**
+         * Writes the texture to the cache.
+         * @param filename Image filename
+         * @param data Texture decoded from the image
+         * @param maxSize Maximum size the texture was built with
+         * @return True if the entry is written
+         */
+        static bool write(const char *filename, const ATextureData &data, int maxSize);
+
+        /**
+         * Returns the number of textures read from the cache.
+         * @return Number of hits
+         */
+        static int getHits() { return hits; }
+
+        /**
+         * Returns the number of textures not found in the cache.
+         * @return Number of missing or stale entries
+         */
+        static int getMisses() { return misses; }
+
+        /**
+         * Returns the number of written entries.
+         * @return Number of writes
+         */
+        static int getWrites() { return writes; }
+
+        /**
+         * Clears the statistics.
+         */
+        static void resetStatistics() { hits = misses = writes = 0; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ATEXTURECACHE_H
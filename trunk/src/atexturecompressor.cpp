@@ -0,0 +1,285 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+
+#include <climits>
+#include <cstdlib>
+#include <algorithm>
+
+#include "atexturecompressor.h"
+#include "ajobsystem.h"
+
+using namespace std;
+namespace astral3d {
+
+bool ATextureCompressor::enabled = false;
+
+//-----------------------------------------------------------------------------
+// level compressed by compressRows
+//-----------------------------------------------------------------------------
+
+struct ACompressedLevel
+{
+    const unsigned char *source;    // uncompressed pixels
+    int width;
+    int height;
+    int channels;
+    unsigned char *destination;     // compressed blocks
+    int blockBytes;                 // 8 (DXT1) or 16 (DXT5)
+};
+
+//-----------------------------------------------------------------------------
+// color in the 5:6:5 format
+//-----------------------------------------------------------------------------
+
+static unsigned short packColor(const unsigned char *c)
+{
+    return (unsigned short) (((c[0] >> 3) << 11) | ((c[1] >> 2) << 5) | (c[2] >> 3));
+}
+
+//-----------------------------------------------------------------------------
+// color of the 5:6:5 format, the bits are repeated as the hardware does
+//-----------------------------------------------------------------------------
+
+static void unpackColor(unsigned short packed, int *c)
+{
+    int r = (packed >> 11) & 31;
+    int g = (packed >> 5) & 63;
+    int b = packed & 31;
+
+    c[0] = (r << 3) | (r >> 2);
+    c[1] = (g << 2) | (g >> 4);
+    c[2] = (b << 3) | (b >> 2);
+}
+
+//-----------------------------------------------------------------------------
+// compresses one block to DXT1
+//-----------------------------------------------------------------------------
+
+void ATextureCompressor::compressBlockDXT1(const unsigned char *rgba, unsigned char *block)
+{
+    // bounding box of the colors, inset to lower the error of the ends
+    unsigned char low[3] = { 255, 255, 255 };
+    unsigned char high[3] = { 0, 0, 0 };
+    for(int i = 0; i < 16; i++)
+    {
+        for(int c = 0; c < 3; c++)
+        {
+            low[c] = min(low[c], rgba[i * 4 + c]);
+            high[c] = max(high[c], rgba[i * 4 + c]);
+        }
+    }
+
+    for(int c = 0; c < 3; c++)
+    {
+        int inset = (high[c] - low[c]) >> 4;
+        low[c] = (unsigned char) (low[c] + inset);
+        high[c] = (unsigned char) (high[c] - inset);
+    }
+
+    // the first color must be bigger for the four colors mode
+    unsigned short color0 = packColor(high);
+    unsigned short color1 = packColor(low);
+    if(color0 < color1)
+        swap(color0, color1);
+
+    unsigned int indices = 0;
+    if(color0 != color1)
+    {
+        int palette[4][3];
+        unpackColor(color0, palette[0]);
+        unpackColor(color1, palette[1]);
+        for(int c = 0; c < 3; c++)
+        {
+            palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+            palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+        }
+
+        for(int i = 0; i < 16; i++)
+        {
+            const unsigned char *p = rgba + i * 4;
+            int best = 0, bestError = INT_MAX;
+            for(int j = 0; j < 4; j++)
+            {
+                int dr = p[0] - palette[j][0];
+                int dg = p[1] - palette[j][1];
+                int db = p[2] - palette[j][2];
+                int error = dr * dr + dg * dg + db * db;
+                if(error < bestError)
+                {
+                    bestError = error;
+                    best = j;
+                }
+            }
+
+            indices |= best << (i * 2);
+        }
+    }
+
+    // little endian
+    block[0] = (unsigned char) color0;
+    block[1] = (unsigned char) (color0 >> 8);
+    block[2] = (unsigned char) color1;
+    block[3] = (unsigned char) (color1 >> 8);
+    for(int i = 0; i < 4; i++)
+        block[4 + i] = (unsigned char) (indices >> (i * 8));
+}
+
+//-----------------------------------------------------------------------------
+// compresses one block to DXT5
+//-----------------------------------------------------------------------------
+
+void ATextureCompressor::compressBlockDXT5(const unsigned char *rgba, unsigned char *block)
+{
+    int low = 255, high = 0;
+    for(int i = 0; i < 16; i++)
+    {
+        low = min(low, (int) rgba[i * 4 + 3]);
+        high = max(high, (int) rgba[i * 4 + 3]);
+    }
+
+    // eight alpha values mode (the first one is bigger)
+    block[0] = (unsigned char) high;
+    block[1] = (unsigned char) low;
+
+    unsigned long long indices = 0;
+    if(high != low)
+    {
+        int palette[8];
+        palette[0] = high;
+        palette[1] = low;
+        for(int j = 1; j < 7; j++)
+            palette[j + 1] = ((7 - j) * high + j * low) / 7;
+
+        for(int i = 0; i < 16; i++)
+        {
+            int a = rgba[i * 4 + 3];
+            int best = 0, bestError = INT_MAX;
+            for(int j = 0; j < 8; j++)
+            {
+                int error = abs(a - palette[j]);
+                if(error < bestError)
+                {
+                    bestError = error;
+                    best = j;
+                }
+            }
+
+            indices |= (unsigned long long) best << (i * 3);
+        }
+    }
+
+    for(int i = 0; i < 6; i++)
+        block[2 + i] = (unsigned char) (indices >> (i * 8));
+
+    compressBlockDXT1(rgba, block + 8);
+}
+
+//-----------------------------------------------------------------------------
+// compresses the rows of blocks
+//-----------------------------------------------------------------------------
+
+void ATextureCompressor::compressRows(int begin, int end, void *data)
+{
+    ACompressedLevel *level = (ACompressedLevel *) data;
+
+    int blocksX = (level->width + 3) / 4;
+    unsigned char rgba[64];
+
+    for(int by = begin; by < end; by++)
+    {
+        for(int bx = 0; bx < blocksX; bx++)
+        {
+            // pixels out of small levels repeat the last row and column
+            for(int y = 0; y < 4; y++)
+            {
+                int sy = min(by * 4 + y, level->height - 1);
+                for(int x = 0; x < 4; x++)
+                {
+                    int sx = min(bx * 4 + x, level->width - 1);
+                    const unsigned char *p = level->source + (sy * level->width + sx) * level->channels;
+                    unsigned char *d = rgba + (y * 4 + x) * 4;
+
+                    d[0] = p[0];
+                    d[1] = p[1];
+                    d[2] = p[2];
+                    d[3] = level->channels == 4 ? p[3] : 255;
+                }
+            }
+
+            unsigned char *block = level->destination + (by * blocksX + bx) * level->blockBytes;
+            if(level->blockBytes == 16)
+                compressBlockDXT5(rgba, block);
+            else
+                compressBlockDXT1(rgba, block);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// compresses the texture
+//-----------------------------------------------------------------------------
+
+bool ATextureCompressor::compress(ATextureData *data)
+{
+    if(data->levels <= 0 || data->pixels.empty())
+        return false;
+
+    if(data->format != 0)
+        return true;
+
+    ATextureData compressed;
+    compressed.width = data->width;
+    compressed.height = data->height;
+    compressed.levels = data->levels;
+    compressed.channels = data->channels;
+    compressed.format = data->channels == 4 ? GL_COMPRESSED_RGBA_S3TC_DXT5_EXT
+                                            : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+    compressed.pixels.resize(compressed.getLevelOffset(compressed.levels));
+
+    const unsigned char *source = &data->pixels[0];
+    unsigned char *destination = &compressed.pixels[0];
+    for(int i = 0; i < data->levels; i++)
+    {
+        ACompressedLevel level;
+        level.source = source;
+        level.width = max(1, data->width >> i);
+        level.height = max(1, data->height >> i);
+        level.channels = data->channels;
+        level.destination = destination;
+        level.blockBytes = data->channels == 4 ? 16 : 8;
+
+        // rows of blocks of big levels are split among the threads
+        int blocksY = (level.height + 3) / 4;
+        if(blocksY >= 32)
+            AJobSystem::parallelFor(0, blocksY, compressRows, &level, 8);
+        else
+            compressRows(0, blocksY, &level);
+
+        source += data->getLevelSize(i);
+        destination += compressed.getLevelSize(i);
+    }
+
+    data->format = compressed.format;
+    data->pixels.swap(compressed.pixels);
+
+    return true;
+}
+
+} // namespace astral3d
@@ -0,0 +1,107 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file atexturecompressor.h ATextureCompressor class.
+ */
+#ifndef ATEXTURECOMPRESSOR_H
+#define ATEXTURECOMPRESSOR_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <GL/gl.h>
+
+#include "atexture.h"
+#include "aextensions.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Compression of the textures on the CPU.
+ * When the compression is enabled and the driver supports S3TC,
+ * decodeTextureMipMap compresses the levels of RGB textures to DXT1
+ * (8 bytes per 4x4 pixels) and of RGBA textures to DXT5 (16 bytes per 4x4
+ * pixels), so the compressed levels are stored in ATextureCache and the
+ * next runs upload them without any work. The encoder fits the colors of
+ * every block to the diagonal of their bounding box, it is fast rather
+ * than the best quality.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * window.create(...);                       // extensions are known now
+ * ATextureCache::setDirectory("cache");
+ * ATextureCompressor::setEnabled(true);
+ * level.load("level.map", "textures/");
+ * @endcode
+ */
+class ATextureCompressor
+{
+    private:
+        static bool enabled;
+
+        // compresses the rows of blocks of one level (job of AJobSystem::parallelFor)
+        static void compressRows(int begin, int end, void *data);
+
+    public:
+        /**
+         * Enables the compression.
+         * @param enable True for compressed textures
+         */
+        static void setEnabled(bool enable) { enabled = enable; }
+
+        /**
+         * Returns true if the textures are compressed.
+         * @return True if the compression is enabled and the driver
+         *         supports S3TC (see isS3TCSupported)
+         */
+        static bool isEnabled() { return enabled && isS3TCSupported(); }
+
+        /**
+         * Compresses the texture.
+         * The levels are replaced by DXT1 (RGB) or DXT5 (RGBA) blocks.
+         * @param data Decoded texture
+         * @return False if the texture has no levels
+         */
+        static bool compress(ATextureData *data);
+
+        /**
+         * Compresses one 4x4 block to DXT1.
+         * @param rgba 16 pixels of the block (4 bytes each, alpha ignored)
+         * @param block 8 bytes of the compressed block
+         */
+        static void compressBlockDXT1(const unsigned char *rgba, unsigned char *block);
+
+        /**
+         * Compresses one 4x4 block to DXT5.
+         * @param rgba 16 pixels of the block (4 bytes each)
+         * @param block 16 bytes of the compressed block
+         */
+        static void compressBlockDXT5(const unsigned char *rgba, unsigned char *block);
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ATEXTURECOMPRESSOR_H
@@ -0,0 +1,222 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+#include "atextureloader.h"
+
+using namespace std;
+namespace astral3d {
+
+//-----------------------------------------------------------------------------
+// adds the texture
+//-----------------------------------------------------------------------------
+
+void ATextureLoader::add(const char *filename, GLuint *texture)
+{
+    // the jobs of the started textures point to the items
+    if(!filename || !texture || started)
+        return;
+
+    for(unsigned int i = 0; i < items.size(); i++)
+    {
+        if(items[i].texture == texture)
+            return;
+    }
+
+    Item item;
+    item.filename = filename;
+    item.texture = texture;
+    item.maxSize = 0;
+    item.decoded = false;
+    item.cached = false;
+    item.shared = 0;
+    items.push_back(item);
+}
+
+//-----------------------------------------------------------------------------
+// job decoding one texture
+//-----------------------------------------------------------------------------
+
+void ATextureLoader::decodeJob(void *data)
+{
+    Item *item = (Item *) data;
+
+    vector<char> filename(item->filename.begin(), item->filename.end());
+    filename.push_back('\0');
+
+    item->decoded = decodeTextureMipMap(&filename[0], &item->data, item->maxSize);
+}
+
+//-----------------------------------------------------------------------------
+// starts decoding of the textures
+//-----------------------------------------------------------------------------
+
+void ATextureLoader::start()
+{
+    if(started)
+        return;
+
+    started = true;
+
+    GLint maxSize = 0;
+    glGetIntegerv(GL_MAX_TEXTURE_SIZE, &maxSize);
+
+    // textures already in ATextureManager or earlier in the list aren't
+    // decoded, the reference keeps the texture until finish
+    vector<string> paths;
+    for(unsigned int i = 0; i < items.size(); i++)
+    {
+        items[i].maxSize = maxSize;
+
+        string path = ATextureManager::getCanonicalPath(items[i].filename.c_str());
+        if(std::find(paths.begin(), paths.end(), path) != paths.end())
+        {
+            items[i].cached = true;
+            continue;
+        }
+
+        paths.push_back(path);
+        items[i].shared = ATextureManager::find(items[i].filename.c_str());
+        items[i].cached = items[i].shared != 0;
+    }
+
+    // one group per texture, the upload waits only for its texture
+    if(AJobSystem::getThreadCount() > 1)
+    {
+        for(unsigned int i = 0; i < items.size(); i++)
+        {
+            groups.push_back(items[i].cached ? NULL : new AJobGroup);
+            if(groups[i])
+                AJobSystem::submit(decodeJob, &items[i], groups[i]);
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// tests if the textures are decoded
+//-----------------------------------------------------------------------------
+
+bool ATextureLoader::isDecoded()
+{
+    for(unsigned int i = 0; i < groups.size(); i++)
+    {
+        if(groups[i] && !groups[i]->isDone())
+            return false;
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// uploads the textures
+//-----------------------------------------------------------------------------
+
+bool ATextureLoader::finish()
+{
+    start();
+
+    bool ok = true;
+    for(unsigned int i = 0; i < items.size(); i++)
+    {
+        Item &item = items[i];
+
+        *item.texture = 0;
+
+        // shared texture, loaded before or by an earlier item
+        if(item.cached)
+        {
+            *item.texture = item.shared ? item.shared : ATextureManager::find(item.filename.c_str());
+            item.shared = 0;
+            if(*item.texture)
+                continue;
+        }
+
+        // the thread decodes other textures while it waits, the texture
+        // of the failed earlier item is decoded here
+        if(!item.cached && !groups.empty())
+        {
+            AJobSystem::wait(groups[i]);
+            delete groups[i];
+            groups[i] = NULL;
+        }
+        else
+        {
+            decodeJob(&item);
+        }
+
+        // other loaders may have uploaded the file in the meantime
+        if(item.decoded)
+            *item.texture = ATextureManager::find(item.filename.c_str());
+
+        if(item.decoded && !*item.texture)
+        {
+            // only the small levels of streamed textures are uploaded,
+            // the uploader spreads the levels across frames
+            if(ATextureStreamer::isEnabled())
+                item.decoded = ATextureStreamer::upload(item.filename.c_str(), item.data, item.texture, item.maxSize);
+            else
+                item.decoded = ATextureUploader::upload(item.data, item.texture);
+            if(item.decoded)
+                ATextureManager::insert(item.filename.c_str(), true, *item.texture);
+        }
+        else if(!item.decoded && ok)
+        {
+            stringstream foo;
+            stringstream bar;
+            foo << "ATextureLoader::finish()";
+            bar << "decodeTextureMipMap(\""<<item.filename<<"\")";
+            setAstral3DError(item.data.error, foo.str(), bar.str());
+        }
+
+        ok = ok && item.decoded;
+
+        // the pixels aren't needed any more
+        vector<unsigned char>().swap(item.data.pixels);
+    }
+
+    clear();
+
+    return ok;
+}
+
+//-----------------------------------------------------------------------------
+// removes the textures
+//-----------------------------------------------------------------------------
+
+void ATextureLoader::clear()
+{
+    // the jobs write to the items
+    for(unsigned int i = 0; i < groups.size(); i++)
+    {
+        AJobSystem::wait(groups[i]);
+        delete groups[i];
+    }
+
+    // references of the textures which weren't finished
+    for(unsigned int i = 0; i < items.size(); i++)
+    {
+        if(items[i].shared)
+            ATextureManager::release(items[i].shared);
+    }
+
+    groups.clear();
+    items.clear();
+    started = false;
+}
+
+} // namespace astral3d
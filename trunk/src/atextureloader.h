@@ -0,0 +1,175 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file atextureloader.h ATextureLoader class.
+ */
+#ifndef ATEXTURELOADER_H
+#define ATEXTURELOADER_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <string>
+#include <vector>
+#include <sstream>
+#include <algorithm>
+#include <GL/gl.h>
+
+#include "atexture.h"
+#include "atexturemanager.h"
+#include "atexturestreamer.h"
+#include "atextureuploader.h"
+#include "ajobsystem.h"
+#include "aerror.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Loader of many textures with mipmaps.
+ * Textures are decoded, scaled and their mipmaps built as the jobs of
+ * AJobSystem (decodeTextureMipMap), only the upload runs on the calling
+ * (OpenGL) thread, while the next textures are still decoded. Without
+ * the job system the textures are loaded one after another. The textures
+ * are shared through ATextureManager, a file loaded before isn't decoded
+ * again and deleteTexture releases its reference. With the budget of
+ * ATextureStreamer only the small levels are uploaded, with the budget of
+ * ATextureUploader the levels are uploaded in the next frames.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * ATextureLoader loader;
+ * for(int i = 0; i < count; i++)
+ *     loader.add(files[i], &textures[i]);
+ * if(!loader.load())
+ *     cerr << getAstral3DError();
+ * @endcode
+ * @n
+ * Decoding can run in the background, the upload must be on the OpenGL
+ * thread:
+ * @n
+ * @code
+ * loader.start();
+ * ...
+ * if(loader.isDecoded())
+ *     loader.finish();
+ * @endcode
+ */
+class ATextureLoader
+{
+    private:
+        struct Item
+        {
+            std::string filename;
+            GLuint *texture;
+            int maxSize;
+            ATextureData data;
+            bool decoded;
+            bool cached;                // shared with ATextureManager
+            GLuint shared;              // texture referenced by start or 0
+        };
+
+        std::vector<Item> items;
+
+        // one group per texture (NULL for the shared ones) after start
+        std::vector<AJobGroup *> groups;
+        bool started;
+
+        // decodes one texture
+        static void decodeJob(void *data);
+
+    public:
+        /**
+         * Constructor.
+         */
+        ATextureLoader() { started = false; }
+
+        /**
+         * Destructor.
+         * Waits for the started jobs.
+         */
+        ~ATextureLoader() { clear(); }
+
+        /**
+         * Adds the texture.
+         * The same texture identifier added again is loaded only once.
+         * Textures can't be added after ATextureLoader::start.
+         * @param filename Image filename (BMP, TGA, PNG, JPEG)
+         * @param texture Pointer to the texture identifier, it is set by
+         *                ATextureLoader::load
+         */
+        void add(const char *filename, GLuint *texture);
+
+        /**
+         * Loads all added textures.
+         * The list of textures is empty afterwards. Textures which fail
+         * to load get the identifier 0.
+         * @return True if all textures are loaded, otherwise the error of
+         *         the first failed texture is set (see getAstral3DError)
+         */
+        bool load() { start(); return finish(); }
+
+        /**
+         * Starts decoding of the added textures.
+         * The textures are decoded by the jobs of AJobSystem while the
+         * calling thread goes on, ATextureLoader::finish uploads them.
+         * Without the job system the textures are decoded by
+         * ATextureLoader::finish. Textures already in ATextureManager get
+         * their reference here, they stay loaded until the finish.
+         */
+        void start();
+
+        /**
+         * Tests if the started textures are decoded.
+         * @return True if ATextureLoader::finish won't wait for the jobs
+         */
+        bool isDecoded();
+
+        /**
+         * Uploads the started textures.
+         * Waits for the textures which aren't decoded yet. The list of
+         * textures is empty afterwards. Textures which fail to load get the
+         * identifier 0.
+         * @return True if all textures are loaded, otherwise the error of
+         *         the first failed texture is set (see getAstral3DError)
+         */
+        bool finish();
+
+        /**
+         * Removes all added textures.
+         * Started textures aren't uploaded, their jobs are waited for.
+         */
+        void clear();
+
+        /**
+         * Returns the number of the added textures.
+         * @return Number of textures
+         */
+        int getSize() { return items.size(); }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ATEXTURELOADER_H
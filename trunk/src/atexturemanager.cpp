@@ -0,0 +1,276 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+
+#include <sstream>
+#include <iomanip>
+#include <climits>
+#include <cstdlib>
+#include <cctype>
+
+#include "atexturemanager.h"
+#include "atexture.h"
+#include "arenderstate.h"
+#include "atexturestreamer.h"
+#include "atextureuploader.h"
+
+using namespace std;
+namespace astral3d {
+
+map<string, GLuint> ATextureManager::keys;
+map<GLuint, ATextureManager::Entry> ATextureManager::textures;
+
+unsigned int ATextureManager::hits = 0;
+unsigned int ATextureManager::misses = 0;
+unsigned long ATextureManager::residentBytes = 0;
+
+//-----------------------------------------------------------------------------
+// canonical path of the file
+//-----------------------------------------------------------------------------
+
+string ATextureManager::getCanonicalPath(const char *filename)
+{
+#ifdef WIN32
+    char path[_MAX_PATH];
+    if(_fullpath(path, filename, _MAX_PATH))
+    {
+        // the file system isn't case sensitive
+        for(char *c = path; *c; c++)
+            *c = (*c == '/') ? '\\' : tolower(*c);
+        return path;
+    }
+#else
+    char path[PATH_MAX];
+    if(realpath(filename, path))
+        return path;
+#endif
+
+    return filename;
+}
+
+//-----------------------------------------------------------------------------
+// key of the texture
+//-----------------------------------------------------------------------------
+
+string ATextureManager::getKey(const char *filename, bool mipmap, GLint min, GLint mag)
+{
+    stringstream key;
+    key << getCanonicalPath(filename) << '|';
+
+    if(mipmap)
+        key << 'm';
+    else
+        key << min << ',' << mag;
+
+    return key.str();
+}
+
+//-----------------------------------------------------------------------------
+// loads the texture or returns the loaded one
+//-----------------------------------------------------------------------------
+
+GLuint ATextureManager::load(const char *filename, bool mipmap, GLint min, GLint mag)
+{
+    GLuint texture = find(filename, mipmap, min, mag);
+    if(texture)
+        return texture;
+
+    bool loaded;
+    if(mipmap)
+        loaded = loadTextureMipMap((char*)filename, &texture);
+    else
+        loaded = loadTexture((char*)filename, &texture, min, mag);
+
+    if(!loaded)
+        return 0;
+
+    insert(filename, mipmap, texture, min, mag);
+    return texture;
+}
+
+//-----------------------------------------------------------------------------
+// returns the loaded texture
+//-----------------------------------------------------------------------------
+
+GLuint ATextureManager::find(const char *filename, bool mipmap, GLint min, GLint mag)
+{
+    map<string, GLuint>::iterator it = keys.find(getKey(filename, mipmap, min, mag));
+    if(it == keys.end())
+        return 0;
+
+    textures[it->second].references++;
+    hits++;
+    return it->second;
+}
+
+//-----------------------------------------------------------------------------
+// returns true if the texture is loaded
+//-----------------------------------------------------------------------------
+
+bool ATextureManager::contains(const char *filename, bool mipmap, GLint min, GLint mag)
+{
+    return keys.find(getKey(filename, mipmap, min, mag)) != keys.end();
+}
+
+//-----------------------------------------------------------------------------
+// adds the texture loaded by the caller
+//-----------------------------------------------------------------------------
+
+void ATextureManager::insert(const char *filename, bool mipmap, GLuint texture, GLint min, GLint mag)
+{
+    if(texture == 0 || isManaged(texture))
+        return;
+
+    Entry entry;
+    entry.key = getKey(filename, mipmap, min, mag);
+    entry.references = 1;
+
+    // memory of the levels in the internal format, S3TC levels are counted
+    // in blocks and the other ones as RGBA (drivers store RGB as RGBA); the
+    // memory of streamed textures is counted by ATextureStreamer
+    if(ATextureStreamer::getSize(texture, &entry.width, &entry.height))
+    {
+        entry.bytes = 0;
+    }
+    else
+    {
+        ARenderState::bindTexture(texture);
+
+        GLint format = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &format);
+
+        entry.width = 0;
+        entry.height = 0;
+        entry.bytes = 0;
+        for(GLint level = 0; level == 0 || mipmap; level++)
+        {
+            GLint width = 0, height = 0;
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_WIDTH, &width);
+            glGetTexLevelParameteriv(GL_TEXTURE_2D, level, GL_TEXTURE_HEIGHT, &height);
+
+            // missing levels are reported with zero size
+            if(width <= 0 || height <= 0)
+                break;
+
+            if(level == 0)
+            {
+                entry.width = width;
+                entry.height = height;
+            }
+
+            entry.bytes += getTextureLevelSize(format, 4, width, height);
+
+            if(width == 1 && height == 1)
+                break;
+        }
+    }
+
+    // the same file loaded twice by the caller keeps the first texture
+    if(keys.find(entry.key) == keys.end())
+        keys[entry.key] = texture;
+
+    textures[texture] = entry;
+    residentBytes += entry.bytes;
+    misses++;
+}
+
+//-----------------------------------------------------------------------------
+// adds the reference
+//-----------------------------------------------------------------------------
+
+void ATextureManager::addReference(GLuint texture)
+{
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    if(it != textures.end())
+        it->second.references++;
+}
+
+//-----------------------------------------------------------------------------
+// releases the reference
+//-----------------------------------------------------------------------------
+
+bool ATextureManager::release(GLuint texture)
+{
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    if(it == textures.end())
+        return false;
+
+    if(--it->second.references > 0)
+        return true;
+
+    map<string, GLuint>::iterator key = keys.find(it->second.key);
+    if(key != keys.end() && key->second == texture)
+        keys.erase(key);
+
+    residentBytes -= it->second.bytes;
+    textures.erase(it);
+
+    ATextureStreamer::remove(texture);
+    ATextureUploader::cancel(texture);
+    ARenderState::textureDeleted(texture);
+    glDeleteTextures(1, &texture);
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// returns the number of references
+//-----------------------------------------------------------------------------
+
+int ATextureManager::getReferences(GLuint texture)
+{
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    return (it == textures.end()) ? 0 : it->second.references;
+}
+
+//-----------------------------------------------------------------------------
+// returns the size of the texture
+//-----------------------------------------------------------------------------
+
+bool ATextureManager::getSize(GLuint texture, int *width, int *height)
+{
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    if(it == textures.end())
+        return false;
+
+    if(width)
+        *width = it->second.width;
+    if(height)
+        *height = it->second.height;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// writes the statistics
+//-----------------------------------------------------------------------------
+
+void ATextureManager::print(ostream &out)
+{
+    out << "Textures: " << textures.size()
+        << ", resident: " << residentBytes / 1024 << " KB"
+        << ", hits: " << hits << ", misses: " << misses << endl;
+
+    for(map<GLuint, Entry>::iterator it = textures.begin(); it != textures.end(); it++)
+    {
+        out << setw(6) << it->first << setw(4) << it->second.references << "x "
+            << it->second.width << "x" << it->second.height << " "
+            << it->second.key << endl;
+    }
+}
+
+} // namespace astral3d
@@ -0,0 +1,207 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file atexturemanager.h ATextureManager class.
+ */
+#ifndef ATEXTUREMANAGER_H
+#define ATEXTUREMANAGER_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <string>
+#include <map>
+#include <iostream>
+#include <GL/gl.h>
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Shared textures of the application.
+ * Every file is loaded only once (the same canonical path and the same
+ * filtering), each user of the texture holds a reference and the texture
+ * is deleted when the last reference is released. deleteTexture releases
+ * the reference of managed textures, so the classes of the library
+ * (ALevel, A3DSModel, ASurface, AConsole, AText2D) share their textures
+ * without any change of their use. The manager must be used from the
+ * OpenGL thread only.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * GLuint wall = ATextureManager::load("textures/wall.jpg");
+ * GLuint same = ATextureManager::load("textures/../textures/wall.jpg");   // hit
+ * deleteTexture(&same);
+ * deleteTexture(&wall);   // the texture is deleted now
+ * ATextureManager::print(cout);
+ * @endcode
+ */
+class ATextureManager
+{
+    private:
+        struct Entry
+        {
+            std::string key;            // canonical path and filtering
+            int references;
+            int width;                  // size of the first level
+            int height;
+            unsigned int bytes;         // memory of all levels
+        };
+
+        static std::map<std::string, GLuint> keys;
+        static std::map<GLuint, Entry> textures;
+
+        static unsigned int hits;
+        static unsigned int misses;
+        static unsigned long residentBytes;
+
+        // key of the texture
+        static std::string getKey(const char *filename, bool mipmap, GLint min, GLint mag);
+
+    public:
+        /**
+         * Returns the canonical path of the file.
+         * @param filename Path of the file
+         * @return Absolute path without '.', '..' and links (the given
+         *         path if the file doesn't exist)
+         */
+        static std::string getCanonicalPath(const char *filename);
+
+        /**
+         * Loads the texture or returns the loaded one.
+         * @param filename Image filename (BMP, TGA, PNG, JPEG)
+         * @param mipmap True for loadTextureMipMap, false for loadTexture
+         * @param min Minifying filter without mipmaps
+         * @param mag Magnifying filter without mipmaps
+         * @return Texture with a new reference or 0 on error
+         */
+        static GLuint load(const char *filename, bool mipmap = true, GLint min = GL_LINEAR, GLint mag = GL_LINEAR);
+
+        /**
+         * Returns the loaded texture.
+         * @param filename Image filename
+         * @param mipmap True for the texture with mipmaps
+         * @param min Minifying filter without mipmaps
+         * @param mag Magnifying filter without mipmaps
+         * @return Texture with a new reference or 0 if it isn't loaded
+         */
+        static GLuint find(const char *filename, bool mipmap = true, GLint min = GL_LINEAR, GLint mag = GL_LINEAR);
+
+        /**
+         * Returns true if the texture is loaded.
+         * The reference count doesn't change.
+         * @param filename Image filename
+         * @param mipmap True for the texture with mipmaps
+         * @return True if ATextureManager::find would return the texture
+         */
+        static bool contains(const char *filename, bool mipmap = true, GLint min = GL_LINEAR, GLint mag = GL_LINEAR);
+
+        /**
+         * Adds the texture loaded by the caller.
+         * The texture gets one reference.
+         * @param filename Image filename
+         * @param mipmap True for the texture with mipmaps
+         * @param texture Texture loaded from the file
+         * @param min Minifying filter without mipmaps
+         * @param mag Magnifying filter without mipmaps
+         */
+        static void insert(const char *filename, bool mipmap, GLuint texture, GLint min = GL_LINEAR, GLint mag = GL_LINEAR);
+
+        /**
+         * Adds the reference of the managed texture.
+         * @param texture Managed texture
+         */
+        static void addReference(GLuint texture);
+
+        /**
+         * Releases the reference.
+         * The texture is deleted with the last reference.
+         * @param texture Texture
+         * @return True if the texture is managed
+         */
+        static bool release(GLuint texture);
+
+        /**
+         * Returns true if the texture is managed.
+         * @param texture Texture
+         * @return True if the texture was loaded by the manager
+         */
+        static bool isManaged(GLuint texture) { return textures.find(texture) != textures.end(); }
+
+        /**
+         * Returns the number of references.
+         * @param texture Texture
+         * @return References of the texture (0 if it isn't managed)
+         */
+        static int getReferences(GLuint texture);
+
+        /**
+         * Returns the size of the managed texture.
+         * @param texture Texture
+         * @param width Width of the first level
+         * @param height Height of the first level
+         * @return True if the texture is managed
+         */
+        static bool getSize(GLuint texture, int *width, int *height);
+
+        /**
+         * Returns the number of loads of already loaded textures.
+         * @return Number of hits
+         */
+        static unsigned int getHits() { return hits; }
+
+        /**
+         * Returns the number of loaded textures.
+         * @return Number of misses
+         */
+        static unsigned int getMisses() { return misses; }
+
+        /**
+         * Returns the memory of the loaded textures.
+         * @return Bytes of all levels of the textures
+         */
+        static unsigned long getResidentBytes() { return residentBytes; }
+
+        /**
+         * Returns the number of loaded textures.
+         * @return Number of textures
+         */
+        static unsigned int getTextureCount() { return textures.size(); }
+
+        /**
+         * Clears the hits and misses.
+         */
+        static void resetStatistics() { hits = misses = 0; }
+
+        /**
+         * Writes the statistics and the list of textures.
+         * @param out Output stream
+         */
+        static void print(std::ostream &out);
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ATEXTUREMANAGER_H
@@ -0,0 +1,420 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+
+#include <vector>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+
+#include "atexturestreamer.h"
+#include "arenderstate.h"
+
+using namespace std;
+namespace astral3d {
+
+map<GLuint, ATextureStreamer::Entry> ATextureStreamer::textures;
+
+unsigned long ATextureStreamer::budget = 0;
+unsigned long ATextureStreamer::residentBytes = 0;
+int ATextureStreamer::initialSize = 64;
+int ATextureStreamer::uploadsPerFrame = 4;
+unsigned int ATextureStreamer::frame = 1;
+
+unsigned int ATextureStreamer::streamedLevels = 0;
+unsigned int ATextureStreamer::droppedLevels = 0;
+
+//-----------------------------------------------------------------------------
+// sets the budget
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::setBudget(unsigned long bytes)
+{
+    budget = bytes;
+}
+
+//-----------------------------------------------------------------------------
+// memory of the levels from first to the last one (drivers store RGB as
+// RGBA)
+//-----------------------------------------------------------------------------
+
+unsigned long ATextureStreamer::getBytes(const Entry &entry, int first)
+{
+    unsigned long bytes = 0;
+    for(int i = first; i < entry.levels; i++)
+        bytes += getTextureLevelSize(entry.format, 4, max(1, entry.width >> i), max(1, entry.height >> i));
+
+    return bytes;
+}
+
+//-----------------------------------------------------------------------------
+// uploads the levels from first to the base level
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::uploadLevels(GLuint texture, Entry &entry, const ATextureData &data, int first)
+{
+    ARenderState::bindTexture(texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    const unsigned char *level = &data.pixels[0];
+    for(int i = 0; i < entry.base; i++)
+    {
+        if(i >= first)
+            uploadTextureLevel(data, i, level);
+
+        level += data.getLevelSize(i);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    // the new levels are used after they are complete
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, first);
+
+    if(entry.base < entry.levels)
+        streamedLevels += entry.base - first;
+
+    residentBytes -= entry.bytes;
+    entry.base = first;
+    entry.bytes = getBytes(entry, first);
+    residentBytes += entry.bytes;
+}
+
+//-----------------------------------------------------------------------------
+// frees the finest resident level
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::dropLevel(GLuint texture, Entry &entry)
+{
+    ARenderState::bindTexture(texture);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, entry.base + 1);
+
+    // the empty image frees the memory of the level
+    glTexImage2D(GL_TEXTURE_2D, entry.base, entry.format ? entry.format : entry.channels, 0, 0, 0,
+                 entry.channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, NULL);
+
+    residentBytes -= entry.bytes;
+    entry.base++;
+    entry.bytes = getBytes(entry, entry.base);
+    residentBytes += entry.bytes;
+
+    droppedLevels++;
+}
+
+//-----------------------------------------------------------------------------
+// drops levels of the least recently used textures
+//-----------------------------------------------------------------------------
+
+bool ATextureStreamer::makeRoom(unsigned long bytes)
+{
+    while(residentBytes + bytes > budget)
+    {
+        // textures used in this frame keep their levels
+        map<GLuint, Entry>::iterator oldest = textures.end();
+        for(map<GLuint, Entry>::iterator it = textures.begin(); it != textures.end(); it++)
+        {
+            const Entry &entry = it->second;
+            if(entry.lastUsed == frame || entry.base >= entry.coarse)
+                continue;
+
+            if(oldest == textures.end() || entry.lastUsed < oldest->second.lastUsed)
+                oldest = it;
+        }
+
+        if(oldest == textures.end())
+            return false;
+
+        dropLevel(oldest->first, oldest->second);
+    }
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// job decoding the texture
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::decodeJob(void *data)
+{
+    Request *request = (Request *) data;
+
+    vector<char> filename(request->filename.begin(), request->filename.end());
+    filename.push_back('\0');
+
+    request->decoded = decodeTextureMipMap(&filename[0], &request->data, request->maxSize);
+}
+
+//-----------------------------------------------------------------------------
+// creates the streamed texture
+//-----------------------------------------------------------------------------
+
+bool ATextureStreamer::upload(const char *filename, const ATextureData &data, GLuint *texture, int maxSize)
+{
+    if(data.levels <= 0 || data.pixels.empty())
+    {
+        stringstream foo;
+        foo << "ATextureStreamer::upload(\""<<filename<<"\", "<<&data<<", "<<texture<<", "<<maxSize<<")";
+        setAstral3DError("The texture isn't decoded", foo.str(), "decodeTextureMipMap");
+        return false;
+    }
+
+    Entry entry;
+    entry.filename = filename;
+    entry.width = data.width;
+    entry.height = data.height;
+    entry.levels = data.levels;
+    entry.channels = data.channels;
+    entry.format = data.format;
+    entry.base = data.levels;
+    entry.lastUsed = 0;
+    entry.bytes = 0;
+    entry.maxSize = maxSize;
+    entry.request = NULL;
+
+    // the first level not bigger than the initial size
+    entry.coarse = 0;
+    while(entry.coarse < entry.levels - 1 &&
+          max(entry.width >> entry.coarse, entry.height >> entry.coarse) > initialSize)
+        entry.coarse++;
+
+    entry.wanted = entry.coarse;
+
+    glGenTextures(1, texture);
+    ARenderState::bindTexture(*texture);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, entry.levels - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    uploadLevels(*texture, entry, data, entry.coarse);
+    textures[*texture] = entry;
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// reports the use of the texture
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::use(GLuint texture, int pixels)
+{
+    if(textures.empty())
+        return;
+
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    if(it == textures.end())
+        return;
+
+    Entry &entry = it->second;
+
+    // the coarsest level still covering the pixels
+    int level = 0;
+    if(pixels > 0)
+    {
+        while(level < entry.coarse &&
+              max(entry.width >> (level + 1), entry.height >> (level + 1)) >= pixels)
+            level++;
+    }
+
+    if(entry.lastUsed != frame)
+    {
+        entry.lastUsed = frame;
+        entry.wanted = level;
+    }
+    else
+    {
+        entry.wanted = min(entry.wanted, level);
+    }
+}
+
+//-----------------------------------------------------------------------------
+// estimates the size of the sphere on the screen
+//-----------------------------------------------------------------------------
+
+int ATextureStreamer::getScreenSize(const AVector &center, double radius)
+{
+    double modelview[16], projection[16];
+    GLint viewport[4];
+    glGetDoublev(GL_MODELVIEW_MATRIX, modelview);
+    glGetDoublev(GL_PROJECTION_MATRIX, projection);
+    glGetIntegerv(GL_VIEWPORT, viewport);
+
+    // the radius is scaled by the largest scale of the modelview matrix
+    double scale = 0.0;
+    for(int i=0; i<3; i++)
+    {
+        scale = max(scale, sqrt(modelview[i * 4] * modelview[i * 4] +
+                                modelview[i * 4 + 1] * modelview[i * 4 + 1] +
+                                modelview[i * 4 + 2] * modelview[i * 4 + 2]));
+    }
+    radius *= scale;
+
+    // pixels per unit of the view space, at the distance 1 for the
+    // perspective projection
+    double pixels = max(projection[0] * viewport[2], projection[5] * viewport[3]) * 0.5;
+
+    if(projection[11] != 0.0)
+    {
+        double distance = -(modelview[2] * center.x + modelview[6] * center.y +
+                            modelview[10] * center.z + modelview[14]);
+
+        if(distance <= radius)
+            return 0;
+
+        pixels /= distance;
+    }
+
+    int size = (int) ceil(2.0 * radius * pixels);
+    return size > 0 ? size : 1;
+}
+
+//-----------------------------------------------------------------------------
+// streams the used textures
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::update()
+{
+    if(textures.empty())
+    {
+        frame++;
+        return;
+    }
+
+    int uploads = 0;
+    int requests = 0;
+
+    for(map<GLuint, Entry>::iterator it = textures.begin(); it != textures.end(); it++)
+    {
+        Entry &entry = it->second;
+
+        // finished decoding, the finer levels which fit into the budget
+        // are uploaded
+        Request *request = entry.request;
+        if(request && request->group.isDone() && uploads < uploadsPerFrame)
+        {
+            const ATextureData &data = request->data;
+            if(entry.lastUsed == frame && request->decoded && data.levels == entry.levels &&
+               data.width == entry.width && data.height == entry.height &&
+               data.channels == entry.channels && data.format == entry.format)
+            {
+                int first = min(entry.wanted, entry.base);
+                while(first < entry.base && !makeRoom(getBytes(entry, first) - entry.bytes))
+                    first++;
+
+                if(first < entry.base)
+                    uploadLevels(it->first, entry, request->data, first);
+            }
+
+            delete request;
+            entry.request = NULL;
+            uploads++;
+        }
+
+        // used texture wanting finer levels, at least one must fit
+        if(!entry.request && entry.lastUsed == frame && entry.wanted < entry.base &&
+           requests < uploadsPerFrame &&
+           makeRoom(getBytes(entry, entry.base - 1) - entry.bytes))
+        {
+            request = new Request;
+            request->filename = entry.filename;
+            request->maxSize = entry.maxSize;
+            request->decoded = false;
+            entry.request = request;
+
+            if(AJobSystem::getThreadCount() > 1)
+                AJobSystem::submit(decodeJob, request, &request->group);
+            else
+                decodeJob(request);
+
+            requests++;
+        }
+    }
+
+    // the budget may be lowered
+    makeRoom(0);
+
+    frame++;
+}
+
+//-----------------------------------------------------------------------------
+// forgets the texture
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::remove(GLuint texture)
+{
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    if(it == textures.end())
+        return;
+
+    if(it->second.request)
+    {
+        AJobSystem::wait(&it->second.request->group);
+        delete it->second.request;
+    }
+
+    residentBytes -= it->second.bytes;
+    textures.erase(it);
+}
+
+//-----------------------------------------------------------------------------
+// returns the finest resident level
+//-----------------------------------------------------------------------------
+
+int ATextureStreamer::getBaseLevel(GLuint texture)
+{
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    return (it == textures.end()) ? -1 : it->second.base;
+}
+
+//-----------------------------------------------------------------------------
+// returns the size of the texture
+//-----------------------------------------------------------------------------
+
+bool ATextureStreamer::getSize(GLuint texture, int *width, int *height)
+{
+    map<GLuint, Entry>::iterator it = textures.find(texture);
+    if(it == textures.end())
+        return false;
+
+    if(width)
+        *width = it->second.width;
+    if(height)
+        *height = it->second.height;
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// writes the state of the textures
+//-----------------------------------------------------------------------------
+
+void ATextureStreamer::print(ostream &out)
+{
+    out << "Streamed textures: " << textures.size()
+        << ", resident: " << residentBytes / 1024 << " KB of " << budget / 1024 << " KB"
+        << ", streamed levels: " << streamedLevels << ", dropped levels: " << droppedLevels << endl;
+
+    for(map<GLuint, Entry>::iterator it = textures.begin(); it != textures.end(); it++)
+    {
+        const Entry &entry = it->second;
+        out << setw(6) << it->first << " level " << entry.base << "/" << entry.coarse
+            << " (" << max(1, entry.width >> entry.base) << "x" << max(1, entry.height >> entry.base) << ")"
+            << (entry.request ? " decoding " : " ") << entry.filename << endl;
+    }
+}
+
+} // namespace astral3d
@@ -0,0 +1,266 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file atexturestreamer.h ATextureStreamer class.
+ */
+#ifndef ATEXTURESTREAMER_H
+#define ATEXTURESTREAMER_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <string>
+#include <map>
+#include <iostream>
+#include <GL/gl.h>
+#include <GL/glext.h>
+
+#include "atexture.h"
+#include "avector.h"
+#include "ajobsystem.h"
+
+#ifndef GL_TEXTURE_BASE_LEVEL
+    #define GL_TEXTURE_BASE_LEVEL 0x813C
+    #define GL_TEXTURE_MAX_LEVEL 0x813D
+#endif
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Texture streaming under the memory budget.
+ * When the budget is set, ATextureLoader uploads only the small mipmap
+ * levels of the textures (see ATextureStreamer::setInitialSize). The
+ * renderers (ALevel, A3DSModel) report the textures they draw and
+ * ATextureStreamer::update, called once per frame by AWindow, decodes
+ * the finer levels of the used textures as the jobs of AJobSystem and
+ * uploads them. If the textures exceed the budget, the least recently
+ * used ones lose their finest levels (GL_TEXTURE_BASE_LEVEL hides them
+ * and their memory is freed).
+ * @n
+ * @n
+ * The class must be used from the OpenGL thread only. The levels are
+ * decoded again from the file, ATextureCache makes it cheap.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * ATextureCache::setDirectory("cache");
+ * ATextureStreamer::setBudget(64 * 1024 * 1024);
+ * level.load("big.map", "textures/");       // small levels only
+ * window.run();                             // finer levels stream in
+ * @endcode
+ */
+class ATextureStreamer
+{
+    private:
+        // finer levels decoded by the job
+        struct Request
+        {
+            std::string filename;
+            int maxSize;
+            ATextureData data;
+            bool decoded;
+            AJobGroup group;
+        };
+
+        struct Entry
+        {
+            std::string filename;
+            int width;                  // size of the level 0
+            int height;
+            int levels;
+            int channels;               // pixels of the decoded levels
+            GLenum format;
+            int maxSize;                // maximum size of the decoding
+            int base;                   // finest resident level
+            int coarse;                 // levels from here are always resident
+            int wanted;                 // finest level asked by use()
+            unsigned int lastUsed;      // frame of the last use
+            unsigned long bytes;        // memory of the resident levels
+            Request *request;           // decoding, NULL if none
+        };
+
+        static std::map<GLuint, Entry> textures;
+
+        static unsigned long budget;
+        static unsigned long residentBytes;
+        static int initialSize;
+        static int uploadsPerFrame;
+        static unsigned int frame;
+
+        // statistics
+        static unsigned int streamedLevels;
+        static unsigned int droppedLevels;
+
+        // memory of the levels from first to the last one
+        static unsigned long getBytes(const Entry &entry, int first);
+
+        // uploads the levels from first to before, sets the base level
+        static void uploadLevels(GLuint texture, Entry &entry, const ATextureData &data, int first);
+
+        // frees the finest resident level
+        static void dropLevel(GLuint texture, Entry &entry);
+
+        // drops levels of unused textures until the bytes fit into the budget
+        static bool makeRoom(unsigned long bytes);
+
+        // decodes the texture (job of AJobSystem)
+        static void decodeJob(void *data);
+
+    public:
+        /**
+         * Sets the memory budget.
+         * @param bytes Memory for the textures, 0 disables the streaming
+         *              (textures are loaded with all levels)
+         */
+        static void setBudget(unsigned long bytes);
+
+        /**
+         * Returns the memory budget.
+         * @return Bytes, 0 if the streaming is disabled
+         */
+        static unsigned long getBudget() { return budget; }
+
+        /**
+         * Returns true if the streaming is enabled.
+         * @return True if the budget is set
+         */
+        static bool isEnabled() { return budget > 0; }
+
+        /**
+         * Sets the size of the levels loaded at the start.
+         * @param size Maximum width and height of the finest level loaded
+         *             by ATextureStreamer::upload (64 by default)
+         */
+        static void setInitialSize(int size) { initialSize = size > 0 ? size : 1; }
+
+        /**
+         * Sets the number of textures uploaded in one frame.
+         * @param count Maximum number of textures getting finer levels in
+         *              one ATextureStreamer::update (4 by default)
+         */
+        static void setUploadsPerFrame(int count) { uploadsPerFrame = count > 0 ? count : 1; }
+
+        /**
+         * Creates the streamed texture.
+         * Only the levels not bigger than the initial size are uploaded.
+         * @param filename Image filename the finer levels are decoded from
+         * @param data Texture decoded by decodeTextureMipMap
+         * @param texture Pointer to the texture identifier
+         * @param maxSize Maximum size the texture was decoded with
+         * @return True if the texture is created successfuly
+         */
+        static bool upload(const char *filename, const ATextureData &data, GLuint *texture, int maxSize);
+
+        /**
+         * Reports the use of the texture.
+         * The renderers call it for the drawn textures, other textures
+         * are ignored.
+         * @param texture Texture
+         * @param pixels Approximate size of the texture on the screen in
+         *               pixels, 0 for all levels
+         * @see getScreenSize
+         */
+        static void use(GLuint texture, int pixels = 0);
+
+        /**
+         * Estimates the size of the object on the screen.
+         * The sphere is projected with the current modelview and projection
+         * matrices and the viewport. The renderers pass the size of the
+         * object the texture is mapped on to ATextureStreamer::use, so
+         * repeated textures get finer levels than they need.
+         * @param center Center of the bounding sphere in the model space
+         * @param radius Radius of the bounding sphere
+         * @return Diameter of the sphere in pixels, 0 if the camera is
+         *         inside the sphere
+         */
+        static int getScreenSize(const AVector &center, double radius);
+
+        /**
+         * Streams the used textures and keeps the budget.
+         * Called once per frame by AWindow.
+         */
+        static void update();
+
+        /**
+         * Forgets the texture.
+         * Called by deleteTexture and ATextureManager before the texture
+         * is deleted.
+         * @param texture Texture
+         */
+        static void remove(GLuint texture);
+
+        /**
+         * Returns true if the texture is streamed.
+         * @param texture Texture
+         * @return True if the texture was created by ATextureStreamer::upload
+         */
+        static bool isStreamed(GLuint texture) { return textures.find(texture) != textures.end(); }
+
+        /**
+         * Returns the finest resident level.
+         * @param texture Texture
+         * @return Level index (0 is the full size), -1 if the texture isn't
+         *         streamed
+         */
+        static int getBaseLevel(GLuint texture);
+
+        /**
+         * Returns the size of the streamed texture.
+         * @param texture Texture
+         * @param width Width of the level 0
+         * @param height Height of the level 0
+         * @return True if the texture is streamed
+         */
+        static bool getSize(GLuint texture, int *width, int *height);
+
+        /**
+         * Returns the memory of the streamed textures.
+         * @return Bytes of the resident levels
+         */
+        static unsigned long getResidentBytes() { return residentBytes; }
+
+        /**
+         * Returns the number of uploaded finer levels.
+         * @return Number of levels streamed in since the start
+         */
+        static unsigned int getStreamedLevels() { return streamedLevels; }
+
+        /**
+         * Returns the number of dropped levels.
+         * @return Number of levels freed to keep the budget
+         */
+        static unsigned int getDroppedLevels() { return droppedLevels; }
+
+        /**
+         * Writes the state of the textures.
+         * @param out Output stream
+         */
+        static void print(std::ostream &out);
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ATEXTURESTREAMER_H
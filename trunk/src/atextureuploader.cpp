@@ -0,0 +1,242 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+
+#include "atextureuploader.h"
+#include "arenderstate.h"
+
+using namespace std;
+namespace astral3d {
+
+deque<ATextureUploader::Upload *> ATextureUploader::uploads;
+
+unsigned long ATextureUploader::budget = 0;
+GLuint ATextureUploader::buffer = 0;
+unsigned long ATextureUploader::uploadedBytes = 0;
+
+//-----------------------------------------------------------------------------
+// creates the texture and queues its levels
+//-----------------------------------------------------------------------------
+
+bool ATextureUploader::upload(ATextureData &data, GLuint *texture)
+{
+    if(!isEnabled())
+        return uploadTextureMipMap(data, texture);
+
+    if(data.levels <= 0 || data.pixels.empty())
+    {
+        stringstream foo;
+        foo << "ATextureUploader::upload("<<&data<<", "<<texture<<")";
+        setAstral3DError("The texture isn't decoded", foo.str(), "decodeTextureMipMap");
+        return false;
+    }
+
+    Upload *upload = new Upload;
+    upload->data.width = data.width;
+    upload->data.height = data.height;
+    upload->data.levels = data.levels;
+    upload->data.channels = data.channels;
+    upload->data.format = data.format;
+    upload->data.pixels.swap(data.pixels);
+    data.levels = 0;
+
+    glGenTextures(1, texture);
+    ARenderState::bindTexture(*texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // the levels are allocated, only the last one (1x1) gets its pixels
+    unsigned int offset = 0;
+    int last = upload->data.levels - 1;
+    for(int i = 0; i <= last; i++)
+    {
+        upload->offsets.push_back(offset);
+        uploadTextureLevel(upload->data, i, i == last ? &upload->data.pixels[offset] : NULL);
+        offset += upload->data.getLevelSize(i);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, last);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, last);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    if(last == 0)
+    {
+        delete upload;
+        return true;
+    }
+
+    upload->texture = *texture;
+    upload->level = last - 1;
+    upload->row = 0;
+    uploads.push_back(upload);
+
+    return true;
+}
+
+//-----------------------------------------------------------------------------
+// uploads the rows of the level
+//-----------------------------------------------------------------------------
+
+void ATextureUploader::uploadRows(Upload *upload, int rows)
+{
+    const ATextureData &data = upload->data;
+    int w = max(1, data.width >> upload->level);
+
+    // compressed rows start at the blocks of 4 rows
+    unsigned int start = getTextureLevelSize(data.format, data.channels, w, upload->row);
+    unsigned int bytes = getTextureLevelSize(data.format, data.channels, w, upload->row + rows) - start;
+    const unsigned char *pixels = &data.pixels[upload->offsets[upload->level] + start];
+
+    ARenderState::bindTexture(upload->texture);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    // the rows are copied to the new storage of the buffer, the driver
+    // transfers them while the previous ones may still be used
+    const GLvoid *source = pixels;
+    if(isPBOSupported())
+    {
+        if(!buffer)
+            aglGenBuffersARB(1, &buffer);
+
+        aglBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, buffer);
+        aglBufferDataARB(GL_PIXEL_UNPACK_BUFFER_ARB, bytes, NULL, GL_STREAM_DRAW_ARB);
+
+        void *mapped = aglMapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, GL_WRITE_ONLY_ARB);
+        if(mapped)
+        {
+            memcpy(mapped, pixels, bytes);
+            aglUnmapBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB);
+            source = NULL;
+        }
+        else
+        {
+            aglBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+        }
+    }
+
+    if(data.format)
+        aglCompressedTexSubImage2DARB(GL_TEXTURE_2D, upload->level, 0, upload->row, w, rows,
+                                      data.format, bytes, source);
+    else
+        glTexSubImage2D(GL_TEXTURE_2D, upload->level, 0, upload->row, w, rows,
+                        data.channels == 4 ? GL_RGBA : GL_RGB, GL_UNSIGNED_BYTE, source);
+
+    if(source == NULL)
+        aglBindBufferARB(GL_PIXEL_UNPACK_BUFFER_ARB, 0);
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+
+    upload->row += rows;
+    uploadedBytes += bytes;
+
+    // the finished level is used
+    int h = max(1, upload->data.height >> upload->level);
+    if(upload->row >= h)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, upload->level);
+        upload->level--;
+        upload->row = 0;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// uploads the queued levels up to the budget
+//-----------------------------------------------------------------------------
+
+void ATextureUploader::update()
+{
+    // at least one row is uploaded every frame
+    long left = budget;
+    while(!uploads.empty() && left > 0)
+    {
+        Upload *upload = uploads.front();
+
+        const ATextureData &data = upload->data;
+        int w = max(1, data.width >> upload->level);
+        int h = max(1, data.height >> upload->level);
+
+        // compressed levels go by the rows of blocks
+        int unit = data.format ? 4 : 1;
+        long unitBytes = getTextureLevelSize(data.format, data.channels, w, unit);
+        int rows = min(h - upload->row, max(1, (int) (left / unitBytes)) * unit);
+
+        left -= getTextureLevelSize(data.format, data.channels, w, upload->row + rows) -
+                getTextureLevelSize(data.format, data.channels, w, upload->row);
+        uploadRows(upload, rows);
+
+        if(upload->level < 0)
+        {
+            uploads.pop_front();
+            delete upload;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// uploads all queued levels
+//-----------------------------------------------------------------------------
+
+void ATextureUploader::finish()
+{
+    while(!uploads.empty())
+    {
+        Upload *upload = uploads.front();
+        while(upload->level >= 0)
+            uploadRows(upload, max(1, upload->data.height >> upload->level) - upload->row);
+
+        uploads.pop_front();
+        delete upload;
+    }
+}
+
+//-----------------------------------------------------------------------------
+// removes the texture from the queue
+//-----------------------------------------------------------------------------
+
+void ATextureUploader::cancel(GLuint texture)
+{
+    for(deque<Upload *>::iterator it = uploads.begin(); it != uploads.end(); it++)
+    {
+        if((*it)->texture == texture)
+        {
+            delete *it;
+            uploads.erase(it);
+            return;
+        }
+    }
+}
+
+//-----------------------------------------------------------------------------
+// returns true if the texture is in the queue
+//-----------------------------------------------------------------------------
+
+bool ATextureUploader::isPending(GLuint texture)
+{
+    for(unsigned int i = 0; i < uploads.size(); i++)
+    {
+        if(uploads[i]->texture == texture)
+            return true;
+    }
+
+    return false;
+}
+
+} // namespace astral3d
@@ -0,0 +1,160 @@
+ /*****************************************************************************
+ * Astral3D -- 3D engine based on OpenGL and SDL.                             *
+ * Copyright (C) 2005 Pavel Stupka <pavel.stupka@gmail.com>                   *
+ *                                                                            *
+ * This library is free software; you can redistribute it and/or              *
+ * modify it under the terms of the GNU Lesser General Public                 *
+ * License as published by the Free Software Foundation; either               *
+ * version 2.1 of the License, or (at your option) any later version.         *
+ *                                                                            *
+ * This library is distributed in the hope that it will be useful,            *
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of             *
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU          *
+ * Lesser General Public License for more details.                            *
+ *                                                                            *
+ * You should have received a copy of the GNU Lesser General Public           *
+ * License along with this library; if not, write to the Free Software        *
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA *
+ *****************************************************************************/
+
+/**
+ * @file atextureuploader.h ATextureUploader class.
+ */
+#ifndef ATEXTUREUPLOADER_H
+#define ATEXTUREUPLOADER_H
+
+#ifdef WIN32
+    #include <windows.h>
+#endif
+
+#include <deque>
+#include <vector>
+#include <GL/gl.h>
+
+#include "atexture.h"
+#include "aextensions.h"
+
+/**
+ * @namespace astral3d Astral3D namespace.
+ */
+namespace astral3d {
+
+/**
+ * Uploads of textures spread across frames.
+ * When the budget is set, ATextureLoader creates the textures by
+ * ATextureUploader::upload. The texture gets only its 1x1 level at once
+ * and is usable immediately as the placeholder, ATextureUploader::update
+ * (called once per frame by AWindow) uploads at most the budget of bytes
+ * per frame, from the small levels to the big ones, big levels in
+ * stripes of rows. Every finished level becomes the base level of the
+ * texture, so it gets sharper as it is uploaded.
+ * @n
+ * @n
+ * The rows are copied to a pixel buffer object if the driver supports
+ * GL_ARB_pixel_buffer_object, so the transfer doesn't block the thread,
+ * otherwise they are uploaded from the memory of the application. The
+ * class must be used from the OpenGL thread only.
+ * @n
+ * @n
+ * Example of usage:
+ * @n
+ * @code
+ * ATextureUploader::setBudget(2 * 1024 * 1024);   // 2 MB per frame
+ * level.load("level.map", "textures/");           // returns at once
+ * window.run();                                   // textures get sharper
+ * @endcode
+ */
+class ATextureUploader
+{
+    private:
+        struct Upload
+        {
+            GLuint texture;
+            ATextureData data;
+            std::vector<unsigned int> offsets;  // first byte of the levels
+            int level;                          // level being uploaded
+            int row;                            // next row of the level
+        };
+
+        static std::deque<Upload *> uploads;
+
+        static unsigned long budget;
+        static GLuint buffer;               // pixel buffer object
+        static unsigned long uploadedBytes;
+
+        // uploads the rows of the level
+        static void uploadRows(Upload *upload, int rows);
+
+    public:
+        /**
+         * Sets the number of bytes uploaded per frame.
+         * @param bytes Budget of one frame, 0 disables the uploader
+         *              (textures are uploaded at once)
+         */
+        static void setBudget(unsigned long bytes) { budget = bytes; }
+
+        /**
+         * Returns the budget.
+         * @return Bytes uploaded per frame
+         */
+        static unsigned long getBudget() { return budget; }
+
+        /**
+         * Returns true if the uploads are spread across frames.
+         * @return True if the budget is set
+         */
+        static bool isEnabled() { return budget > 0; }
+
+        /**
+         * Creates the texture and queues its levels.
+         * Without the budget the texture is uploaded at once
+         * (uploadTextureMipMap).
+         * @param data Texture decoded by decodeTextureMipMap, the pixels
+         *             are moved to the uploader (data is empty afterwards)
+         * @param texture Pointer to the texture identifier
+         * @return True if the texture is created successfuly
+         */
+        static bool upload(ATextureData &data, GLuint *texture);
+
+        /**
+         * Uploads the queued levels up to the budget.
+         * Called once per frame by AWindow.
+         */
+        static void update();
+
+        /**
+         * Uploads all queued levels.
+         */
+        static void finish();
+
+        /**
+         * Removes the texture from the queue.
+         * Called by deleteTexture and ATextureManager before the texture
+         * is deleted.
+         * @param texture Texture
+         */
+        static void cancel(GLuint texture);
+
+        /**
+         * Returns true if the texture isn't uploaded completely.
+         * @param texture Texture
+         * @return True if the texture is in the queue
+         */
+        static bool isPending(GLuint texture);
+
+        /**
+         * Returns the number of textures in the queue.
+         * @return Number of textures
+         */
+        static int getPendingCount() { return uploads.size(); }
+
+        /**
+         * Returns the number of bytes uploaded by the uploader.
+         * @return Bytes uploaded since the start
+         */
+        static unsigned long getUploadedBytes() { return uploadedBytes; }
+};
+
+} // namespace astral3d
+
+#endif    // #ifndef ATEXTUREUPLOADER_H
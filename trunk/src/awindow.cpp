@@ -19,6 +19,14 @@
 
 #include "awindow.h"
 
+#ifdef HAVE_CONFIG_H
+    #include "config.h"
+#endif
+
+#ifdef HAVE_OSMESA
+    #include <GL/osmesa.h>
+#endif
+
 using namespace std;
 namespace astral3d {
 
@@ -30,15 +38,45 @@ void appExit(int exitCode)
 
 AWindow::AWindow(int width, int height, int bpp, bool resizable, bool fullscreen)
 {
+    console = NULL;
+    screen = NULL;
+    offscreenContext = NULL;
+    aspect = 4.0 / 3.0;
+    setPerspective(45.0, 0.1, 5000.0);
+    initScheduler();
     create(width, height, bpp, resizable, fullscreen);
 }
 
+//-----------------------------------------------------------------------------
+// default scheduler settings
+//-----------------------------------------------------------------------------
+
+void AWindow::initScheduler()
+{
+    timestep = 0.0;
+    maxSteps = 5;
+    accumulator = 0.0;
+    interpolation = 1.0;
+    lastFrameTime = 0.0;
+    lastStepTime = 0.0;
+    frameTime = 0.0;
+    nextFrameTime = 0.0;
+    threadedSimulation = false;
+    simulationThread = NULL;
+    simulationMutex = NULL;
+    simulationRunning = false;
+    sceneBuffer = NULL;
+    writeState = NULL;
+}
+
 //-----------------------------------------------------------------------------
 // vykresleni sceny
 //-----------------------------------------------------------------------------
 
 void AWindow::render()
 {
+    ARenderState::beginFrame();
+
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
     glMatrixMode(GL_MODELVIEW);
     glLoadIdentity();
@@ -68,7 +106,16 @@ void AWindow::setIcon(char *filename)
 
 void AWindow::destroy(int retVal)
 {
+    // the simulation must not run while the application exits
+    stopSimulation();
     this->exit();
+#ifdef HAVE_OSMESA
+    if(offscreenContext)
+    {
+        OSMesaDestroyContext((OSMesaContext) offscreenContext);
+        offscreenContext = NULL;
+    }
+#endif
     if(screen)
     {
         SDL_FreeSurface(screen);
@@ -145,6 +192,10 @@ AWindow *AWindow::create(int width, int height, int bpp, bool resizable, bool fu
     this->screen = SDL_SetVideoMode(this->width, this->height,
                                     this->bpp, final_flags);
 
+    // the video mode change can create a new context
+    ARenderState::invalidate();
+    AProfiler::invalidate();
+
     if(screen == NULL)
     {
         stringstream foo;
@@ -159,6 +210,9 @@ AWindow *AWindow::create(int width, int height, int bpp, bool resizable, bool fu
     // inicializuje OpenGL okno
     this->initGL();
 
+    // nacte rozsireni OpenGL
+    initExtensions();
+
     // a nastavi potrebne parametry
     this->resizeScreen(this->width, this->height);
 
@@ -177,6 +231,96 @@ AWindow *AWindow::create(int width, int height, int bpp, bool resizable, bool fu
     return this;
 }
 
+//-----------------------------------------------------------------------------
+// creates the offscreen window rendering to memory
+//-----------------------------------------------------------------------------
+
+AWindow *AWindow::createOffscreen(int width, int height)
+{
+#ifdef HAVE_OSMESA
+    this->width = width;
+    this->height = height;
+    this->bpp = 32;
+    this->flags = 0;
+    this->fullscreen = false;
+    this->screen = NULL;
+
+    // timer and threads only, there is no video
+    if(SDL_Init(SDL_INIT_TIMER) < 0)
+    {
+        stringstream foo;
+        foo << "AWindow::createOffscreen("<<width<<", "<<height<<")";
+        setAstral3DError(SDL_GetError(), foo.str(), "SDL_Init(SDL_INIT_TIMER)");
+
+        throw ASDLException("AWindow *AWindow::createOffscreen(int width, int height)");
+    }
+
+    OSMesaContext context = OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, NULL);
+    if(!context)
+    {
+        stringstream foo;
+        foo << "AWindow::createOffscreen("<<width<<", "<<height<<")";
+        setAstral3DError("Can't create OSMesa context", foo.str(), "OSMesaCreateContextExt(OSMESA_RGBA, 24, 8, 0, NULL)");
+
+        throw AException("AWindow *AWindow::createOffscreen(int width, int height)");
+    }
+
+    offscreenBuffer.resize(width * height * 4);
+
+    if(!OSMesaMakeCurrent(context, &offscreenBuffer[0], GL_UNSIGNED_BYTE, width, height))
+    {
+        OSMesaDestroyContext(context);
+
+        stringstream foo;
+        stringstream bar;
+        foo << "AWindow::createOffscreen("<<width<<", "<<height<<")";
+        bar << "OSMesaMakeCurrent(context, buffer, GL_UNSIGNED_BYTE, "<<width<<", "<<height<<")";
+        setAstral3DError("Can't make OSMesa context current", foo.str(), bar.str());
+
+        throw AException("AWindow *AWindow::createOffscreen(int width, int height)");
+    }
+
+    offscreenContext = context;
+
+    // the same setup as the window
+    this->initGL();
+    initExtensions();
+    this->resizeScreen(this->width, this->height);
+
+    if(!this->init())
+    {
+        this->exit();
+        OSMesaDestroyContext(context);
+        offscreenContext = NULL;
+        SDL_Quit();
+
+        throw AException("AWindow *AWindow::createOffscreen(int width, int height)");
+    }
+
+    glLoadIdentity();
+
+    return this;
+#else
+    stringstream foo;
+    foo << "AWindow::createOffscreen("<<width<<", "<<height<<")";
+    setAstral3DError("Astral3D is built without offscreen rendering (configure --enable-osmesa)", foo.str(), "N/A");
+
+    throw AException("AWindow *AWindow::createOffscreen(int width, int height)");
+#endif
+}
+
+//-----------------------------------------------------------------------------
+// shows the rendered frame
+//-----------------------------------------------------------------------------
+
+void AWindow::swapBuffers()
+{
+    if(this->offscreenContext)
+        glFinish();
+    else
+        SDL_GL_SwapBuffers();
+}
+
 //-----------------------------------------------------------------------------
 // inicializuje rozhrani OpenGL
 //-----------------------------------------------------------------------------
@@ -189,6 +333,10 @@ void AWindow::initGL()
     glDepthFunc(GL_LEQUAL);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     glHint(GL_PERSPECTIVE_CORRECTION_HINT, GL_NICEST);
+
+    // new context, the cache knows nothing about it
+    ARenderState::invalidate();
+    AProfiler::invalidate();
 }
 
 //-----------------------------------------------------------------------------
@@ -206,7 +354,8 @@ void AWindow::resizeScreen(int width, int height)
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity();
 
-    gluPerspective(45.0f, (GLfloat)width/(GLfloat)height, 0.1f , 5000.0f);
+    this->aspect = (double)width/(double)height;
+    gluPerspective(this->fieldOfView, this->aspect, this->nearPlane, this->farPlane);
 
     glMatrixMode(GL_MODELVIEW);
 }
@@ -228,6 +377,10 @@ void AWindow::toggleFullscreen(bool fullscreen)
     this->screen = SDL_SetVideoMode(this->width, this->height,
                                     this->bpp, final_flags);
 
+    // the video mode change can create a new context
+    ARenderState::invalidate();
+    AProfiler::invalidate();
+
     this->resizeScreen(this->width, this->height);
 
     if(this->screen == NULL)
@@ -256,9 +409,29 @@ void AWindow::run()
 
     SDL_Event event;
 
+    accumulator = 0.0;
+    interpolation = 1.0;
+    lastFrameTime = lastStepTime = nextFrameTime = AProfiler::getTime();
+
+    if(threadedSimulation && timestep > 0.0)
+        startSimulation();
+
+    // the offscreen window has no events
+    while(running && this->offscreenContext)
+    {
+        AProfiler::beginFrame();
+        this->runFrame();
+        AProfiler::endFrame();
+
+        this->limitFrame();
+    }
+
     while(running)
     {
+        AProfiler::beginFrame();
+
         // zpracovani udalosti
+        AProfileZone eventsZone("events");
         while(SDL_PollEvent(&event))
         {
             switch (event.type)
@@ -322,6 +495,8 @@ void AWindow::run()
                     this->screen = SDL_SetVideoMode(event.resize.w,
                                                     event.resize.h,
                                                     this->bpp, final_flags);
+                    ARenderState::invalidate();
+                    AProfiler::invalidate();
 
                     this->resizeScreen(event.resize.w, event.resize.h);
 
@@ -344,13 +519,263 @@ void AWindow::run()
             }
         }
 
-        this->loop();
+        eventsZone.end();
 
-        // vykresleni sceny
-        this->render();
-        // prohozeni bufferu
-        SDL_GL_SwapBuffers();
+        this->runFrame();
+        AProfiler::endFrame();
+
+        this->limitFrame();
+    }
+
+    stopSimulation();
+}
+
+//-----------------------------------------------------------------------------
+// one frame of the main loop
+//-----------------------------------------------------------------------------
+
+void AWindow::runFrame()
+{
+    AProfileZone loopZone("loop");
+    this->loop();
+    loopZone.end();
+
+    AProfileZone updateZone("update");
+    this->simulate();
+    updateZone.end();
+
+    // vykresleni sceny
+    AProfileZone renderZone("render");
+    this->render();
+    renderZone.end();
+
+    // prohozeni bufferu
+    AProfileZone swapZone("swap");
+    this->swapBuffers();
+    swapZone.end();
+
+    // models loaded in the background, finer levels of the drawn textures
+    // and the queued uploads
+    AProfileZone streamingZone("streaming");
+    AModelLoader::update();
+    ATextureStreamer::update();
+    ATextureUploader::update();
+    streamingZone.end();
+}
+
+//-----------------------------------------------------------------------------
+// setTimestep
+//-----------------------------------------------------------------------------
+
+void AWindow::setTimestep(double step, int maxSteps)
+{
+    this->timestep = step > 0.0 ? step * 1000.0 : 0.0;
+    this->maxSteps = maxSteps > 0 ? maxSteps : 1;
+    this->accumulator = 0.0;
+    this->interpolation = 1.0;
+}
+
+//-----------------------------------------------------------------------------
+// setFrameLimit
+//-----------------------------------------------------------------------------
+
+void AWindow::setFrameLimit(int fps)
+{
+    this->frameTime = fps > 0 ? 1000.0 / fps : 0.0;
+    this->nextFrameTime = AProfiler::getTime();
+}
+
+//-----------------------------------------------------------------------------
+// fixed simulation steps of the frame
+//-----------------------------------------------------------------------------
+
+void AWindow::simulate()
+{
+    double now = AProfiler::getTime();
+    double elapsed = now - lastFrameTime;
+    lastFrameTime = now;
+
+    if(timestep <= 0.0)
+    {
+        interpolation = 1.0;
+        return;
+    }
+
+    // the simulation thread makes the steps, only the interpolation is
+    // computed here
+    if(simulationThread && sceneBuffer)
+    {
+        sceneBuffer->acquire();
+        interpolation = (now - sceneBuffer->getState()->time) / timestep;
+
+        interpolation = interpolation < 0.0 ? 0.0 : (interpolation > 1.0 ? 1.0 : interpolation);
+        return;
+    }
+
+    if(simulationThread)
+    {
+        lockSimulation();
+        interpolation = (now - lastStepTime) / timestep;
+        unlockSimulation();
+
+        interpolation = interpolation < 0.0 ? 0.0 : (interpolation > 1.0 ? 1.0 : interpolation);
+        return;
+    }
+
+    // a long frame (loading, breakpoint) would need too many steps,
+    // the simulation slows down instead
+    if(elapsed > maxSteps * timestep)
+        elapsed = maxSteps * timestep;
+
+    accumulator += elapsed;
+    while(accumulator >= timestep)
+    {
+        this->step(now);
+        accumulator -= timestep;
     }
+
+    if(sceneBuffer)
+        sceneBuffer->acquire();
+
+    interpolation = accumulator / timestep;
+}
+
+//-----------------------------------------------------------------------------
+// one simulation step
+//-----------------------------------------------------------------------------
+
+void AWindow::step(double time)
+{
+    if(!sceneBuffer)
+    {
+        this->update(timestep / 1000.0);
+        return;
+    }
+
+    writeState = sceneBuffer->beginWrite();
+    this->update(timestep / 1000.0);
+    writeState->time = time;
+    writeState = NULL;
+
+    sceneBuffer->publish();
+}
+
+//-----------------------------------------------------------------------------
+// waits for the frame limit
+//-----------------------------------------------------------------------------
+
+void AWindow::limitFrame()
+{
+    if(frameTime <= 0.0)
+        return;
+
+    nextFrameTime += frameTime;
+
+    double now = AProfiler::getTime();
+
+    // the frame was too long, the next one starts now
+    if(nextFrameTime < now - frameTime)
+        nextFrameTime = now;
+
+    // SDL_Delay can sleep longer, the last millisecond is waited actively
+    while(nextFrameTime - now > 1.0)
+    {
+        SDL_Delay((Uint32) (nextFrameTime - now - 1.0));
+        now = AProfiler::getTime();
+    }
+
+    while(now < nextFrameTime)
+        now = AProfiler::getTime();
+}
+
+//-----------------------------------------------------------------------------
+// starts the simulation thread
+//-----------------------------------------------------------------------------
+
+void AWindow::startSimulation()
+{
+    if(simulationThread)
+        return;
+
+    simulationMutex = SDL_CreateMutex();
+    if(!simulationMutex)
+    {
+        setAstral3DError(SDL_GetError(), "AWindow::run()", "SDL_CreateMutex()");
+
+        throw ASDLException("void AWindow::run()");
+    }
+
+    simulationRunning = true;
+    simulationThread = SDL_CreateThread(runSimulation, this);
+    if(!simulationThread)
+    {
+        simulationRunning = false;
+        SDL_DestroyMutex(simulationMutex);
+        simulationMutex = NULL;
+
+        setAstral3DError(SDL_GetError(), "AWindow::run()", "SDL_CreateThread(runSimulation, this)");
+
+        throw ASDLException("void AWindow::run()");
+    }
+}
+
+//-----------------------------------------------------------------------------
+// stops the simulation thread
+//-----------------------------------------------------------------------------
+
+void AWindow::stopSimulation()
+{
+    if(!simulationThread)
+        return;
+
+    simulationRunning = false;
+    SDL_WaitThread(simulationThread, NULL);
+    simulationThread = NULL;
+
+    SDL_DestroyMutex(simulationMutex);
+    simulationMutex = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// simulation thread
+//-----------------------------------------------------------------------------
+
+int AWindow::runSimulation(void *data)
+{
+    AWindow *window = (AWindow *) data;
+
+    double next = AProfiler::getTime() + window->timestep;
+
+    while(window->simulationRunning)
+    {
+        double now = AProfiler::getTime();
+        if(now < next)
+        {
+            SDL_Delay(now + 1.0 < next ? (Uint32) (next - now - 1.0) : 0);
+            continue;
+        }
+
+        // the simulation doesn't catch up more than maxSteps steps
+        if(now - next > window->maxSteps * window->timestep)
+            next = now - window->maxSteps * window->timestep;
+
+        // the scene buffer doesn't need the lock
+        if(window->sceneBuffer)
+        {
+            window->step(next);
+        }
+        else
+        {
+            window->lockSimulation();
+            window->step(next);
+            window->lastStepTime = next;
+            window->unlockSimulation();
+        }
+
+        next += window->timestep;
+    }
+
+    return 0;
 }
 
 } // namespace astral3d
@@ -27,8 +27,10 @@
 #ifdef WIN32
     #include <windows.h>
     #include <SDL.h>
+    #include <SDL_thread.h>
 #else
     #include "SDL.h"
+    #include "SDL_thread.h"
 #endif
 
 #include <GL/gl.h>
@@ -36,8 +38,15 @@
 #include <iostream>
 #include <cstdlib>
 #include <sstream>
+#include <vector>
 
 #include "aconsole.h"
+#include "aextensions.h"
+#include "aprofiler.h"
+#include "ascenebuffer.h"
+#include "amodelloader.h"
+#include "atexturestreamer.h"
+#include "atextureuploader.h"
 #include "aerror.h"
 
 /**
@@ -67,12 +76,20 @@ void appExit(int exitCode);
  * public:
  *   bool init();
  *   void loop();
+ *   void update(double dt);
  *   void exit();
  *   void render();
  *   void keyDown(SDL_keysym *keysym);
  *   void keyUp(SDL_keysym *keysym);
  * };
  * @endcode
+ * @n
+ * By default AWindow::run calls AWindow::loop and AWindow::render once per
+ * frame as fast as it can. With AWindow::setTimestep the simulation is
+ * moved to AWindow::update called with the fixed step, so it runs at the
+ * same speed on every machine, and AWindow::render interpolates between
+ * the last two states (AWindow::getInterpolation). AWindow::setFrameLimit
+ * caps the frame rate.
  */
 class AWindow
 {
@@ -87,16 +104,46 @@ protected:
     int mouseX;             // x cursor position
     int mouseY;             // y cursor position
     AConsole *console;      // console for keyDown callback
+    double fieldOfView;     // vertical field of view in degrees
+    double aspect;          // aspect ratio of the viewport
+    double nearPlane;       // distance of the near clipping plane
+    double farPlane;        // distance of the far clipping plane
+    void *offscreenContext; // OSMesa context of the offscreen window or NULL
+    std::vector<unsigned char> offscreenBuffer;     // pixels of the offscreen window
 
     void initGL();          // inicilizes OpenGL interface
     bool running;
 
+    double timestep;        // simulation step in milliseconds (0 for none)
+    int maxSteps;           // maximum simulation steps per frame
+    double accumulator;     // time not simulated yet (ms)
+    double interpolation;   // position between the last two steps (0 to 1)
+    double lastFrameTime;   // start of the last frame (ms)
+    double lastStepTime;    // time of the last simulation step (ms)
+    double frameTime;       // minimum time of the frame (ms, 0 for no limit)
+    double nextFrameTime;   // earliest start of the next frame (ms)
+    bool threadedSimulation;            // update runs on its own thread
+    SDL_Thread *simulationThread;
+    SDL_mutex *simulationMutex;
+    volatile bool simulationRunning;
+    ASceneBuffer *sceneBuffer;          // states written by update or NULL
+    ASceneState *writeState;            // state written by the running update
+
+    void initScheduler();               // default scheduler settings
+    void runFrame();                    // loop, update, render and swap
+    void simulate();                    // fixed steps of the frame
+    void step(double time);             // one call of update
+    void limitFrame();                  // waits for the frame limit
+    void startSimulation();             // starts the simulation thread
+    void stopSimulation();              // stops the simulation thread
+    static int runSimulation(void *window);    // simulation thread
+
 public:
 
     /**
      * Constructor.
      */
-    AWindow() {};
+    AWindow() { console = NULL; screen = NULL; offscreenContext = NULL; aspect = 4.0 / 3.0; setPerspective(45.0, 0.1, 5000.0); initScheduler(); }
     /**
      * Destructor.
      */
@@ -119,12 +166,48 @@ public:
      * This method sets the viewport after the window resize event and do
      * necessary OpenGL settings. It is called automatically from the main
      * program loop (see AWindow::run) after the resize event is catched.
-     * By default it sets perspective viewport. Override this method to set
-     * your own viewport.
+     * By default it sets perspective viewport with the parameters given by
+     * AWindow::setPerspective. Override this method to set your own viewport.
      * @param width New window width
      * @param height New window height
      */
     virtual void resizeScreen(int width, int height);
+    /**
+     * Sets the perspective projection.
+     * This method sets the parameters of the perspective projection used
+     * by AWindow::resizeScreen. ACamera uses them for building the view
+     * frustum. Default values are 45 degrees, 0.1 and 5000.
+     * @param fieldOfView Vertical field of view in degrees
+     * @param nearPlane Distance of the near clipping plane
+     * @param farPlane Distance of the far clipping plane
+     * @see resizeScreen
+     */
+    void setPerspective(double fieldOfView, double nearPlane, double farPlane)
+    {
+        this->fieldOfView = fieldOfView;
+        this->nearPlane = nearPlane;
+        this->farPlane = farPlane;
+    }
+    /**
+     * Returns vertical field of view.
+     * @return Vertical field of view in degrees
+     */
+    double getFieldOfView()  { return fieldOfView; }
+    /**
+     * Returns aspect ratio.
+     * @return Aspect ratio set by the last AWindow::resizeScreen call
+     */
+    double getAspect()       { return aspect; }
+    /**
+     * Returns distance of the near clipping plane.
+     * @return Distance of the near clipping plane
+     */
+    double getNearPlane()    { return nearPlane; }
+    /**
+     * Returns distance of the far clipping plane.
+     * @return Distance of the far clipping plane
+     */
+    double getFarPlane()     { return farPlane; }
     /**
      * Renderes the scene.
      * This method should be overriden. It is called automatically from the
@@ -198,6 +281,36 @@ public:
      * @see run
      */
     virtual void loop() {}
+    /**
+     * Simulation step.
+     * This method is called from AWindow::run with the fixed step set by
+     * AWindow::setTimestep, zero or more times per frame (after
+     * AWindow::loop, before AWindow::render). Move the camera, objects and
+     * physics here. This method should be overriden.
+     * @n
+     * @n
+     * Example of usage:
+     * @n
+     * @code
+     * void MyWindow::update(double dt)
+     * {
+     *     camera.saveState();
+     *     if(w)
+     *         camera.moveForward();
+     * }
+     *
+     * void MyWindow::render()
+     * {
+     *     AWindow::render();
+     *     camera.set(getInterpolation());
+     *     level.render();
+     * }
+     * @endcode
+     * @param dt Length of the step in seconds
+     * @see setTimestep
+     * @see getInterpolation
+     */
+    virtual void update(double dt) {}
     /**
      * Application init method.
      * This method inicializes the application.
@@ -250,6 +363,31 @@ public:
      * @see init
      */
     AWindow *create(int width, int height, int bpp, bool resizable = true, bool fullscreen = false);
+    /**
+     * Creates the offscreen window.
+     * This method creates a software OpenGL context (OSMesa) rendering to
+     * memory instead of the window, so the scene can be rendered on a
+     * machine without a display or a GPU (see ABenchmark). It calls
+     * AWindow::init method at the end like AWindow::create. The library
+     * must be configured with --enable-osmesa.
+     * @param width Width of the image
+     * @param height Height of the image
+     * @return Pointer to this instance
+     * @throw AException
+     * @see isOffscreen
+     */
+    AWindow *createOffscreen(int width, int height);
+    /**
+     * Returns true for the offscreen window.
+     * @return True if the window was created by AWindow::createOffscreen
+     */
+    bool isOffscreen() { return this->offscreenContext != NULL; }
+    /**
+     * Shows the rendered frame.
+     * This method swaps the buffers of the window. The offscreen window
+     * only waits until the frame is rendered.
+     */
+    void swapBuffers();
     /**
      * Destroys the window.
      * This method destroys the window and frees the memory. It calls
@@ -267,6 +405,105 @@ public:
      * @see create
      */
     void run();
+    /**
+     * Sets the fixed simulation step.
+     * AWindow::update is called with this step as many times as the time
+     * of the frame needs (at most maxSteps times, the rest of the time
+     * is dropped so a slow frame doesn't make the next one slower).
+     * @param step Length of the step in seconds (for example 1.0 / 60.0),
+     *             0 turns AWindow::update off
+     * @param maxSteps Maximum number of steps per frame
+     * @see update
+     * @see getInterpolation
+     */
+    void setTimestep(double step, int maxSteps = 5);
+    /**
+     * Returns the simulation step.
+     * @return Length of the step in seconds (0 if it is off)
+     */
+    double getTimestep() { return timestep / 1000.0; }
+    /**
+     * Returns the position of the frame between the simulation steps.
+     * AWindow::render should draw the state interpolation of the way from
+     * the previous step to the last one, so the motion is smooth when the
+     * frame rate differs from the simulation rate.
+     * @return 0 for the previous step to 1 for the last step
+     * @see setTimestep
+     */
+    double getInterpolation() { return interpolation; }
+    /**
+     * Limits the frame rate.
+     * AWindow::run sleeps after the frame when it is faster than the
+     * limit, so it doesn't use the whole processor.
+     * @param fps Maximum frames per second (0 for no limit)
+     */
+    void setFrameLimit(int fps);
+    /**
+     * Runs the simulation on its own thread.
+     * AWindow::update is called with the fixed step on the simulation
+     * thread, AWindow::loop, AWindow::render and the event callbacks on
+     * the main thread. Data shared by them must be locked with
+     * AWindow::lockSimulation (AWindow::update is called locked) or
+     * passed through the scene buffer (AWindow::setSceneBuffer). It must
+     * be set before AWindow::run and it needs AWindow::setTimestep.
+     * @param threaded True to run the simulation on its own thread
+     * @see lockSimulation
+     * @see setSceneBuffer
+     */
+    void setSimulationThread(bool threaded) { threadedSimulation = threaded; }
+    /**
+     * Locks the simulation.
+     * AWindow::update is not running until AWindow::unlockSimulation.
+     * Use it in AWindow::render to copy the state of the simulation when
+     * the simulation runs on its own thread.
+     * @see setSimulationThread
+     */
+    void lockSimulation()   { if(simulationMutex) SDL_mutexP(simulationMutex); }
+    /**
+     * Unlocks the simulation.
+     * @see lockSimulation
+     */
+    void unlockSimulation() { if(simulationMutex) SDL_mutexV(simulationMutex); }
+    /**
+     * Sets the buffer of the scene states.
+     * Every AWindow::update writes the state of the scene
+     * (AWindow::getWriteState), which is published after the step.
+     * AWindow::render draws the last published state
+     * (AWindow::getSceneState). With the simulation thread neither of
+     * them waits for the other, AWindow::update isn't locked then and
+     * the interpolation is computed from the time of the state.
+     * @n
+     * @n
+     * Example of usage:
+     * @n
+     * @code
+     * void MyWindow::update(double dt)
+     * {
+     *     moveCamera(dt);
+     *     getWriteState()->setCamera(camera.getEye(), camera.getFront());
+     * }
+     *
+     * void MyWindow::render()
+     * {
+     *     AWindow::render();
+     *     getSceneState()->setCamera(getInterpolation());
+     *     level.render();
+     * }
+     * @endcode
+     * @param buffer Buffer of the states or NULL
+     * @see ASceneBuffer
+     */
+    void setSceneBuffer(ASceneBuffer *buffer) { sceneBuffer = buffer; }
+    /**
+     * Returns the state written by AWindow::update.
+     * @return State of the running step or NULL outside AWindow::update
+     */
+    ASceneState *getWriteState() { return writeState; }
+    /**
+     * Returns the last published scene state.
+     * @return State for rendering or NULL without the scene buffer
+     */
+    const ASceneState *getSceneState() { return sceneBuffer ? sceneBuffer->getState() : NULL; }
     /**
      * Changes the fullscreen mode.
      * This method changes the fullscreen mode.